@@ -0,0 +1,161 @@
+#include "pragmas.hpp"
+
+#include "AssetIO.hpp"
+
+
+MappedFile::MappedFile(const char* fileName) {
+	m_hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error(std::string("failed to open file: ") + fileName);
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize)) {
+		(*this).~MappedFile();
+		throw std::runtime_error(std::string("failed to size file: ") + fileName);
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_size == 0) {
+		return;		//	Can't map an empty file, and there is nothing to see anyway.
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping != nullptr) {
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (m_pData == nullptr) {
+		(*this).~MappedFile();
+		throw std::runtime_error(std::string("failed to map file: ") + fileName);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (m_pData != nullptr) {
+		UnmapViewOfFile(m_pData);
+		m_pData = nullptr;
+	}
+	if (m_hMapping != nullptr) {
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: m_hFile(other.m_hFile)
+	, m_hMapping(other.m_hMapping)
+	, m_pData(other.m_pData)
+	, m_size(other.m_size) {
+	other.m_hFile = INVALID_HANDLE_VALUE;
+	other.m_hMapping = nullptr;
+	other.m_pData = nullptr;
+	other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this == &other) {
+		return *this;
+	}
+	(*this).~MappedFile();
+	new(this) MappedFile(std::move(other));
+	return *this;
+}
+
+
+AsyncFileReader::~AsyncFileReader() {
+	//	The kernel may still be writing into the destinations.
+	for (std::unique_ptr<Request>& request : m_requests) {
+		DWORD bytesTransferred;
+		GetOverlappedResult(request->m_hFile, &request->m_overlapped, &bytesTransferred, TRUE);
+	}
+	closeAll();
+}
+
+HANDLE AsyncFileReader::openFile(const std::string& fileName) {
+	auto found = m_openFiles.find(fileName);
+	if (found != m_openFiles.end()) {
+		return found->second;
+	}
+	HANDLE hFile = CreateFileA(
+		fileName.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open file: " + fileName);
+	}
+	m_openFiles.emplace(fileName, hFile);
+	return hFile;
+}
+
+void AsyncFileReader::closeAll() {
+	for (std::unique_ptr<Request>& request : m_requests) {
+		CloseHandle(request->m_overlapped.hEvent);
+	}
+	m_requests.clear();
+	for (auto& [fileName, hFile] : m_openFiles) {
+		CloseHandle(hFile);
+	}
+	m_openFiles.clear();
+}
+
+void AsyncFileReader::read(const char* fileName, uint64_t fileOffset, size_t size, void* pDst) {
+	HANDLE hFile = openFile(fileName);
+
+	//	ReadFile takes a DWORD size, so very large reads go out in pieces.
+	const size_t MAX_READ_SIZE = 1u << 30;
+	uint8_t* pChunkDst = static_cast<uint8_t*>(pDst);
+	while (size > 0) {
+		const DWORD chunkSize = static_cast<DWORD>(std::min(size, MAX_READ_SIZE));
+
+		std::unique_ptr<Request> request = std::make_unique<Request>();
+		request->m_hFile = hFile;
+		request->m_size = chunkSize;
+		request->m_fileName = fileName;
+		request->m_overlapped.Offset = static_cast<DWORD>(fileOffset);
+		request->m_overlapped.OffsetHigh = static_cast<DWORD>(fileOffset >> 32);
+		//	Each read needs its own event since several share a file handle.
+		request->m_overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (request->m_overlapped.hEvent == nullptr) {
+			throw std::runtime_error("failed to create read event");
+		}
+
+		if (!ReadFile(hFile, pChunkDst, chunkSize, nullptr, &request->m_overlapped)
+			&& GetLastError() != ERROR_IO_PENDING) {
+			CloseHandle(request->m_overlapped.hEvent);
+			throw std::runtime_error(std::string("failed to read file: ") + fileName);
+		}
+		m_requests.push_back(std::move(request));
+
+		pChunkDst += chunkSize;
+		fileOffset += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+uint64_t AsyncFileReader::waitAll() {
+	std::string failedFileName;
+	for (std::unique_ptr<Request>& request : m_requests) {
+		DWORD bytesTransferred = 0;
+		const BOOL succeeded = GetOverlappedResult(request->m_hFile, &request->m_overlapped, &bytesTransferred, TRUE);
+		if ((!succeeded || bytesTransferred != request->m_size) && failedFileName.empty()) {
+			failedFileName = request->m_fileName;
+		}
+		m_bytesRead += bytesTransferred;
+	}
+	closeAll();
+
+	const uint64_t bytesRead = m_bytesRead;
+	m_bytesRead = 0;
+	if (!failedFileName.empty()) {
+		throw std::runtime_error("failed to read file: " + failedFileName);
+	}
+	return bytesRead;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define VK_USE_PLATFORM_WIN32_KHR
+#include "VulkanCpp.hpp"
+
+#include <memory>
+
+
+//	How asset bytes get from disk to where they are used.
+//	MEMORY_MAP reads through a mapped view of the file, no heap copy.
+//	ASYNC_READ issues overlapped reads straight into the destination,
+//	typically persistently mapped staging memory.
+enum class AssetIOMode {
+	MEMORY_MAP,
+	ASYNC_READ
+};
+
+
+//	Read only view of a whole file.
+class MappedFile {
+
+	HANDLE		m_hFile = INVALID_HANDLE_VALUE;
+	HANDLE		m_hMapping = nullptr;
+	const uint8_t* m_pData = nullptr;
+	size_t		m_size = 0;
+
+public:
+
+	MappedFile() {}
+	explicit MappedFile(const char* fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const uint8_t* data() const { return m_pData; }
+	size_t size() const { return m_size; }
+
+};
+
+
+//	Overlapped reads into caller owned memory.  Every read is issued as soon
+//	as it is added so they are all in flight together; waitAll collects them.
+//	The destination memory must stay alive until waitAll returns.
+class AsyncFileReader {
+
+	struct Request {
+		OVERLAPPED	m_overlapped{};
+		HANDLE		m_hFile = INVALID_HANDLE_VALUE;
+		DWORD		m_size = 0;
+		std::string	m_fileName;
+	};
+
+	std::map<std::string, HANDLE>	m_openFiles;
+	std::vector<std::unique_ptr<Request>>	m_requests;	//	OVERLAPPED can't move while in flight.
+	uint64_t	m_bytesRead = 0;
+
+	HANDLE openFile(const std::string& fileName);
+	void closeAll();
+
+public:
+
+	AsyncFileReader() {}
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	void read(const char* fileName, uint64_t fileOffset, size_t size, void* pDst);
+
+	//	Throws std::runtime_error if any read failed or came up short.
+	//	Returns the bytes read since the last waitAll.
+	uint64_t waitAll();
+
+};
@@ -0,0 +1,387 @@
+#include "pragmas.hpp"
+
+#include "Ktx2File.hpp"
+
+
+namespace {
+
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header {
+		uint8_t		m_identifier[12];
+		uint32_t	m_vkFormat;
+		uint32_t	m_typeSize;
+		uint32_t	m_pixelWidth;
+		uint32_t	m_pixelHeight;
+		uint32_t	m_pixelDepth;
+		uint32_t	m_layerCount;
+		uint32_t	m_faceCount;
+		uint32_t	m_levelCount;
+		uint32_t	m_supercompressionScheme;
+		uint32_t	m_dfdByteOffset;
+		uint32_t	m_dfdByteLength;
+		uint32_t	m_kvdByteOffset;
+		uint32_t	m_kvdByteLength;
+		uint64_t	m_sgdByteOffset;
+		uint64_t	m_sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80);
+
+	struct Ktx2LevelIndex {
+		uint64_t	m_byteOffset;
+		uint64_t	m_byteLength;
+		uint64_t	m_uncompressedByteLength;
+	};
+	static_assert(sizeof(Ktx2LevelIndex) == 24);
+
+
+	void throwKtx2Error(const char* fileName, const char* what) {
+		throw std::runtime_error(std::string(fileName) + ": " + what);
+	}
+
+	void validateHeader(const Ktx2Header& header, const char* fileName) {
+		if (memcmp(header.m_identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			throwKtx2Error(fileName, "not a KTX2 file");
+		}
+		if (header.m_vkFormat == VK_FORMAT_UNDEFINED) {
+			throwKtx2Error(fileName, "KTX2 without a vkFormat (Basis Universal) needs a transcoder");
+		}
+		if (header.m_supercompressionScheme != 0) {
+			throwKtx2Error(fileName, "supercompressed KTX2 is not supported");
+		}
+		if (header.m_pixelWidth == 0 || header.m_pixelHeight == 0 || header.m_pixelDepth > 1) {
+			throwKtx2Error(fileName, "only 2d KTX2 images are supported");
+		}
+		if (header.m_layerCount > 1 || header.m_faceCount != 1) {
+			throwKtx2Error(fileName, "KTX2 arrays and cube maps are not supported");
+		}
+	}
+
+
+	//	S3TC colors are two RGB565 end points and 2 bit indices between them.
+	void expand565(uint16_t color, uint8_t rgba[4]) {
+		const uint32_t r = (color >> 11) & 0x1F;
+		const uint32_t g = (color >> 5) & 0x3F;
+		const uint32_t b = color & 0x1F;
+		rgba[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+		rgba[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+		rgba[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+		rgba[3] = 255;
+	}
+
+	//	BC2/BC3 always use the four color mode, BC1 picks it by end point order.
+	void decodeColorBlock(const uint8_t* pBlock, bool bc1, bool bc1Alpha, uint8_t texels[16][4]) {
+		const uint16_t c0 = static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8));
+		const uint16_t c1 = static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8));
+
+		uint8_t palette[4][4];
+		expand565(c0, palette[0]);
+		expand565(c1, palette[1]);
+		const bool fourColors = !bc1 || c0 > c1;
+		for (int channel = 0; channel < 3; channel++) {
+			const uint32_t p0 = palette[0][channel];
+			const uint32_t p1 = palette[1][channel];
+			if (fourColors) {
+				palette[2][channel] = static_cast<uint8_t>((2 * p0 + p1) / 3);
+				palette[3][channel] = static_cast<uint8_t>((p0 + 2 * p1) / 3);
+			}
+			else {
+				palette[2][channel] = static_cast<uint8_t>((p0 + p1) / 2);
+				palette[3][channel] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = (fourColors || !bc1Alpha) ? 255 : 0;
+
+		const uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | (uint32_t(pBlock[7]) << 24);
+		for (int texel = 0; texel < 16; texel++) {
+			memcpy(texels[texel], palette[(indices >> (2 * texel)) & 3], 4);
+		}
+	}
+
+	void decodeBc2Alpha(const uint8_t* pBlock, uint8_t texels[16][4]) {
+		for (int texel = 0; texel < 16; texel++) {
+			const uint32_t nibble = (pBlock[texel / 2] >> ((texel & 1) * 4)) & 0xF;
+			texels[texel][3] = static_cast<uint8_t>(nibble * 17);
+		}
+	}
+
+	void decodeBc3Alpha(const uint8_t* pBlock, uint8_t texels[16][4]) {
+		const uint32_t a0 = pBlock[0];
+		const uint32_t a1 = pBlock[1];
+		uint8_t alphas[8] = { static_cast<uint8_t>(a0), static_cast<uint8_t>(a1) };
+		if (a0 > a1) {
+			for (uint32_t i = 1; i < 7; i++) {
+				alphas[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1) / 7);
+			}
+		}
+		else {
+			for (uint32_t i = 1; i < 5; i++) {
+				alphas[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1) / 5);
+			}
+			alphas[6] = 0;
+			alphas[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		for (int byte = 0; byte < 6; byte++) {
+			indices |= uint64_t(pBlock[2 + byte]) << (8 * byte);
+		}
+		for (int texel = 0; texel < 16; texel++) {
+			texels[texel][3] = alphas[(indices >> (3 * texel)) & 7];
+		}
+	}
+
+}
+
+
+//	pIndex holds at least the header and level index.
+void Ktx2File::parseIndex(const uint8_t* pIndex, size_t indexSize, uint64_t fileSize, const char* fileName) {
+	Ktx2Header header;
+	if (indexSize < sizeof(header)) {
+		throwKtx2Error(fileName, "not a KTX2 file");
+	}
+	memcpy(&header, pIndex, sizeof(header));
+	validateHeader(header, fileName);
+
+	m_format = static_cast<VkFormat>(header.m_vkFormat);
+	m_width = header.m_pixelWidth;
+	m_height = header.m_pixelHeight;
+	const TexelBlock block = texelBlock(m_format);
+	if (block.m_size == 0) {
+		throwKtx2Error(fileName, "unsupported vkFormat");
+	}
+
+	//	A level count of 0 asks the loader to make the mips, we just take level 0.
+	const uint32_t levelCount = std::max(1u, header.m_levelCount);
+	if (sizeof(header) + levelCount * sizeof(Ktx2LevelIndex) > indexSize) {
+		throwKtx2Error(fileName, "truncated level index");
+	}
+	m_levels.clear();
+	for (uint32_t level = 0; level < levelCount; level++) {
+		Ktx2LevelIndex levelIndex;
+		memcpy(&levelIndex, pIndex + sizeof(header) + level * sizeof(levelIndex), sizeof(levelIndex));
+		if (levelIndex.m_byteLength > fileSize || levelIndex.m_byteOffset > fileSize - levelIndex.m_byteLength) {
+			throwKtx2Error(fileName, "level data past the end of the file");
+		}
+		//	The copy to the image reads every block of the level.  Divided
+		//	rather than multiplied out so a huge extent can't wrap.
+		const uint64_t blocksWide = (std::max(1u, m_width >> level) + block.m_width - 1) / block.m_width;
+		const uint64_t blocksHigh = (std::max(1u, m_height >> level) + block.m_height - 1) / block.m_height;
+		if (levelIndex.m_byteLength / block.m_size < blocksWide * blocksHigh) {
+			throwKtx2Error(fileName, "level is smaller than its extent");
+		}
+		m_levels.push_back({ static_cast<size_t>(levelIndex.m_byteOffset), static_cast<size_t>(levelIndex.m_byteLength) });
+	}
+}
+
+
+Ktx2File Ktx2File::read(const char* fileName) {
+	Ktx2File ktx2File;
+	ktx2File.m_mappedFile = MappedFile(fileName);
+	ktx2File.parseIndex(ktx2File.m_mappedFile.data(), ktx2File.m_mappedFile.size(), ktx2File.m_mappedFile.size(), fileName);
+	return ktx2File;
+}
+
+
+Ktx2File Ktx2File::readIndex(const char* fileName) {
+	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		throwKtx2Error(fileName, "failed to open file");
+	}
+	const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	Ktx2Header header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (file.gcount() != sizeof(header)) {
+		throwKtx2Error(fileName, "not a KTX2 file");
+	}
+	validateHeader(header, fileName);
+
+	const size_t indexSize = sizeof(header) + std::max(1u, header.m_levelCount) * sizeof(Ktx2LevelIndex);
+	std::vector<uint8_t> index(indexSize);
+	memcpy(index.data(), &header, sizeof(header));
+	file.read(reinterpret_cast<char*>(index.data() + sizeof(header)), indexSize - sizeof(header));
+
+	Ktx2File ktx2File;
+	ktx2File.parseIndex(index.data(), static_cast<size_t>(sizeof(header) + file.gcount()), fileSize, fileName);
+	return ktx2File;
+}
+
+
+VkFormat Ktx2File::readFormat(const char* fileName) {
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file.is_open()) {
+		throwKtx2Error(fileName, "failed to open file");
+	}
+	Ktx2Header header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (file.gcount() != sizeof(header)) {
+		throwKtx2Error(fileName, "not a KTX2 file");
+	}
+	validateHeader(header, fileName);
+	return static_cast<VkFormat>(header.m_vkFormat);
+}
+
+
+Ktx2File::TexelBlock Ktx2File::texelBlock(VkFormat vkFormat) {
+	//	The core formats are in runs that share a size.
+	if (vkFormat == VK_FORMAT_R4G4_UNORM_PACK8) {
+		return { 1 };
+	}
+	if (vkFormat >= VK_FORMAT_R4G4B4A4_UNORM_PACK16 && vkFormat <= VK_FORMAT_A1R5G5B5_UNORM_PACK16) {
+		return { 2 };
+	}
+	if (vkFormat >= VK_FORMAT_R8_UNORM && vkFormat <= VK_FORMAT_R8_SRGB) {
+		return { 1 };
+	}
+	if (vkFormat >= VK_FORMAT_R8G8_UNORM && vkFormat <= VK_FORMAT_R8G8_SRGB) {
+		return { 2 };
+	}
+	if (vkFormat >= VK_FORMAT_R8G8B8_UNORM && vkFormat <= VK_FORMAT_B8G8R8_SRGB) {
+		return { 3 };
+	}
+	if (vkFormat >= VK_FORMAT_R8G8B8A8_UNORM && vkFormat <= VK_FORMAT_A2B10G10R10_SINT_PACK32) {
+		return { 4 };
+	}
+	if (vkFormat >= VK_FORMAT_R16_UNORM && vkFormat <= VK_FORMAT_R16_SFLOAT) {
+		return { 2 };
+	}
+	if (vkFormat >= VK_FORMAT_R16G16_UNORM && vkFormat <= VK_FORMAT_R16G16_SFLOAT) {
+		return { 4 };
+	}
+	if (vkFormat >= VK_FORMAT_R16G16B16_UNORM && vkFormat <= VK_FORMAT_R16G16B16_SFLOAT) {
+		return { 6 };
+	}
+	if (vkFormat >= VK_FORMAT_R16G16B16A16_UNORM && vkFormat <= VK_FORMAT_R16G16B16A16_SFLOAT) {
+		return { 8 };
+	}
+	if (vkFormat >= VK_FORMAT_R32_UINT && vkFormat <= VK_FORMAT_R64G64B64A64_SFLOAT) {
+		//	R32 to R32G32B32A32, then R64 to R64G64B64A64, three of each.
+		const uint32_t componentCount = (vkFormat - VK_FORMAT_R32_UINT) / 3 % 4 + 1;
+		const uint32_t componentSize = vkFormat < VK_FORMAT_R64_UINT ? 4 : 8;
+		return { componentCount * componentSize };
+	}
+	if (vkFormat == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || vkFormat == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) {
+		return { 4 };
+	}
+
+	switch (vkFormat) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+	case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+		return { 8, 4, 4 };
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+	case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+		return { 16, 4, 4 };
+	default:
+		break;
+	}
+
+	//	Every ASTC block is 16 bytes, UNORM and SRGB pairs in this order.
+	static const uint32_t ASTC_BLOCK_EXTENTS[][2] = {
+		{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+		{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+	if (vkFormat >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && vkFormat <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+		const uint32_t* pExtent = ASTC_BLOCK_EXTENTS[(vkFormat - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+		return { 16, pExtent[0], pExtent[1] };
+	}
+
+	//	Depth/stencil, multi-planar and the rest.
+	return {};
+}
+
+
+bool Ktx2File::canDecompress(VkFormat vkFormat) {
+	switch (vkFormat) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+void Ktx2File::decompressToRgba8() {
+	if (!canDecompress(m_format)) {
+		throw std::runtime_error("Ktx2File: no cpu decompressor for this format");
+	}
+
+	const bool bc1Alpha = m_format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || m_format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	const bool bc1 = bc1Alpha || m_format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || m_format == VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	const bool bc2 = m_format == VK_FORMAT_BC2_UNORM_BLOCK || m_format == VK_FORMAT_BC2_SRGB_BLOCK;
+	const bool srgb =
+		m_format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || m_format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+		|| m_format == VK_FORMAT_BC2_SRGB_BLOCK || m_format == VK_FORMAT_BC3_SRGB_BLOCK;
+	const size_t blockSize = bc1 ? 8 : 16;
+
+	std::vector<uint8_t>	rgbaData;
+	std::vector<Level>		rgbaLevels;
+	for (uint32_t level = 0; level < levelCount(); level++) {
+		const uint32_t width = std::max(1u, m_width >> level);
+		const uint32_t height = std::max(1u, m_height >> level);
+		const uint32_t blocksWide = (width + 3) / 4;
+		const uint32_t blocksHigh = (height + 3) / 4;
+		if (m_levels[level].m_size < blocksWide * blocksHigh * blockSize) {
+			throw std::runtime_error("Ktx2File: level is smaller than its block count");
+		}
+
+		const size_t levelOffset = rgbaData.size();
+		rgbaData.resize(levelOffset + size_t(width) * height * 4);
+		uint8_t* pRgba = rgbaData.data() + levelOffset;
+
+		const uint8_t* pBlock = levelData(level);
+		for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++, pBlock += blockSize) {
+				uint8_t texels[16][4];
+				decodeColorBlock(pBlock + blockSize - 8, bc1, bc1Alpha, texels);
+				if (!bc1) {
+					bc2 ? decodeBc2Alpha(pBlock, texels) : decodeBc3Alpha(pBlock, texels);
+				}
+
+				//	Edge blocks hang over the level, only keep the texels inside it.
+				for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+					for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+						const size_t pixel = size_t(blockY * 4 + y) * width + blockX * 4 + x;
+						memcpy(pRgba + pixel * 4, texels[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+		rgbaLevels.push_back({ levelOffset, rgbaData.size() - levelOffset });
+	}
+
+	m_format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	m_levels = std::move(rgbaLevels);
+	m_decompressedData = std::move(rgbaData);
+	m_mappedFile = MappedFile();
+}
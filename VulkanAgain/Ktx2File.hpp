@@ -0,0 +1,65 @@
+#pragma once
+
+#define VK_USE_PLATFORM_WIN32_KHR
+#include "VulkanCpp.hpp"
+
+#include "AssetIO.hpp"
+
+
+//	The part of the KTX2 container we upload as is: a single 2d image
+//	(one layer, one face), no supercompression, a real vkFormat.
+//	Levels are in level order, level 0 is the largest.
+class Ktx2File {
+
+	void parseIndex(const uint8_t* pIndex, size_t indexSize, uint64_t fileSize, const char* fileName);
+
+public:
+
+	struct Level {
+		size_t	m_offset = 0;	//	Into the file, or into m_decompressedData once decompressed.
+		size_t	m_size = 0;
+	};
+
+	VkFormat	m_format = VK_FORMAT_UNDEFINED;
+	uint32_t	m_width = 0;
+	uint32_t	m_height = 0;
+	std::vector<Level>		m_levels;
+	MappedFile				m_mappedFile;
+	std::vector<uint8_t>	m_decompressedData;
+
+	//	Maps the file, the level data is read in place.
+	//	Throws std::runtime_error for anything we can't upload.
+	static Ktx2File read(const char* fileName);
+
+	//	Only the header and level index, for reading the levels elsewhere
+	//	(e.g. straight into staging memory).  levelData can't be used.
+	static Ktx2File readIndex(const char* fileName);
+
+	//	Only reads the header.
+	static VkFormat readFormat(const char* fileName);
+
+	uint32_t levelCount() const {
+		return static_cast<uint32_t>(m_levels.size());
+	}
+
+	const uint8_t* levelData(uint32_t level) const {
+		const uint8_t* pData = m_decompressedData.empty() ? m_mappedFile.data() : m_decompressedData.data();
+		return pData + m_levels[level].m_offset;
+	}
+
+	//	Bytes per texel block and the block's extent in texels, 1x1 when
+	//	uncompressed.  A size of 0 for formats we don't know how to lay out.
+	struct TexelBlock {
+		uint32_t	m_size = 0;
+		uint32_t	m_width = 1;
+		uint32_t	m_height = 1;
+	};
+
+	static TexelBlock texelBlock(VkFormat vkFormat);
+
+	//	BC1/BC2/BC3 can be expanded to R8G8B8A8 on the cpu for devices
+	//	without BC support.  Returns false for any other format.
+	static bool canDecompress(VkFormat vkFormat);
+	void decompressToRgba8();
+
+};
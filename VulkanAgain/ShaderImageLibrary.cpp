@@ -1,12 +1,82 @@
 #include "pragmas.hpp"
 
+#include <numeric>
+
 #include "ShaderImageLibrary.hpp"
+#include "Ktx2File.hpp"
+#include "AssetIO.hpp"
 
 #define VK_USE_PLATFORM_WIN32_KHR
 #include "VulkanCpp.hpp"
 
 std::map<std::string, vkcpp::ShaderModule> g_shaderModules;
-std::map<std::string, vkcpp::Image_Memory_View> g_ImageMemoryViews;
+std::map<std::string, vkcpp::Image_Memory_View, std::less<>> g_ImageMemoryViews;
+
+
+namespace {
+
+	//	Where an image came from, enough to load it again after eviction.
+	struct ImageSource {
+		enum class Kind {
+			NONE,		//	Can't be reloaded, so never evicted.
+			IMAGE_FILE,
+			KTX2_FILE
+		};
+
+		Kind		m_kind = Kind::NONE;
+		std::string	m_fileName;
+		bool		m_generateMipmaps = false;
+		bool		m_decompress = false;
+		AssetIOMode	m_assetIOMode = AssetIOMode::MEMORY_MAP;
+	};
+
+	//	Pixels in staging memory and what the image needs to look like.
+	struct StagedImage {
+		VkFormat	m_format = VK_FORMAT_UNDEFINED;
+		uint32_t	m_width = 0;
+		uint32_t	m_height = 0;
+		vkcpp::Buffer_DeviceMemory	m_stagingBuffer;
+		VkDeviceSize	m_size = 0;
+		std::vector<VkDeviceSize>	m_levelOffsets;		//	Every level as stored, or empty for just level 0.
+	};
+
+	struct ImageResidency {
+		enum class State {
+			RESIDENT,
+			EVICTED,
+			QUEUED,		//	Used while evicted, waiting for updateResidency to start the reload.
+			DECODING,
+			UPLOADING
+		};
+
+		ImageSource	m_source;
+		State		m_state = State::RESIDENT;
+		uint64_t	m_lastUsedFrame = 0;
+		uint64_t	m_uploadSerial = 0;
+		vkcpp::Image_Memory_View	m_loadingImage;		//	Until its upload completes.
+		bool		m_reloadFailed = false;
+	};
+
+	struct StagedReload {
+		std::string	m_imageName;
+		StagedImage	m_stagedImage;
+		std::string	m_error;
+	};
+
+	//	std::less<> so a lookup by const char* doesn't build a std::string.
+	std::map<std::string, ImageResidency, std::less<>>	g_imageResidency;
+	std::string		g_placeholderImageName;
+	uint64_t		g_totalEvictions = 0;
+	uint64_t		g_totalReloads = 0;
+
+	//	updateResidency's scratch, kept so a frame doesn't allocate.
+	std::vector<std::pair<uint64_t, const std::string*>>	g_evictable;	//	Last used frame, name.
+
+	//	Filled by the workers, emptied by updateResidency.
+	std::mutex		g_stagedReloadsMutex;
+	std::vector<StagedReload>	g_stagedReloads;
+
+}
 
 
 ShaderLibrary::~ShaderLibrary() {
@@ -22,11 +92,40 @@ void ShaderLibrary::createShaderModuleFromFile(
 	const std::string& fileName,
 	VkDevice vkDevice
 ) {
-	vkcpp::ShaderModule shaderModule = vkcpp::ShaderModule::createShaderModuleFromFile(fileName.c_str(), vkDevice);
+	//	Straight from the mapped file, no heap copy of the spir-v.
+	MappedFile mappedFile(fileName.c_str());
+	vkcpp::ShaderModule shaderModule = vkcpp::ShaderModule::createShaderModule(mappedFile.data(), mappedFile.size(), vkDevice);
 	g_shaderModules.emplace(shaderName, std::move(shaderModule));
 
 }
 
+vkcpp::Task<> ShaderLibrary::loadShaderModuleFromFile(
+	std::string shaderName,
+	std::string fileName,
+	VkDevice vkDevice,
+	vkcpp::WorkerPool& workerPool,
+	vkcpp::PollingExecutor& pollingExecutor
+) {
+	co_await workerPool.schedule();
+	vkcpp::ShaderModule shaderModule;
+	std::exception_ptr failedLoad;
+	try {
+		MappedFile mappedFile(fileName.c_str());
+		shaderModule = vkcpp::ShaderModule::createShaderModule(mappedFile.data(), mappedFile.size(), vkDevice);
+	}
+	catch (...) {
+		failedLoad = std::current_exception();
+	}
+
+	//	The map is only touched from the executor's thread,
+	//	which is also where the task should finish.
+	co_await pollingExecutor.schedule();
+	if (failedLoad) {
+		std::rethrow_exception(failedLoad);
+	}
+	g_shaderModules.emplace(shaderName, std::move(shaderModule));
+}
+
 vkcpp::ShaderModule ShaderLibrary::shaderModule(const std::string& shaderName) {
 	return g_shaderModules.at(shaderName);
 }
@@ -34,140 +133,723 @@ vkcpp::ShaderModule ShaderLibrary::shaderModule(const std::string& shaderName) {
 
 ImageLibrary::~ImageLibrary() {
 	//	Hack to control when map gets cleared out.
+	g_stagedReloads.clear();
+	g_imageResidency.clear();
 	g_ImageMemoryViews.clear();
 }
 
 
 
-void transitionImageLayout(
-	vkcpp::Image image,
-	VkFormat format,
-	VkImageLayout oldLayout,
-	VkImageLayout newLayout,
-	vkcpp::CommandPool commandPool,
-	vkcpp::Queue graphicsQueue
+void ImageLibrary::createImageMemoryViewFromFile(
+	const char* name,
+	const char* fileName,
+	vkcpp::DeviceMemoryArena& deviceMemoryArena,
+	vkcpp::Queue graphicsQueue,
+	vkcpp::SyncObjectPool& syncObjectPool
 ) {
-	//	TODO: turn into method on command buffers?
-	vkcpp::CommandBuffer commandBuffer(commandPool);
-	commandBuffer.beginOneTimeSubmit();
+	vkcpp::UploadBatch uploadBatch(deviceMemoryArena, graphicsQueue);
+	uploadBatch.setSyncObjectPool(&syncObjectPool);
+	createImageMemoryViewFromFile(name, fileName, uploadBatch);
+	uploadBatch.submitAndWait();
+}
 
-	vkcpp::ImageMemoryBarrier2 imageMemoryBarrier(oldLayout, newLayout, image);
-	vkcpp::DependencyInfo dependencyInfo;
-	dependencyInfo.addImageMemoryBarrier(imageMemoryBarrier);
-	commandBuffer.cmdPipelineBarrier2(dependencyInfo);
 
-	commandBuffer.end();
+namespace {
+
+	//	stb decodes from the mapped file instead of doing its own buffered reads.
+	stbi_uc* loadRgbaPixels(const char* fileName, int& texWidth, int& texHeight) {
+		MappedFile mappedFile(fileName);
+		int texChannels;
+		stbi_uc* pixels = stbi_load_from_memory(
+			mappedFile.data(),
+			static_cast<int>(mappedFile.size()),
+			&texWidth,
+			&texHeight,
+			&texChannels,
+			STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+		return pixels;
+	}
 
-	graphicsQueue.submit2Fenced(commandBuffer);
+	//	Blitting the chain needs linear filtering and blit in both directions.
+	bool canGenerateMipmaps(vkcpp::Device device, VkFormat format) {
+		const VkFormatFeatureFlags required =
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT
+			| VK_FORMAT_FEATURE_BLIT_DST_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		const VkFormatProperties formatProperties = device.getPhysicalDevice().getFormatProperties(format);
+		return (formatProperties.optimalTilingFeatures & required) == required;
+	}
+
+	bool canSample(vkcpp::Device device, VkFormat format) {
+		const VkFormatProperties formatProperties = device.getPhysicalDevice().getFormatProperties(format);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	//	Decodes to RGBA8.  Only touches the arena, so safe on a worker thread.
+	StagedImage stageImageFile(const char* fileName, vkcpp::UploadBatch& uploadBatch) {
+		int texWidth;
+		int texHeight;
+		stbi_uc* pixels = loadRgbaPixels(fileName, texWidth, texHeight);
+
+		StagedImage stagedImage;
+		stagedImage.m_format = VK_FORMAT_R8G8B8A8_SRGB;
+		stagedImage.m_width = texWidth;
+		stagedImage.m_height = texHeight;
+		stagedImage.m_size = VkDeviceSize(texWidth) * texHeight * 4;	//	4 == sizeof R8G8B8A8 pixel
+
+		//	Once the pixels are in staging memory we don't need them anymore.
+		stagedImage.m_stagingBuffer = uploadBatch.createStagingBuffer(stagedImage.m_size);
+		memcpy(stagedImage.m_stagingBuffer.m_mappedMemory, pixels, stagedImage.m_size);
+		stbi_image_free(pixels);
+		return stagedImage;
+	}
+
+	//	Stages every level as stored, each at an offset that suits the format's texel block.
+	//	With asyncFileName the level reads are only issued into asyncFileReader,
+	//	straight into staging, and the staging isn't filled until its waitAll.
+	//	Otherwise they are copied from the mapped (or decompressed) data.
+	//	Also safe on a worker thread.
+	StagedImage stageKtx2(
+		const Ktx2File& ktx2File,
+		const char* asyncFileName,
+		AsyncFileReader& asyncFileReader,
+		vkcpp::UploadBatch& uploadBatch
+	) {
+		StagedImage stagedImage;
+		stagedImage.m_format = ktx2File.m_format;
+		stagedImage.m_width = ktx2File.m_width;
+		stagedImage.m_height = ktx2File.m_height;
+
+		//	bufferOffset has to be a multiple of both the texel block size and 4,
+		//	and block sizes like 3, 6 and 12 aren't powers of two.
+		const VkDeviceSize levelAlignment = std::lcm<VkDeviceSize>(Ktx2File::texelBlock(ktx2File.m_format).m_size, 4);
+		for (uint32_t level = 0; level < ktx2File.levelCount(); level++) {
+			stagedImage.m_size = (stagedImage.m_size + levelAlignment - 1) / levelAlignment * levelAlignment;
+			stagedImage.m_levelOffsets.push_back(stagedImage.m_size);
+			stagedImage.m_size += ktx2File.m_levels[level].m_size;
+		}
+
+		stagedImage.m_stagingBuffer = uploadBatch.createStagingBuffer(stagedImage.m_size);
+		uint8_t* pStaging = static_cast<uint8_t*>(stagedImage.m_stagingBuffer.m_mappedMemory);
+		if (asyncFileName) {
+			for (uint32_t level = 0; level < ktx2File.levelCount(); level++) {
+				asyncFileReader.read(asyncFileName, ktx2File.m_levels[level].m_offset, ktx2File.m_levels[level].m_size, pStaging + stagedImage.m_levelOffsets[level]);
+			}
+		}
+		else {
+			for (uint32_t level = 0; level < ktx2File.levelCount(); level++) {
+				memcpy(pStaging + stagedImage.m_levelOffsets[level], ktx2File.levelData(level), ktx2File.m_levels[level].m_size);
+			}
+		}
+		return stagedImage;
+	}
+
+	//	ASYNC_READ sources only have their reads issued, so asyncFileReader
+	//	has to be waited on, and the staged image kept, before the batch is submitted.
+	StagedImage stageSource(
+		const ImageSource& source,
+		AsyncFileReader& asyncFileReader,
+		vkcpp::UploadBatch& uploadBatch
+	) {
+		const char* fileName = source.m_fileName.c_str();
+		switch (source.m_kind) {
+
+		case ImageSource::Kind::IMAGE_FILE:
+			return stageImageFile(fileName, uploadBatch);
+
+		case ImageSource::Kind::KTX2_FILE:
+			if (source.m_decompress) {
+				//	Expanding on the cpu needs the file mapped.
+				Ktx2File ktx2File = Ktx2File::read(fileName);
+				ktx2File.decompressToRgba8();
+				return stageKtx2(ktx2File, nullptr, asyncFileReader, uploadBatch);
+			}
+			if (source.m_assetIOMode == AssetIOMode::ASYNC_READ) {
+				return stageKtx2(Ktx2File::readIndex(fileName), fileName, asyncFileReader, uploadBatch);
+			}
+			return stageKtx2(Ktx2File::read(fileName), nullptr, asyncFileReader, uploadBatch);
+
+		default:
+			throw std::runtime_error("image has no source to load from");
+		}
+	}
+
+	//	One image on its own, staged once this returns.
+	StagedImage stageSource(const ImageSource& source, vkcpp::UploadBatch& uploadBatch) {
+		AsyncFileReader asyncFileReader;
+		StagedImage stagedImage = stageSource(source, asyncFileReader, uploadBatch);
+		asyncFileReader.waitAll();
+		return stagedImage;
+	}
+
+	//	Creates the image and its view and records the upload into the batch.
+	//	Only staged level 0 can have its mip chain generated.
+	vkcpp::Image_Memory_View createImageMemoryView(
+		StagedImage&& stagedImage,
+		bool generateMipmaps,
+		vkcpp::UploadBatch& uploadBatch
+	) {
+		vkcpp::DeviceMemoryArena& deviceMemoryArena = uploadBatch.deviceMemoryArena();
+		vkcpp::Device device = deviceMemoryArena.getDevice();
+		const VkExtent2D texExtent{ stagedImage.m_width, stagedImage.m_height };
+		const bool allLevelsStaged = !stagedImage.m_levelOffsets.empty();
+
+		//	Without format support we quietly fall back to the single level.
+		uint32_t mipLevels = 1;
+		if (allLevelsStaged) {
+			mipLevels = static_cast<uint32_t>(stagedImage.m_levelOffsets.size());
+		}
+		else if (generateMipmaps && canGenerateMipmaps(device, stagedImage.m_format)) {
+			mipLevels = vkcpp::ImageCreateInfo::fullMipLevelCount(texExtent);
+		}
+
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (!allLevelsStaged && mipLevels > 1) {
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;	//	Each level is blitted from the one above.
+		}
+		vkcpp::ImageCreateInfo imageCreateInfo(stagedImage.m_format, usage);
+		imageCreateInfo.setExtent(texExtent).setMipLevels(mipLevels);
+		vkcpp::Image_Memory textureImage_DeviceMemory(
+			imageCreateInfo,
+			vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
+			deviceMemoryArena);
+
+		if (allLevelsStaged) {
+			uploadBatch.addImageLevels(
+				textureImage_DeviceMemory.m_image,
+				stagedImage.m_width,
+				stagedImage.m_height,
+				std::move(stagedImage.m_stagingBuffer),
+				stagedImage.m_size,
+				std::move(stagedImage.m_levelOffsets));
+		}
+		else {
+			uploadBatch.addImage(
+				textureImage_DeviceMemory.m_image,
+				stagedImage.m_width,
+				stagedImage.m_height,
+				std::move(stagedImage.m_stagingBuffer),
+				stagedImage.m_size,
+				mipLevels);
+		}
+
+		//	Shaders are accessed through image views, not directly from images.
+		vkcpp::ImageViewCreateInfo imageViewCreateInfo(
+			textureImage_DeviceMemory.m_image,
+			VK_IMAGE_VIEW_TYPE_2D,
+			stagedImage.m_format,
+			VK_IMAGE_ASPECT_COLOR_BIT);
+		imageViewCreateInfo.setMipLevels(mipLevels);
+		vkcpp::ImageView imageView(imageViewCreateInfo, device);
+
+		return vkcpp::Image_Memory_View(
+			std::move(textureImage_DeviceMemory.m_image),
+			std::move(textureImage_DeviceMemory.m_deviceMemory),
+			std::move(imageView));
+	}
+
+	void emplaceImageMemoryView(
+		const char* name,
+		const ImageSource& source,
+		vkcpp::Image_Memory_View&& image_memory_view
+	) {
+		g_ImageMemoryViews.emplace(name, std::move(image_memory_view));
+		ImageResidency imageResidency;
+		imageResidency.m_source = source;
+		g_imageResidency.emplace(name, std::move(imageResidency));
+	}
+
+	//	The library's maps are only touched from the executor's thread.
+	vkcpp::Task<> loadImageMemoryView(
+		std::string name,
+		std::function<ImageSource()> selectSource,
+		vkcpp::UploadBatch& uploadBatch,
+		vkcpp::WorkerPool& workerPool,
+		vkcpp::PollingExecutor& pollingExecutor
+	) {
+		//	Until it is resident useImageView hands out the placeholder.
+		ImageResidency loadingResidency;
+		loadingResidency.m_state = ImageResidency::State::DECODING;
+		g_imageResidency.emplace(name, std::move(loadingResidency));
+
+		std::exception_ptr failedLoad;
+		try {
+			co_await workerPool.schedule();
+			const ImageSource source = selectSource();
+			StagedImage stagedImage = stageSource(source, uploadBatch);
+
+			co_await pollingExecutor.schedule();
+			g_imageResidency.at(name).m_source = source;
+			vkcpp::Image_Memory_View image_memory_view =
+				createImageMemoryView(std::move(stagedImage), source.m_generateMipmaps, uploadBatch);
+			const uint64_t uploadSerial = uploadBatch.submit();
+
+			co_await pollingExecutor.until([&uploadBatch, uploadSerial] { return uploadBatch.completed(uploadSerial); });
+			g_ImageMemoryViews.insert_or_assign(name, std::move(image_memory_view));
+			g_imageResidency.at(name).m_state = ImageResidency::State::RESIDENT;
+		}
+		catch (...) {
+			failedLoad = std::current_exception();
+		}
+		if (failedLoad) {
+			//	Possibly still on a worker, the residency belongs to the executor's thread.
+			co_await pollingExecutor.schedule();
+			ImageResidency& imageResidency = g_imageResidency.at(name);
+			imageResidency.m_state = ImageResidency::State::EVICTED;
+			imageResidency.m_reloadFailed = true;
+			std::rethrow_exception(failedLoad);
+		}
+	}
+
+	//	First encoding the device can sample directly wins, otherwise
+	//	one we can decode on the cpu.
+	ImageSource selectKtx2Source(
+		const std::vector<const char*>& fileNames,
+		vkcpp::Device device,
+		AssetIOMode assetIOMode
+	) {
+		ImageSource source;
+		source.m_kind = ImageSource::Kind::KTX2_FILE;
+		source.m_assetIOMode = assetIOMode;
+
+		for (const char* fileName : fileNames) {
+			if (canSample(device, Ktx2File::readFormat(fileName))) {
+				source.m_fileName = fileName;
+				return source;
+			}
+		}
+
+		for (const char* fileName : fileNames) {
+			if (Ktx2File::canDecompress(Ktx2File::readFormat(fileName))) {
+				source.m_fileName = fileName;
+				source.m_decompress = true;
+				return source;
+			}
+		}
+
+		throw std::runtime_error(std::string(fileNames.front()) + ": no encoding this device can sample or we can decompress");
+	}
+
+	//	Device local heaps, less the space already free in our own blocks.
+	void deviceLocalBudget(
+		vkcpp::DeviceMemoryArena& deviceMemoryArena,
+		double budgetFraction,
+		VkDeviceSize& budget,
+		VkDeviceSize& usage
+	) {
+		vkcpp::PhysicalDevice physicalDevice = deviceMemoryArena.getDevice().getPhysicalDevice();
+		const VkPhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getPhysicalDeviceMemoryProperties();
+		const VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget = physicalDevice.getMemoryBudget();
+
+		budget = 0;
+		usage = 0;
+		for (uint32_t heapIndex = 0; heapIndex < memoryProperties.memoryHeapCount; heapIndex++) {
+			if ((memoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+				continue;
+			}
+			budget += static_cast<VkDeviceSize>(memoryBudget.heapBudget[heapIndex] * budgetFraction);
+			const VkDeviceSize freeInArena = deviceMemoryArena.freeBytesInHeap(heapIndex);
+			const VkDeviceSize heapUsage = memoryBudget.heapUsage[heapIndex];
+			usage += heapUsage > freeInArena ? heapUsage - freeInArena : 0;
+		}
+	}
 
 }
 
 
-void copyBufferToImage(
-	vkcpp::Buffer buffer,
-	vkcpp::Image image,
-	int width,
-	int height,
-	vkcpp::CommandPool commandPool,
-	vkcpp::Queue graphicsQueue
+void ImageLibrary::createImageMemoryViewFromFile(
+	const char* name,
+	const char* fileName,
+	vkcpp::UploadBatch& uploadBatch,
+	bool generateMipmaps
+) {
+	ImageSource source;
+	source.m_kind = ImageSource::Kind::IMAGE_FILE;
+	source.m_fileName = fileName;
+	source.m_generateMipmaps = generateMipmaps;
+
+	emplaceImageMemoryView(
+		name,
+		source,
+		createImageMemoryView(stageSource(source, uploadBatch), generateMipmaps, uploadBatch));
+}
+
+
+void ImageLibrary::createImageMemoryViewsFromFiles(
+	const std::vector<ImageFile>& imageFiles,
+	vkcpp::UploadBatch& uploadBatch,
+	vkcpp::WorkerPool& workerPool,
+	bool generateMipmaps,
+	VkDeviceSize submitThreshold
 ) {
-	//	TODO: turn into method on command buffers?
-	vkcpp::CommandBuffer commandBuffer(commandPool);
-	commandBuffer.beginOneTimeSubmit();
-	commandBuffer.cmdCopyBufferToImage(buffer, image, width, height);
-	commandBuffer.end();
+	struct DecodedImage {
+		size_t		m_fileIndex = 0;
+		StagedImage	m_stagedImage;
+		std::string	m_error;
+	};
+
+	std::vector<ImageSource> sources(imageFiles.size());
+	for (size_t fileIndex = 0; fileIndex < imageFiles.size(); fileIndex++) {
+		sources[fileIndex].m_kind = ImageSource::Kind::IMAGE_FILE;
+		sources[fileIndex].m_fileName = imageFiles[fileIndex].m_fileName;
+		sources[fileIndex].m_generateMipmaps = generateMipmaps;
+	}
 
-	graphicsQueue.submit2Fenced(commandBuffer);
+	std::mutex	decodedMutex;
+	std::condition_variable	decodedAvailable;
+	std::vector<DecodedImage>	decodedImages;
+
+	//	Anything thrown on this thread is held until every enqueued job has
+	//	reported, since the jobs use the locals above.
+	std::exception_ptr firstError;
+	size_t enqueued = 0;
+	try {
+		for (size_t fileIndex = 0; fileIndex < imageFiles.size(); fileIndex++) {
+			workerPool.enqueue([&, fileIndex] {
+				DecodedImage decodedImage;
+				decodedImage.m_fileIndex = fileIndex;
+				try {
+					//	The arena is thread safe, so the copy into staging happens here too.
+					decodedImage.m_stagedImage = stageSource(sources[fileIndex], uploadBatch);
+				}
+				catch (const std::exception& e) {
+					decodedImage.m_error = e.what();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(decodedMutex);
+					decodedImages.push_back(std::move(decodedImage));
+				}
+				decodedAvailable.notify_one();
+				});
+			enqueued++;
+		}
+	}
+	catch (...) {
+		firstError = std::current_exception();
+	}
+
+	//	Every job reports back exactly once, so this also keeps the
+	//	locals above alive until the workers are done with them.
+	for (size_t received = 0; received < enqueued;) {
+		std::vector<DecodedImage> ready;
+		{
+			std::unique_lock<std::mutex> lock(decodedMutex);
+			decodedAvailable.wait(lock, [&] { return !decodedImages.empty(); });
+			ready.swap(decodedImages);
+		}
+		received += ready.size();
+
+		if (firstError) {
+			continue;
+		}
+		try {
+			for (DecodedImage& decodedImage : ready) {
+				const ImageFile& imageFile = imageFiles[decodedImage.m_fileIndex];
+				if (!decodedImage.m_error.empty()) {
+					throw std::runtime_error(std::string(imageFile.m_fileName) + ": " + decodedImage.m_error);
+				}
+				try {
+					emplaceImageMemoryView(
+						imageFile.m_imageName,
+						sources[decodedImage.m_fileIndex],
+						createImageMemoryView(std::move(decodedImage.m_stagedImage), generateMipmaps, uploadBatch));
+				}
+				catch (const std::exception& e) {
+					throw std::runtime_error(std::string(imageFile.m_fileName) + ": " + e.what());
+				}
+			}
+
+			if (uploadBatch.pendingBytes() >= submitThreshold) {
+				uploadBatch.submit();
+			}
+		}
+		catch (...) {
+			firstError = std::current_exception();
+		}
+	}
+
+	if (firstError) {
+		std::rethrow_exception(firstError);
+	}
 }
 
 
-void ImageLibrary::createImageMemoryViewFromFile(
+void ImageLibrary::createImageMemoryViewFromKtx2File(
 	const char* name,
 	const char* fileName,
-	vkcpp::Device device,
-	vkcpp::CommandPool commandPool,
-	vkcpp::Queue graphicsQueue
+	vkcpp::UploadBatch& uploadBatch,
+	AssetIOMode assetIOMode
 ) {
-	const VkFormat targetFormat = VK_FORMAT_R8G8B8A8_SRGB;
-
-	int texWidth;
-	int texHeight;
-	int texChannels;
-
-	stbi_uc* pixels = stbi_load(fileName, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (!pixels) {
-		throw std::runtime_error("failed to load texture image!");
-	}
-
-	const VkDeviceSize imageSize = texWidth * texHeight * 4;	//	4 == sizeof R8G8B8A8 pixel
-
-	//	Make a device (gpu) staging buffer and copy the pixels into it.
-	vkcpp::Buffer_DeviceMemory stagingBuffer_DeviceMemoryMapped(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		imageSize,
-		graphicsQueue.m_queueFamilyIndex,
-		vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
-		pixels,
-		device);
-
-	stbi_image_free(pixels);	//	Don't need these pixels anymore.  Pixels are on gpu now.
-	pixels = nullptr;
-
-	//	Make our target image and memory.
-	VkExtent2D texExtent;
-	texExtent.width = texWidth;
-	texExtent.height = texHeight;
-	vkcpp::Image_Memory textureImage_DeviceMemory(
-		texExtent,
-		targetFormat,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
-		device);
-
-	//	Change image format to be best target for transfer into.
-	transitionImageLayout(
-		textureImage_DeviceMemory.m_image,
-		targetFormat,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		commandPool,
-		graphicsQueue);
-
-	//	Copy image pixels from staging buffer into image memory.
-	copyBufferToImage(
-		stagingBuffer_DeviceMemoryMapped.m_buffer,
-		textureImage_DeviceMemory.m_image,
-		texWidth,
-		texHeight,
-		commandPool,
-		graphicsQueue);
-
-	//	Now transition the image layout to best for shader images.
-	transitionImageLayout(
-		textureImage_DeviceMemory.m_image,
-		targetFormat,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		commandPool,
-		graphicsQueue);
-
-	//	Shaders are accessed through image views, not directly from images.
-	vkcpp::ImageViewCreateInfo textureImageViewCreateInfo(
-		textureImage_DeviceMemory.m_image,
-		VK_IMAGE_VIEW_TYPE_2D,
-		targetFormat,
-		VK_IMAGE_ASPECT_COLOR_BIT);
-	vkcpp::ImageView textureImageView(textureImageViewCreateInfo, device);
-
-	vkcpp::Image_Memory_View image_memory_view(
-		std::move(textureImage_DeviceMemory.m_image),
-		std::move(textureImage_DeviceMemory.m_deviceMemory),
-		std::move(textureImageView));
-
-	g_ImageMemoryViews.emplace(name, std::move(image_memory_view));
+	createImageMemoryViewsFromKtx2Files({ { name, { fileName } } }, uploadBatch, assetIOMode);
+}
+
+
+void ImageLibrary::createImageMemoryViewFromKtx2Files(
+	const char* name,
+	const std::vector<const char*>& fileNames,
+	vkcpp::UploadBatch& uploadBatch,
+	AssetIOMode assetIOMode
+) {
+	createImageMemoryViewsFromKtx2Files({ { name, fileNames } }, uploadBatch, assetIOMode);
+}
+
+
+void ImageLibrary::createImageMemoryViewsFromKtx2Files(
+	const std::vector<Ktx2Image>& ktx2Images,
+	vkcpp::UploadBatch& uploadBatch,
+	AssetIOMode assetIOMode
+) {
+	vkcpp::Device device = uploadBatch.deviceMemoryArena().getDevice();
+
+	std::vector<ImageSource> sources;
+	for (const Ktx2Image& ktx2Image : ktx2Images) {
+		if (ktx2Image.m_fileNames.empty()) {
+			throw std::runtime_error(std::string(ktx2Image.m_imageName) + ": no files");
+		}
+		sources.push_back(selectKtx2Source(ktx2Image.m_fileNames, device, assetIOMode));
+	}
+
+	//	The reader goes first on the way out, so the staging stays alive
+	//	until any reads still in flight are done with it.
+	std::vector<StagedImage> stagedImages;
+	AsyncFileReader asyncFileReader;
+	for (const ImageSource& source : sources) {
+		stagedImages.push_back(stageSource(source, asyncFileReader, uploadBatch));
+	}
+	asyncFileReader.waitAll();
+
+	for (size_t imageIndex = 0; imageIndex < ktx2Images.size(); imageIndex++) {
+		emplaceImageMemoryView(
+			ktx2Images[imageIndex].m_imageName,
+			sources[imageIndex],
+			createImageMemoryView(std::move(stagedImages[imageIndex]), false, uploadBatch));
+	}
 }
 
 
 vkcpp::ImageView ImageLibrary::imageView(const char* name) {
 	return g_ImageMemoryViews.at(name).m_imageView;
-}
\ No newline at end of file
+}
+
+
+vkcpp::Task<> ImageLibrary::loadImageMemoryViewFromFile(
+	std::string name,
+	std::string fileName,
+	vkcpp::UploadBatch& uploadBatch,
+	vkcpp::WorkerPool& workerPool,
+	vkcpp::PollingExecutor& pollingExecutor,
+	bool generateMipmaps
+) {
+	return loadImageMemoryView(
+		name,
+		[fileName, generateMipmaps] {
+			ImageSource source;
+			source.m_kind = ImageSource::Kind::IMAGE_FILE;
+			source.m_fileName = fileName;
+			source.m_generateMipmaps = generateMipmaps;
+			return source;
+		},
+		uploadBatch,
+		workerPool,
+		pollingExecutor);
+}
+
+
+vkcpp::Task<> ImageLibrary::loadImageMemoryViewFromKtx2Files(
+	std::string name,
+	std::vector<std::string> fileNames,
+	vkcpp::UploadBatch& uploadBatch,
+	vkcpp::WorkerPool& workerPool,
+	vkcpp::PollingExecutor& pollingExecutor,
+	AssetIOMode assetIOMode
+) {
+	if (fileNames.empty()) {
+		throw std::runtime_error("loadImageMemoryViewFromKtx2Files: no files");
+	}
+	vkcpp::Device device = uploadBatch.deviceMemoryArena().getDevice();
+
+	//	Picking the encoding reads the file headers, so it happens on the worker too.
+	return loadImageMemoryView(
+		name,
+		[fileNames, device, assetIOMode] {
+			std::vector<const char*> fileNamePointers;
+			for (const std::string& fileName : fileNames) {
+				fileNamePointers.push_back(fileName.c_str());
+			}
+			return selectKtx2Source(fileNamePointers, device, assetIOMode);
+		},
+		uploadBatch,
+		workerPool,
+		pollingExecutor);
+}
+
+
+void ImageLibrary::createPlaceholderImage(
+	const char* name,
+	uint32_t rgba,
+	vkcpp::UploadBatch& uploadBatch
+) {
+	StagedImage stagedImage;
+	stagedImage.m_format = VK_FORMAT_R8G8B8A8_UNORM;
+	stagedImage.m_width = 1;
+	stagedImage.m_height = 1;
+	stagedImage.m_size = sizeof(rgba);
+	stagedImage.m_stagingBuffer = uploadBatch.createStagingBuffer(stagedImage.m_size);
+	const uint8_t pixel[4] = {
+		uint8_t(rgba >> 24), uint8_t(rgba >> 16), uint8_t(rgba >> 8), uint8_t(rgba) };
+	memcpy(stagedImage.m_stagingBuffer.m_mappedMemory, pixel, sizeof(pixel));
+
+	emplaceImageMemoryView(
+		name,
+		ImageSource(),
+		createImageMemoryView(std::move(stagedImage), false, uploadBatch));
+	g_placeholderImageName = name;
+}
+
+
+vkcpp::ImageView ImageLibrary::useImageView(const char* name, uint64_t frameNumber) {
+	auto foundResidency = g_imageResidency.find(std::string_view(name));
+	if (foundResidency == g_imageResidency.end()) {
+		throw std::runtime_error(std::string(name) + ": no such image");
+	}
+	ImageResidency& imageResidency = foundResidency->second;
+	imageResidency.m_lastUsedFrame = frameNumber;
+
+	if (imageResidency.m_state == ImageResidency::State::RESIDENT) {
+		return g_ImageMemoryViews.find(std::string_view(name))->second.m_imageView;
+	}
+	if (imageResidency.m_state == ImageResidency::State::EVICTED && !imageResidency.m_reloadFailed) {
+		imageResidency.m_state = ImageResidency::State::QUEUED;
+	}
+	if (g_placeholderImageName.empty()) {
+		throw std::runtime_error(std::string(name) + ": not resident and there is no placeholder image");
+	}
+	return g_ImageMemoryViews.at(g_placeholderImageName).m_imageView;
+}
+
+
+ImageLibrary::ResidencyStats ImageLibrary::updateResidency(
+	uint64_t frameNumber,
+	uint32_t framesInFlight,
+	vkcpp::UploadBatch& uploadBatch,
+	vkcpp::WorkerPool& workerPool,
+	double budgetFraction
+) {
+	//	Staged by the workers: create the images and send the copies off.
+	std::vector<StagedReload> stagedReloads;
+	{
+		std::lock_guard<std::mutex> lock(g_stagedReloadsMutex);
+		stagedReloads.swap(g_stagedReloads);
+	}
+	std::vector<ImageResidency*> submitted;
+	for (StagedReload& stagedReload : stagedReloads) {
+		ImageResidency& imageResidency = g_imageResidency.at(stagedReload.m_imageName);
+		if (stagedReload.m_error.empty()) {
+			try {
+				imageResidency.m_loadingImage = createImageMemoryView(
+					std::move(stagedReload.m_stagedImage),
+					imageResidency.m_source.m_generateMipmaps,
+					uploadBatch);
+				imageResidency.m_state = ImageResidency::State::UPLOADING;
+				submitted.push_back(&imageResidency);
+				continue;
+			}
+			catch (const std::exception& e) {
+				stagedReload.m_error = e.what();
+			}
+		}
+		//	Keep showing the placeholder rather than retrying every frame.
+		std::cout << "reload of " << stagedReload.m_imageName << " failed: " << stagedReload.m_error << "\n";
+		imageResidency.m_state = ImageResidency::State::EVICTED;
+		imageResidency.m_reloadFailed = true;
+	}
+	if (!submitted.empty()) {
+		const uint64_t uploadSerial = uploadBatch.submit();
+		for (ImageResidency* pImageResidency : submitted) {
+			pImageResidency->m_uploadSerial = uploadSerial;
+		}
+	}
+
+	ResidencyStats stats;
+	g_evictable.clear();
+
+	for (auto& [name, imageResidency] : g_imageResidency) {
+		switch (imageResidency.m_state) {
+
+		case ImageResidency::State::UPLOADING:
+			if (uploadBatch.completed(imageResidency.m_uploadSerial)) {
+				g_ImageMemoryViews.insert_or_assign(name, std::move(imageResidency.m_loadingImage));
+				imageResidency.m_loadingImage = vkcpp::Image_Memory_View();
+				imageResidency.m_state = ImageResidency::State::RESIDENT;
+				g_totalReloads++;
+			}
+			break;
+
+		case ImageResidency::State::QUEUED:
+			imageResidency.m_state = ImageResidency::State::DECODING;
+			workerPool.enqueue([&uploadBatch, imageName = name, source = imageResidency.m_source] {
+				StagedReload stagedReload;
+				stagedReload.m_imageName = imageName;
+				try {
+					stagedReload.m_stagedImage = stageSource(source, uploadBatch);
+				}
+				catch (const std::exception& e) {
+					stagedReload.m_error = e.what();
+				}
+				std::lock_guard<std::mutex> lock(g_stagedReloadsMutex);
+				g_stagedReloads.push_back(std::move(stagedReload));
+				});
+			break;
+
+		case ImageResidency::State::RESIDENT:
+			//	The gpu may still be reading anything used by a frame in flight.
+			if (imageResidency.m_source.m_kind != ImageSource::Kind::NONE
+				&& imageResidency.m_lastUsedFrame + framesInFlight <= frameNumber) {
+				g_evictable.emplace_back(imageResidency.m_lastUsedFrame, &name);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		switch (imageResidency.m_state) {
+		case ImageResidency::State::RESIDENT: stats.m_residentCount++; break;
+		case ImageResidency::State::EVICTED: stats.m_evictedCount++; break;
+		default: stats.m_loadingCount++; break;
+		}
+	}
+
+	static const bool s_memoryBudgetSupported =
+		uploadBatch.deviceMemoryArena().getDevice().getPhysicalDevice().supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (s_memoryBudgetSupported) {
+		deviceLocalBudget(uploadBatch.deviceMemoryArena(), budgetFraction, stats.m_budget, stats.m_usage);
+
+		//	Least recently used first, until what we've let go of covers the overage.
+		std::sort(g_evictable.begin(), g_evictable.end(),
+			[](const auto& a, const auto& b) {
+				return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+			});
+		VkDeviceSize evictedBytes = 0;
+		for (const auto& [lastUsedFrame, pName] : g_evictable) {
+			if (stats.m_usage <= stats.m_budget + evictedBytes) {
+				break;
+			}
+			auto found = g_ImageMemoryViews.find(*pName);
+			evictedBytes += found->second.m_deviceMemory.size();
+			g_ImageMemoryViews.erase(found);
+			g_imageResidency.at(*pName).m_state = ImageResidency::State::EVICTED;
+			g_totalEvictions++;
+			stats.m_residentCount--;
+			stats.m_evictedCount++;
+		}
+	}
+
+	stats.m_totalEvictions = g_totalEvictions;
+	stats.m_totalReloads = g_totalReloads;
+	return stats;
+}
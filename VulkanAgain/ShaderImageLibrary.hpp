@@ -3,6 +3,8 @@
 #define VK_USE_PLATFORM_WIN32_KHR
 #include "VulkanCpp.hpp"
 
+#include "AssetIO.hpp"
+
 class ShaderLibrary {
 
 public:
@@ -15,6 +17,16 @@ public:
 		const std::string& fileName,
 		VkDevice vkDevice);
 
+	//	Reads the file and creates the module on the worker pool, then adds it to
+	//	the library from the executor's thread.  shaderModule can't find it until
+	//	the task is done.
+	static vkcpp::Task<> loadShaderModuleFromFile(
+		std::string shaderName,
+		std::string fileName,
+		VkDevice vkDevice,
+		vkcpp::WorkerPool& workerPool,
+		vkcpp::PollingExecutor& pollingExecutor);
+
 	static vkcpp::ShaderModule shaderModule(const std::string& shaderName);
 
 
@@ -31,11 +43,127 @@ public:
 	static void createImageMemoryViewFromFile(
 		const char* imageName,
 		const char* fileName,
-		vkcpp::Device device,
-		vkcpp::CommandPool commandPool,
-		vkcpp::Queue graphicsQueue);
+		vkcpp::DeviceMemoryArena& deviceMemoryArena,
+		vkcpp::Queue graphicsQueue,
+		vkcpp::SyncObjectPool& syncObjectPool);
+
+	//	Records the upload into the batch.  The image can be used
+	//	once the batch has been submitted and waited on.
+	//	generateMipmaps blits a full mip chain on the gpu when the format allows it.
+	static void createImageMemoryViewFromFile(
+		const char* imageName,
+		const char* fileName,
+		vkcpp::UploadBatch& uploadBatch,
+		bool generateMipmaps = false);
+
+	struct ImageFile {
+		const char* m_imageName;
+		const char* m_fileName;
+	};
+
+	//	Decodes the files on the worker pool, each straight into its own staging
+	//	buffer.  This thread creates the images as decodes finish and submits the
+	//	copies every submitThreshold bytes, so uploads run behind the decoding.
+	//	The images can be used once the batch has been waited on.
+	static void createImageMemoryViewsFromFiles(
+		const std::vector<ImageFile>& imageFiles,
+		vkcpp::UploadBatch& uploadBatch,
+		vkcpp::WorkerPool& workerPool,
+		bool generateMipmaps = false,
+		VkDeviceSize submitThreshold = 32 * 1024 * 1024);
+
+	//	Uploads a KTX2 container with all its levels as stored, e.g. BCn/ASTC/ETC2 blocks.
+	//	If the device can't sample its format, BC1-3 are expanded to RGBA8 on the cpu.
+	//	ASYNC_READ reads the levels from disk straight into staging memory.
+	static void createImageMemoryViewFromKtx2File(
+		const char* imageName,
+		const char* fileName,
+		vkcpp::UploadBatch& uploadBatch,
+		AssetIOMode assetIOMode = AssetIOMode::MEMORY_MAP);
+
+	//	Same, given the one texture in several encodings (say BC7, ASTC and ETC2),
+	//	uses the first whose format the device supports.
+	static void createImageMemoryViewFromKtx2Files(
+		const char* imageName,
+		const std::vector<const char*>& fileNames,
+		vkcpp::UploadBatch& uploadBatch,
+		AssetIOMode assetIOMode = AssetIOMode::MEMORY_MAP);
+
+	struct Ktx2Image {
+		const char* m_imageName;
+		std::vector<const char*> m_fileNames;	//	Encodings of the one texture.
+	};
+
+	//	Same for many textures.  With ASYNC_READ every level read of every
+	//	file is issued before any is waited on, so they are all in flight together.
+	static void createImageMemoryViewsFromKtx2Files(
+		const std::vector<Ktx2Image>& ktx2Images,
+		vkcpp::UploadBatch& uploadBatch,
+		AssetIOMode assetIOMode = AssetIOMode::MEMORY_MAP);
 
 	static vkcpp::ImageView imageView(
 		const char* imageName);
 
+
+	//	Asynchronous loading.  The read and decode run on the worker pool, the
+	//	upload is recorded and submitted from the executor's thread, which the
+	//	task then returns to once the upload's fence has signaled.  Until then
+	//	useImageView hands out the placeholder, so frames can keep going.
+	//	The batch, pool and executor must outlive the task.
+	static vkcpp::Task<> loadImageMemoryViewFromFile(
+		std::string imageName,
+		std::string fileName,
+		vkcpp::UploadBatch& uploadBatch,
+		vkcpp::WorkerPool& workerPool,
+		vkcpp::PollingExecutor& pollingExecutor,
+		bool generateMipmaps = false);
+
+	static vkcpp::Task<> loadImageMemoryViewFromKtx2Files(
+		std::string imageName,
+		std::vector<std::string> fileNames,
+		vkcpp::UploadBatch& uploadBatch,
+		vkcpp::WorkerPool& workerPool,
+		vkcpp::PollingExecutor& pollingExecutor,
+		AssetIOMode assetIOMode = AssetIOMode::MEMORY_MAP);
+
+
+	//	Residency.  Images loaded from files remember where they came from, so when
+	//	device local memory is over budget the least recently used ones can be
+	//	evicted, and loaded again in the background the next time they are used.
+
+	//	A 1x1 image bound in place of images that aren't resident.  Never evicted.
+	static void createPlaceholderImage(
+		const char* imageName,
+		uint32_t rgba,
+		vkcpp::UploadBatch& uploadBatch);
+
+	//	The view to bind for frameNumber: the image's own if it is resident,
+	//	otherwise the placeholder's, and the image is queued to be loaded again.
+	static vkcpp::ImageView useImageView(
+		const char* imageName,
+		uint64_t frameNumber);
+
+	struct ResidencyStats {
+		uint32_t	m_residentCount = 0;
+		uint32_t	m_loadingCount = 0;
+		uint32_t	m_evictedCount = 0;
+		uint64_t	m_totalEvictions = 0;
+		uint64_t	m_totalReloads = 0;
+		VkDeviceSize	m_budget = 0;		//	Device local heaps, already scaled by budgetFraction.
+		VkDeviceSize	m_usage = 0;
+	};
+
+	//	Once per frame, before the frame's useImageView calls.  Finishes reloads whose
+	//	uploads have completed, starts queued ones decoding on the worker pool, then
+	//	evicts least recently used images while over budget.  Nothing is ever waited on.
+	//	Images used in the last framesInFlight frames may still be read by the gpu and
+	//	are not evicted.  Without VK_EXT_memory_budget nothing is evicted.
+	//	The batch and pool must outlive any reloads still running.
+	static ResidencyStats updateResidency(
+		uint64_t frameNumber,
+		uint32_t framesInFlight,
+		vkcpp::UploadBatch& uploadBatch,
+		vkcpp::WorkerPool& workerPool,
+		double budgetFraction = 0.9);
+
 };
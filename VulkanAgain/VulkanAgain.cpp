@@ -9,6 +9,8 @@
 #include <chrono>
 #include <map>
 #include <variant>
+#include <cstdlib>
+#include <new>
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 
@@ -39,9 +41,13 @@ public:
 	static const uint32_t	PRESENTATION_QUEUE_FAMILY_INDEX = 0;
 	static const uint32_t	PRESENTATION_QUEUE_INDEX = 0;
 
+	static const uint32_t	TRANSFER_QUEUE_INDEX = 0;
+	static const uint32_t	COMPUTE_QUEUE_INDEX = 0;
+
 	static const int VERTEX_BINDING_INDEX = 0;
 
 	static const int	UBO_DESCRIPTOR_BINDING_INDEX = 0;
+	static const int	MAX_UNIFORM_SLICES_PER_FRAME = 4096;
 	static const int	TEXTURE_DESCRIPTOR_BINDING_INDEX = 1;
 
 
@@ -64,6 +70,13 @@ class VulkanGpuAssets {
 		vulkanInstanceCreateInfo.addExtension("VK_EXT_debug_utils");
 		vulkanInstanceCreateInfo.addExtension("VK_KHR_surface");
 		vulkanInstanceCreateInfo.addExtension("VK_KHR_win32_surface");
+		//	Needed by VK_EXT_swapchain_maintenance1 on the device.
+		if (vkcpp::InstanceExtensionProperties::supportsExtension(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME)
+			&& vkcpp::InstanceExtensionProperties::supportsExtension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME)) {
+			vulkanInstanceCreateInfo.addExtension(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+			vulkanInstanceCreateInfo.addExtension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+			m_surfaceMaintenance1 = true;
+		}
 
 		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = vkcpp::DebugUtilsMessenger::getCreateInfo();
 		vulkanInstanceCreateInfo.pNext = &debugCreateInfo;
@@ -74,9 +87,33 @@ class VulkanGpuAssets {
 	vkcpp::Device createDevice(vkcpp::PhysicalDevice physicalDevice) {
 		vkcpp::DeviceCreateInfo deviceCreateInfo;
 		deviceCreateInfo.addExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		//	Texture residency evicts against the heap budgets.
+		if (physicalDevice.supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+			deviceCreateInfo.addExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
 
 		deviceCreateInfo.addDeviceQueue(MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX, 1);
 		deviceCreateInfo.addDeviceQueue(MagicValues::PRESENTATION_QUEUE_FAMILY_INDEX, 1);
+		if (m_transferQueueFamilyIndex != MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX) {
+			deviceCreateInfo.addDeviceQueue(m_transferQueueFamilyIndex, 1);
+		}
+		if (m_computeQueueFamilyIndex != MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX) {
+			deviceCreateInfo.addDeviceQueue(m_computeQueueFamilyIndex, 1);
+		}
+
+		//	GPU driven drawing takes the draw count from a buffer.
+		if (physicalDevice.getVulkan12Features().drawIndirectCount) {
+			deviceCreateInfo.enableDrawIndirectCount();
+			m_drawIndirectCount = true;
+		}
+
+		//	Present fences say when an old swapchain's images are free.
+		if (m_surfaceMaintenance1
+			&& physicalDevice.supportsExtension(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)
+			&& physicalDevice.getSwapchainMaintenance1Features().swapchainMaintenance1) {
+			deviceCreateInfo.enableSwapchainMaintenance1();
+			m_swapchainMaintenance1 = true;
+		}
 
 		VkPhysicalDeviceFeatures2 vkPhysicalDeviceFeatures2 = physicalDevice.getPhysicalDeviceFeatures2();
 		deviceCreateInfo.pNext = &vkPhysicalDeviceFeatures2;
@@ -94,6 +131,33 @@ class VulkanGpuAssets {
 			MagicValues::PRESENTATION_QUEUE_FAMILY_INDEX,
 			MagicValues::PRESENTATION_QUEUE_INDEX);
 
+		//	Without a transfer-only family this is just the graphics queue.
+		m_transferQueue = m_device.getDeviceQueue(
+			m_transferQueueFamilyIndex,
+			MagicValues::TRANSFER_QUEUE_INDEX);
+
+		//	Likewise without a compute family that can't do graphics.
+		m_computeQueue = m_device.getDeviceQueue(
+			m_computeQueueFamilyIndex,
+			MagicValues::COMPUTE_QUEUE_INDEX);
+
+		//	One timeline per VkQueue, set before the queues are copied around.
+		m_graphicsTimeline = std::make_unique<vkcpp::GpuTimeline>(m_device);
+		m_graphicsQueue.setTimeline(m_graphicsTimeline.get());
+		if (static_cast<VkQueue>(m_transferQueue) == static_cast<VkQueue>(m_graphicsQueue)) {
+			m_transferQueue.setTimeline(m_graphicsTimeline.get());
+		}
+		else {
+			m_transferTimeline = std::make_unique<vkcpp::GpuTimeline>(m_device);
+			m_transferQueue.setTimeline(m_transferTimeline.get());
+		}
+		if (static_cast<VkQueue>(m_computeQueue) == static_cast<VkQueue>(m_graphicsQueue)) {
+			m_computeQueue.setTimeline(m_graphicsTimeline.get());
+		}
+		else {
+			m_computeTimeline = std::make_unique<vkcpp::GpuTimeline>(m_device);
+			m_computeQueue.setTimeline(m_computeTimeline.get());
+		}
 	}
 
 
@@ -103,6 +167,19 @@ public:
 
 	vkcpp::Queue				m_graphicsQueue;
 	vkcpp::Queue				m_presentationQueue;
+	vkcpp::Queue				m_transferQueue;
+	vkcpp::Queue				m_computeQueue;
+
+	//	Signaled by every submit to their queues.
+	std::unique_ptr<vkcpp::GpuTimeline>	m_graphicsTimeline;
+	std::unique_ptr<vkcpp::GpuTimeline>	m_transferTimeline;	//	None when it is the graphics queue.
+	std::unique_ptr<vkcpp::GpuTimeline>	m_computeTimeline;	//	Likewise.
+
+	uint32_t	m_transferQueueFamilyIndex = MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX;
+	uint32_t	m_computeQueueFamilyIndex = MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX;
+	bool		m_drawIndirectCount = false;
+	bool		m_surfaceMaintenance1 = false;		//	On the instance.
+	bool		m_swapchainMaintenance1 = false;
 
 	vkcpp::VulkanInstance	vulkanInstance() {
 		return m_vulkanInstance;
@@ -119,6 +196,18 @@ public:
 
 		m_physicalDevice = m_vulkanInstance.getPhysicalDevice(0);
 
+		//	A transfer-only family is usually backed by dma engines,
+		//	so copies there run alongside rendering.
+		m_transferQueueFamilyIndex = m_physicalDevice.findQueueFamilyIndex(
+			VK_QUEUE_TRANSFER_BIT,
+			VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT).value_or(MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX);
+
+		//	Async compute: a compute family without graphics gets its own
+		//	hardware queue, so dispatches there overlap rendering.
+		m_computeQueueFamilyIndex = m_physicalDevice.findQueueFamilyIndex(
+			VK_QUEUE_COMPUTE_BIT,
+			VK_QUEUE_GRAPHICS_BIT).value_or(MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX);
+
 		m_device = createDevice(m_physicalDevice);
 
 		createQueues();
@@ -129,6 +218,18 @@ public:
 
 VulkanGpuAssets	g_vulkanGpuAssets;
 
+//	Declared after the gpu assets so it is destroyed before the device,
+//	and before anything that allocates from it so it is destroyed after them.
+vkcpp::DeviceMemoryArena	g_deviceMemoryArena(g_vulkanGpuAssets.m_device);
+
+//	Fences and semaphores for the uploads and the swapchain acquires.
+//	After the device, before anything that gives them back.
+vkcpp::SyncObjectPool	g_syncObjectPool(g_vulkanGpuAssets.m_device);
+
+//	Things the frames in flight may still use, e.g. framebuffers from
+//	before a resize, are let go once the graphics timeline passes them.
+vkcpp::DeferredDeletionQueue	g_deferredDeletionQueue(*g_vulkanGpuAssets.m_graphicsTimeline);
+
 
 
 
@@ -152,6 +253,9 @@ std::vector<ShaderName> g_shaderNames{
 	{ "textureFrag", "C:/Shaders/VulkanTriangle/textureFrag.spv"},
 	{ "identityFrag", "C:/Shaders/VulkanTriangle/identityFrag.spv"} };
 
+//	Only loaded when there's a GpuDrawCuller to use it.
+ShaderName g_cullDrawsShaderName{ "cullDraws", "C:/Shaders/VulkanTriangle/cullDraws.spv" };
+
 
 
 
@@ -252,6 +356,25 @@ public:
 		return m_vertices.data();
 	}
 
+	//	Center of the points' bounds in xyz, distance to the farthest point in w.
+	glm::vec4 boundingSphere() const {
+		if (m_points.empty()) {
+			return glm::vec4(0.0f);
+		}
+		glm::vec3 low = m_points[0].m_pos;
+		glm::vec3 high = low;
+		for (const Point& point : m_points) {
+			low = glm::min(low, point.m_pos);
+			high = glm::max(high, point.m_pos);
+		}
+		const glm::vec3 center = (low + high) * 0.5f;
+		float radius = 0.0f;
+		for (const Point& point : m_points) {
+			radius = std::max(radius, glm::length(point.m_pos - center));
+		}
+		return glm::vec4(center, radius);
+	}
+
 	Shape add(const Shape& shape);
 
 	void addOffset(double x, double y, double z, int16_t pointStartIndex, int16_t pointCount) {
@@ -475,15 +598,26 @@ class PointVertexDeviceBuffer {
 
 public:
 
+	//	STATIC geometry is copied once into device local memory.
+	//	DYNAMIC geometry stays host visible so the cpu can rewrite it in place,
+	//	at the cost of every vertex fetch going across the bus on discrete gpus.
+	enum class Placement {
+		STATIC,
+		DYNAMIC
+	};
+
 	vkcpp::Buffer_DeviceMemory m_points;
 	vkcpp::Buffer_DeviceMemory m_vertices;
 	uint32_t	m_vertexCount = 0;
+	Placement	m_placement = Placement::STATIC;
+	glm::vec4	m_boundingSphere{};		//	For culling, in model space.
 
 	PointVertexDeviceBuffer() {}
 
+	//	DYNAMIC.
 	PointVertexDeviceBuffer(
 		PointVertexBuffer& pointVertexBuffer,
-		vkcpp::Device device) {
+		vkcpp::DeviceMemoryArena& deviceMemoryArena) {
 
 		//	TODO: combine point and vertex device memory into one object.
 		//	Pay attention to the terminology change.
@@ -493,7 +627,7 @@ public:
 			MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
 			vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
 			pointVertexBuffer.pointData(),
-			device);
+			deviceMemoryArena);
 
 		//	Pay attention to the terminology change.
 		m_vertices = vkcpp::Buffer_DeviceMemory(
@@ -502,15 +636,47 @@ public:
 			MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
 			vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
 			pointVertexBuffer.vertexData(),
-			device);
+			deviceMemoryArena);
 
 		m_vertexCount = pointVertexBuffer.vertexCount();
+		m_placement = Placement::DYNAMIC;
+		m_boundingSphere = pointVertexBuffer.boundingSphere();
+	}
+
+	//	STATIC.  The data is staged right away, the buffers can't be
+	//	drawn until the upload batch has been waited on.
+	PointVertexDeviceBuffer(
+		PointVertexBuffer& pointVertexBuffer,
+		vkcpp::DeviceMemoryArena& deviceMemoryArena,
+		vkcpp::UploadBatch& uploadBatch) {
+
+		m_points = vkcpp::Buffer_DeviceMemory(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			pointVertexBuffer.pointsSizeof(),
+			MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+			vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
+			deviceMemoryArena);
+		uploadBatch.addBuffer(m_points.m_buffer, pointVertexBuffer.pointData(), pointVertexBuffer.pointsSizeof());
+
+		m_vertices = vkcpp::Buffer_DeviceMemory(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			pointVertexBuffer.verticesSizeof(),
+			MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+			vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
+			deviceMemoryArena);
+		uploadBatch.addBuffer(m_vertices.m_buffer, pointVertexBuffer.vertexData(), pointVertexBuffer.verticesSizeof());
+
+		m_vertexCount = pointVertexBuffer.vertexCount();
+		m_placement = Placement::STATIC;
+		m_boundingSphere = pointVertexBuffer.boundingSphere();
 	}
 
 	PointVertexDeviceBuffer(const PointVertexDeviceBuffer& other)
 		: m_points(other.m_points)
 		, m_vertices(other.m_vertices)
-		, m_vertexCount(other.m_vertexCount) {
+		, m_vertexCount(other.m_vertexCount)
+		, m_placement(other.m_placement)
+		, m_boundingSphere(other.m_boundingSphere) {
 	}
 
 	PointVertexDeviceBuffer& operator=(const PointVertexDeviceBuffer& other) {
@@ -525,7 +691,9 @@ public:
 	PointVertexDeviceBuffer(PointVertexDeviceBuffer&& other) noexcept
 		: m_points(std::move(other.m_points))
 		, m_vertices(std::move(other.m_vertices))
-		, m_vertexCount(other.m_vertexCount) {
+		, m_vertexCount(other.m_vertexCount)
+		, m_placement(other.m_placement)
+		, m_boundingSphere(other.m_boundingSphere) {
 	}
 
 	PointVertexDeviceBuffer& operator=(PointVertexDeviceBuffer&& other) noexcept {
@@ -541,14 +709,24 @@ public:
 		return m_vertexCount;
 	}
 
-	void draw(vkcpp::CommandBuffer commandBuffer) {
-		//	TODO: move to command buffer methods
-		VkBuffer vkPointBuffer = m_points.m_buffer;
-		VkBuffer pointBuffers[] = { vkPointBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, pointBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_vertices.m_buffer, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdDrawIndexed(commandBuffer, vertexCount(), 1, 0, 0, 0);
+	//	With a tracked command buffer, back to back draws of the same
+	//	buffer only bind it once.
+	void draw(vkcpp::CommandBuffer commandBuffer, uint32_t instanceCount = 1) {
+		commandBuffer.cmdBindVertexBuffer(0, m_points.m_buffer);
+		commandBuffer.cmdBindIndexBuffer(m_vertices.m_buffer, VK_INDEX_TYPE_UINT16);
+		commandBuffer.cmdDrawIndexed(vertexCount(), instanceCount);
+	}
+
+	//	The draws come from the gpu, see GpuDrawCuller.
+	void drawIndirectCount(
+		vkcpp::CommandBuffer	commandBuffer,
+		vkcpp::Buffer			drawCommandsBuffer,
+		vkcpp::Buffer			drawCountBuffer,
+		uint32_t				maxDrawCount
+	) {
+		commandBuffer.cmdBindVertexBuffer(0, m_points.m_buffer);
+		commandBuffer.cmdBindIndexBuffer(m_vertices.m_buffer, VK_INDEX_TYPE_UINT16);
+		commandBuffer.cmdDrawIndexedIndirectCount(drawCommandsBuffer, drawCountBuffer, maxDrawCount);
 	}
 
 
@@ -582,10 +760,21 @@ public:
 	PointVertexDeviceBuffer		g_pointVertexDeviceBuffer0;
 	PointVertexDeviceBuffer		g_pointVertexDeviceBuffer1;
 
-	vkcpp::CommandPool		g_commandPoolOriginal;
-
 	vkcpp::Sampler g_textureSampler;
 
+	//	Records the renderer's draw lists alongside the render thread.
+	vkcpp::WorkerPool	g_recordingWorkerPool;
+
+	//	The frame's submits, on every queue, go out together.
+	vkcpp::SubmitBatch	g_submitBatch;
+
+	//	Asset loads and reloads of evicted textures.  Last so these
+	//	go first, the loads before what they use.
+	vkcpp::WorkerPool	g_streamingWorkerPool;
+	vkcpp::PollingExecutor	g_assetExecutor;
+	std::unique_ptr<vkcpp::UploadBatch>	g_streamingUploadBatch;
+	std::vector<vkcpp::Task<>>	g_assetLoads;
+
 };
 
 Globals g_globals;
@@ -673,6 +862,28 @@ public:
 		m_modelViewProjTransform.m_projTransform[1][1] *= -1.0;
 
 	}
+
+	//	The view frustum in the model's space, normals facing in and of
+	//	unit length: a sphere is outside when
+	//	dot(plane.xyz, center) + plane.w < -radius for any plane.
+	//	The radius only carries over for rigid model transforms.
+	void frustumPlanes(const glm::mat4& modelTransform, glm::vec4 planes[6]) const {
+		const glm::mat4 clipTransform = m_modelViewProjTransform.m_projTransform
+			* m_modelViewProjTransform.m_viewTransform * modelTransform;
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++) {
+			rows[row] = glm::vec4(clipTransform[0][row], clipTransform[1][row], clipTransform[2][row], clipTransform[3][row]);
+		}
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[2];			//	Vulkan depth is [0, 1].
+		planes[5] = rows[3] - rows[2];
+		for (int plane = 0; plane < 6; plane++) {
+			planes[plane] /= glm::length(glm::vec3(planes[plane]));
+		}
+	}
 };
 
 
@@ -681,41 +892,34 @@ Camera g_theCamera;
 
 class UniformBufferMemory {
 
-	static inline	int									s_uniformMemoryBuffersCount;
-	static inline	std::vector<UniformBufferMemory>	s_uniformMemoryBufferMemorys;
-
-	UniformBufferMemory(vkcpp::Device device) {
-		m_uniformBufferMemory = std::move(
-			vkcpp::Buffer_DeviceMemory(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				sizeof(ModelViewProjTransform),
-				MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
-				vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
-				device
-			));
-	}
+	//	One ring segment per drawing frame.  Each draw gets its own
+	//	slice and binds it with a dynamic offset.
+	static inline	int							s_segmentCount;
+	static inline	vkcpp::UniformRingBuffer	s_uniformRingBuffer;
 
 public:
 
-	vkcpp::Buffer_DeviceMemory m_uniformBufferMemory;
-
 	static void setUniformBufferMemoryCount(int count) {
-		s_uniformMemoryBuffersCount = count;
+		s_segmentCount = count;
 	}
 
-	static void createUniformBufferMemorys(vkcpp::Device device) {
-		for (int i = 0; i < s_uniformMemoryBuffersCount; i++) {
-			s_uniformMemoryBufferMemorys.push_back(std::move(UniformBufferMemory(device)));
-		}
+	static void createUniformBufferMemorys(vkcpp::DeviceMemoryArena& deviceMemoryArena) {
+		s_uniformRingBuffer = vkcpp::UniformRingBuffer(
+			sizeof(ModelViewProjTransform),
+			MagicValues::MAX_UNIFORM_SLICES_PER_FRAME,
+			s_segmentCount,
+			MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+			deviceMemoryArena);
 	}
 
-	static UniformBufferMemory& get(int index) {
-		return s_uniformMemoryBufferMemorys.at(index);
+	static vkcpp::Buffer buffer() {
+		return s_uniformRingBuffer.buffer();
 	}
 
 
-	//	TODO: better uniform buffer handling.
-	static void updateUniformBuffer(
+	//	Starts this frame's slices and returns the frame's base transform.
+	//	Only call after the frame's last submit has been waited on.
+	static ModelViewProjTransform beginFrame(
 		int					index,
 		const VkExtent2D	swapchainImageExtent
 	) {
@@ -724,6 +928,8 @@ public:
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+		s_uniformRingBuffer.beginSegment(index);
+
 		//	TODO: the camera should be updated as part of the
 		//	global game loop and then its info pulled in.
 		g_theCamera.update(swapchainImageExtent);
@@ -736,11 +942,12 @@ public:
 				time * glm::radians(10.0f),
 				glm::vec3(0.0f, 1.0f, 0.0f));
 
+		return modelViewProjTransform;
+	}
 
-		//	TODO: Maybe use some kind of templated version of the mapped memory?
-		vkcpp::Buffer_DeviceMemory& buffer_deviceMemory =
-			s_uniformMemoryBufferMemorys.at(index).m_uniformBufferMemory;
-		*((ModelViewProjTransform*)buffer_deviceMemory.m_mappedMemory) = modelViewProjTransform;
+	//	Returns the dynamic offset for the draw.
+	static uint32_t push(const ModelViewProjTransform& modelViewProjTransform) {
+		return s_uniformRingBuffer.push(modelViewProjTransform);
 	}
 
 };
@@ -751,6 +958,7 @@ class DescriptorSetWithBinding {
 
 	static inline int								s_descriptorSetCount;
 	static inline std::vector<vkcpp::DescriptorSet>	s_descriptorSets;
+	static inline std::vector<VkImageView>			s_textureImageViews;	//	What each set has bound.
 
 
 	vkcpp::DescriptorSet m_descriptorSet;
@@ -772,10 +980,11 @@ public:
 			s_descriptorSets.emplace_back(descriptorSetLayout, descriptorPool);
 			vkcpp::DescriptorSet& descriptorSet = s_descriptorSets.back();
 
+			//	Range is one slice, the dynamic offset picks which one.
 			descriptorSet.addWriteDescriptor(
 				MagicValues::UBO_DESCRIPTOR_BINDING_INDEX,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				UniformBufferMemory::get(i).m_uniformBufferMemory.m_buffer,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+				UniformBufferMemory::buffer(),
 				sizeof(ModelViewProjTransform));
 			descriptorSet.addWriteDescriptor(
 				MagicValues::TEXTURE_DESCRIPTOR_BINDING_INDEX,
@@ -783,6 +992,7 @@ public:
 				textureImageView,
 				textureSampler);
 			descriptorSet.updateDescriptors();
+			s_textureImageViews.push_back(textureImageView);
 
 		}
 	}
@@ -791,6 +1001,28 @@ public:
 		return s_descriptorSets.at(index);
 	}
 
+	//	Only while the drawing frame using the set isn't in flight.
+	//	Returns true if the set was rewritten, which invalidates any
+	//	command buffer recorded with it bound.
+	static bool setTextureImageView(
+		int							index,
+		vkcpp::ImageView			textureImageView,
+		vkcpp::Sampler				textureSampler
+	) {
+		if (s_textureImageViews.at(index) == static_cast<VkImageView>(textureImageView)) {
+			return false;
+		}
+		s_textureImageViews[index] = textureImageView;
+		vkcpp::DescriptorSet& descriptorSet = s_descriptorSets.at(index);
+		descriptorSet.addWriteDescriptor(
+			MagicValues::TEXTURE_DESCRIPTOR_BINDING_INDEX,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			textureImageView,
+			textureSampler);
+		descriptorSet.updateDescriptors();
+		return true;
+	}
+
 
 };
 
@@ -816,23 +1048,24 @@ public:
 	//	Frames remember their index for convenience.
 	//	The frame index is used as the index into the
 	//	other data arrays that hold the per frame data.
-	vkcpp::Fence			m_inFlightFence;
+	//	The graphics timeline value of the frame's last submit, the frame
+	//	is free to draw again once it is reached.  Filled in by the submit batch.
+	uint64_t				m_submittedTimelineValue = 0;
+	//	From the sync object pool, a fresh one for each acquire.
 	vkcpp::Semaphore		m_swapchainImageAvailableSemaphore;
 	vkcpp::Semaphore		m_renderFinishedSemaphore;
+	//	Reset wholesale once the last submit is done, the frame's
+	//	command buffer is handed out fresh each time it is recorded.
+	vkcpp::TransientCommandAllocator	m_commandAllocator;
 	vkcpp::CommandBuffer	m_commandBuffer;
 	int						m_index = 0;
 
 private:
 
 
-	void createCommandBuffer(vkcpp::CommandPool commandPool) {
-		m_commandBuffer = std::move(vkcpp::CommandBuffer(commandPool));
-	}
-
 	void createSyncObjects() {
-		m_swapchainImageAvailableSemaphore = std::move(vkcpp::Semaphore(m_device));
+		m_swapchainImageAvailableSemaphore = g_syncObjectPool.acquireSemaphore();
 		m_renderFinishedSemaphore = std::move(vkcpp::Semaphore(m_device));
-		m_inFlightFence = std::move(vkcpp::Fence(m_device, VKCPP_FENCE_CREATE_OPENED));
 	}
 
 public:
@@ -844,10 +1077,11 @@ public:
 
 	static void createDrawingFrames(
 		vkcpp::Device& device,
-		vkcpp::CommandPool& commandPool
+		uint32_t queueFamilyIndex
 	) {
 		for (int i = 0; i < s_frameCount; i++) {
-			s_drawingFrames.emplace_back(device, commandPool);
+			s_drawingFrames.emplace_back(device, queueFamilyIndex);
+			s_drawingFrames.back().m_index = i;
 		}
 	}
 
@@ -864,10 +1098,10 @@ public:
 
 	DrawingFrame(
 		vkcpp::Device device,
-		vkcpp::CommandPool commandPool
+		uint32_t queueFamilyIndex
 	) {
 		m_device = device;
-		createCommandBuffer(commandPool);
+		m_commandAllocator = vkcpp::TransientCommandAllocator(queueFamilyIndex, device);
 		createSyncObjects();
 	}
 
@@ -890,7 +1124,7 @@ ImageLibrary	g_imageLibrary;		//	Hack to control when image library is cleared o
 
 
 std::vector<vkcpp::DescriptorSetLayoutBinding>	g_descriptorSetLayoutBindings{
-	{ MagicValues::UBO_DESCRIPTOR_BINDING_INDEX, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,	vkcpp::SHADER_STAGE_VERTEX},
+	{ MagicValues::UBO_DESCRIPTOR_BINDING_INDEX, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,	vkcpp::SHADER_STAGE_VERTEX},
 	{ MagicValues::TEXTURE_DESCRIPTOR_BINDING_INDEX, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	vkcpp::SHADER_STAGE_FRAGMENT}
 };
 
@@ -901,7 +1135,7 @@ vkcpp::DescriptorPool createDescriptorPool(VkDevice vkDevice) {
 	vkcpp::DescriptorPoolCreateInfo poolCreateInfo;
 	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
-	poolCreateInfo.addDescriptorCount(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT);
+	poolCreateInfo.addDescriptorCount(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT);
 	poolCreateInfo.addDescriptorCount(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT);
 
 	poolCreateInfo.maxSets = static_cast<uint32_t>(MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT);
@@ -993,68 +1227,390 @@ vkcpp::DescriptorPool createDescriptorPool(VkDevice vkDevice) {
 
 
 
-//	TODO: need to tie together pipelines and subpasses better.
-//	Right now, it's just magic numbers from the subpass number.
-vkcpp::RenderPass createRenderPass(
-	VkFormat swapchainImageFormat,
-	vkcpp::Device device
-) {
-	vkcpp::RenderPassCreateInfo renderPassCreateInfo;
+//	Times the same instanced draw from STATIC and DYNAMIC copies of one
+//	geometry with gpu timestamps, alternating placements frame by frame.
+//	The extra instances all land at the same depth, so after the first
+//	one the fragments are rejected early and vertex fetch dominates.
+class VertexPlacementBenchmark {
 
-	//	Note that the index of the attachment can be pulled out
-	//	of the returned attachment reference to use in other
-	//	attachment references.
-	VkAttachmentReference colorAttachmentReference = renderPassCreateInfo.addAttachment(
-		vkcpp::AttachmentDescription::simpleColorAttachmentPresentDescription(swapchainImageFormat),
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	);
+	static const uint32_t	INSTANCE_COUNT = 4096;
+	static const uint32_t	FRAMES_PER_PLACEMENT = 120;
 
-	VkAttachmentReference depthAttachmentReference = renderPassCreateInfo.addAttachment(
-		vkcpp::AttachmentDescription::simpleDepthAttachmentDescription(),
-		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-	);
+	PointVertexDeviceBuffer	m_staticBuffer;
+	PointVertexDeviceBuffer	m_dynamicBuffer;
+	vkcpp::QueryPool		m_queryPool;		//	Begin and end per drawing frame.
+	double					m_nanosPerTick = 0.0;
 
+	//	What each drawing frame's queries are measuring, if anything.
+	std::vector<std::optional<PointVertexDeviceBuffer::Placement>>	m_pending;
 
+	bool		m_running = false;
+	uint32_t	m_recordedFrameCount = 0;
+	uint32_t	m_sampleCount[2] = {};
+	double		m_totalNanos[2] = {};
 
-	//	Just a handy abbreviation
-	const VkPipelineStageFlags bothFragmentTests
-		= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
-		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	static int index(PointVertexDeviceBuffer::Placement placement) {
+		return placement == PointVertexDeviceBuffer::Placement::STATIC ? 0 : 1;
+	}
 
+	bool sampled() const {
+		return m_sampleCount[0] >= FRAMES_PER_PLACEMENT && m_sampleCount[1] >= FRAMES_PER_PLACEMENT;
+	}
 
-	renderPassCreateInfo.addSubpass()
-		.addColorAttachmentReference(colorAttachmentReference)
-		.setDepthStencilAttachmentReference(depthAttachmentReference);
+public:
 
+	void create(
+		PointVertexBuffer& pointVertexBuffer,
+		vkcpp::DeviceMemoryArena& deviceMemoryArena,
+		vkcpp::UploadBatch& uploadBatch,
+		float timestampPeriod,
+		int drawingFrameCount,
+		VkDevice vkDevice) {
+
+		m_staticBuffer = PointVertexDeviceBuffer(pointVertexBuffer, deviceMemoryArena, uploadBatch);
+		m_dynamicBuffer = PointVertexDeviceBuffer(pointVertexBuffer, deviceMemoryArena);
+		m_queryPool = vkcpp::QueryPool(2 * drawingFrameCount, vkDevice);
+		m_nanosPerTick = timestampPeriod;
+		m_pending.assign(drawingFrameCount, std::nullopt);
+	}
 
-	//	All depth stencil attachment writes have to finish before
-	//	any new depth stencil attachment reads or writes.
-	renderPassCreateInfo.addSubpassDependency(VK_SUBPASS_EXTERNAL, 0)
-		.addSrc(bothFragmentTests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
-		.addDst(bothFragmentTests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+	bool running() const {
+		return m_running;
+	}
 
-	renderPassCreateInfo.addSubpassDependency(VK_SUBPASS_EXTERNAL, 0)
-		.addSrc(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)
-		.addDst(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT);
+	void start() {
+		if (!m_queryPool || m_nanosPerTick == 0.0) {
+			std::cout << "vertex placement benchmark: no timestamp support\n";
+			return;
+		}
+		m_running = true;
+		m_recordedFrameCount = 0;
+		m_sampleCount[0] = m_sampleCount[1] = 0;
+		m_totalNanos[0] = m_totalNanos[1] = 0.0;
+	}
 
+	//	Once the drawing frame's last submit is done, before it is recorded again.
+	void collect(int drawingFrameIndex) {
+		std::optional<PointVertexDeviceBuffer::Placement>& pending = m_pending[drawingFrameIndex];
+		if (!pending) {
+			return;
+		}
+		uint64_t timestamps[2];
+		if (m_queryPool.getResults(2 * drawingFrameIndex, 2, timestamps)) {
+			m_totalNanos[index(*pending)] += (timestamps[1] - timestamps[0]) * m_nanosPerTick;
+			m_sampleCount[index(*pending)]++;
+		}
+		pending.reset();
+
+		if (!m_running && sampled()) {
+			const double staticMicros = m_totalNanos[0] / m_sampleCount[0] / 1000.0;
+			const double dynamicMicros = m_totalNanos[1] / m_sampleCount[1] / 1000.0;
+			std::cout << "vertex placement benchmark: " << INSTANCE_COUNT << " instances of "
+				<< m_staticBuffer.vertexCount() << " vertices, average of " << FRAMES_PER_PLACEMENT << " frames\n";
+			std::cout << "  device local: " << staticMicros << " us\n";
+			std::cout << "  host visible: " << dynamicMicros << " us\n";
+			m_sampleCount[0] = m_sampleCount[1] = 0;
+		}
+	}
 
-	renderPassCreateInfo.addSubpass()
-		.addColorAttachmentReference(colorAttachmentReference)
-		.setDepthStencilAttachmentReference(depthAttachmentReference);
+	//	Outside the render pass.
+	void beginFrame(vkcpp::CommandBuffer commandBuffer, int drawingFrameIndex) {
+		if (!m_running) {
+			return;
+		}
+		commandBuffer.cmdResetQueryPool(m_queryPool, 2 * drawingFrameIndex, 2);
+	}
 
-	renderPassCreateInfo.addSubpassDependency(0, 1)
-		.addSrc(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)
-		.addDst(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	//	Inside the first subpass, with its pipeline and descriptors bound.
+	void draw(vkcpp::CommandBuffer commandBuffer, int drawingFrameIndex) {
+		if (!m_running) {
+			return;
+		}
+		PointVertexDeviceBuffer& pointVertexDeviceBuffer =
+			(m_recordedFrameCount % 2) == 0 ? m_staticBuffer : m_dynamicBuffer;
+		commandBuffer.cmdWriteTimestamp2(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_queryPool, 2 * drawingFrameIndex);
+		pointVertexDeviceBuffer.draw(commandBuffer, INSTANCE_COUNT);
+		commandBuffer.cmdWriteTimestamp2(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_queryPool, 2 * drawingFrameIndex + 1);
+		m_pending[drawingFrameIndex] = pointVertexDeviceBuffer.m_placement;
+
+		m_recordedFrameCount++;
+		if (m_recordedFrameCount == 2 * FRAMES_PER_PLACEMENT) {
+			m_running = false;		//	The last results come in through collect.
+		}
+	}
+
+};
+
+VertexPlacementBenchmark g_vertexPlacementBenchmark;
+
+//	GPU driven drawing of one geometry's objects.  Each frame a compute
+//	pass tests every object's bounding sphere against the camera frustum
+//	and appends a VkDrawIndexedIndirectCommand for each one left, then a
+//	single vkCmdDrawIndexedIndirectCount draws them.  The cpu only writes
+//	the frustum each frame, so its cost doesn't grow with the object count.
+//	firstInstance is the object's index for shaders that fetch per object
+//	data.  vert4 doesn't yet, so every object draws where its geometry is.
+//
+//	The shader is cullDraws.comp, built into cullDraws.spv by the project.
+class GpuDrawCuller {
+
+public:
+
+	//	std430, matches the shader.
+	struct Object {
+		glm::vec4	m_boundingSphere;	//	Center in model space, w is the radius.
+		uint32_t	m_indexCount = 0;
+		uint32_t	m_instanceCount = 1;
+		uint32_t	m_firstInstance = 0;
+		uint32_t	m_pad = 0;
+	};
+
+	static const uint32_t	MAX_OBJECTS = 256 * 1024;
+
+private:
+
+	static const uint32_t	WORKGROUP_SIZE = 64;
+
+	static const int	PARAMS_BINDING_INDEX = 0;
+	static const int	OBJECTS_BINDING_INDEX = 1;
+	static const int	DRAW_COMMANDS_BINDING_INDEX = 2;
+	static const int	DRAW_COUNT_BINDING_INDEX = 3;
+
+	//	std140, matches the shader.
+	struct CullParams {
+		glm::vec4	m_frustumPlanes[6];
+		uint32_t	m_objectCount;
+	};
+
+	//	One set per drawing frame, only touched once the frame's last submit is done.
+	struct FrameResources {
+		vkcpp::Buffer_DeviceMemory	m_params;
+		vkcpp::Buffer_DeviceMemory	m_objects;			//	Rewritten when the objects change.
+		vkcpp::Buffer_DeviceMemory	m_drawCommands;
+		vkcpp::Buffer_DeviceMemory	m_drawCount;
+		vkcpp::DescriptorSet		m_descriptorSet;
+		uint64_t	m_objectsGeneration = 0;
+	};
+
+	vkcpp::DescriptorSetLayout	m_descriptorSetLayout;
+	vkcpp::DescriptorPool		m_descriptorPool;		//	Before the frames, so their sets are freed first.
+	vkcpp::PipelineLayout		m_pipelineLayout;
+	vkcpp::ComputePipeline		m_pipeline;
+	std::vector<FrameResources>	m_frames;
+
+	std::vector<Object>	m_objects;
+	uint64_t	m_objectsGeneration = 1;
+
+public:
+
+	static Object object(const PointVertexDeviceBuffer& pointVertexDeviceBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0) {
+		Object object;
+		object.m_boundingSphere = pointVertexDeviceBuffer.m_boundingSphere;
+		object.m_indexCount = pointVertexDeviceBuffer.m_vertexCount;
+		object.m_instanceCount = instanceCount;
+		object.m_firstInstance = firstInstance;
+		return object;
+	}
+
+	void create(
+		vkcpp::ShaderModule			cullShaderModule,
+		vkcpp::DeviceMemoryArena&	deviceMemoryArena,
+		int							drawingFrameCount,
+		VkDevice					vkDevice
+	) {
+		vkcpp::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+		descriptorSetLayoutCreateInfo
+			.addBinding(PARAMS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vkcpp::SHADER_STAGE_COMPUTE)
+			.addBinding(OBJECTS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vkcpp::SHADER_STAGE_COMPUTE)
+			.addBinding(DRAW_COMMANDS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vkcpp::SHADER_STAGE_COMPUTE)
+			.addBinding(DRAW_COUNT_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vkcpp::SHADER_STAGE_COMPUTE);
+		m_descriptorSetLayout = vkcpp::DescriptorSetLayout(descriptorSetLayoutCreateInfo, vkDevice);
+
+		vkcpp::DescriptorPoolCreateInfo poolCreateInfo;
+		poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolCreateInfo.addDescriptorCount(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, drawingFrameCount);
+		poolCreateInfo.addDescriptorCount(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * drawingFrameCount);
+		poolCreateInfo.maxSets = static_cast<uint32_t>(drawingFrameCount);
+		m_descriptorPool = vkcpp::DescriptorPool(poolCreateInfo, vkDevice);
+
+		vkcpp::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+		pipelineLayoutCreateInfo.addDescriptorSetLayout(m_descriptorSetLayout);
+		m_pipelineLayout = vkcpp::PipelineLayout(pipelineLayoutCreateInfo, vkDevice);
+
+		vkcpp::ComputePipelineCreateInfo pipelineCreateInfo;
+		pipelineCreateInfo.setShaderModule(cullShaderModule, "main");
+		pipelineCreateInfo.setPipelineLayout(m_pipelineLayout);
+		m_pipeline = vkcpp::ComputePipeline(pipelineCreateInfo, vkDevice);
+
+		m_frames.resize(drawingFrameCount);
+		for (FrameResources& frame : m_frames) {
+			//	The objects are read across the bus, but only the changes are written.
+			frame.m_params = vkcpp::Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				sizeof(CullParams),
+				MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+				vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
+				deviceMemoryArena);
+			frame.m_objects = vkcpp::Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				MAX_OBJECTS * sizeof(Object),
+				MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+				vkcpp::MEMORY_PROPERTY_HOST_VISIBLE | vkcpp::MEMORY_PROPERTY_HOST_COHERENT,
+				deviceMemoryArena);
+			frame.m_drawCommands = vkcpp::Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				MAX_OBJECTS * sizeof(VkDrawIndexedIndirectCommand),
+				MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+				vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
+				deviceMemoryArena);
+			frame.m_drawCount = vkcpp::Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				sizeof(uint32_t),
+				MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+				vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL,
+				deviceMemoryArena);
+
+			frame.m_descriptorSet = vkcpp::DescriptorSet(m_descriptorSetLayout, m_descriptorPool);
+			frame.m_descriptorSet.addWriteDescriptor(
+				PARAMS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.m_params.m_buffer, sizeof(CullParams));
+			frame.m_descriptorSet.addWriteDescriptor(
+				OBJECTS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.m_objects.m_buffer, frame.m_objects.m_buffer.size());
+			frame.m_descriptorSet.addWriteDescriptor(
+				DRAW_COMMANDS_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.m_drawCommands.m_buffer, frame.m_drawCommands.m_buffer.size());
+			frame.m_descriptorSet.addWriteDescriptor(
+				DRAW_COUNT_BINDING_INDEX, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.m_drawCount.m_buffer, sizeof(uint32_t));
+			frame.m_descriptorSet.updateDescriptors();
+		}
+	}
+
+	bool created() const {
+		return !m_frames.empty();
+	}
+
+	uint32_t objectCount() const {
+		return static_cast<uint32_t>(m_objects.size());
+	}
+
+	//	The frames pick the objects up as they are recorded.  Recorded
+	//	command buffers dispatch for the old count, so need invalidating.
+	void setObjects(std::vector<Object> objects) {
+		if (objects.size() > MAX_OBJECTS) {
+			throw std::runtime_error("GpuDrawCuller: too many objects");
+		}
+		m_objects = std::move(objects);
+		m_objectsGeneration++;
+	}
+
+	//	Every frame, once the drawing frame's last submit is done, whether
+	//	or not its command buffer is recorded again.
+	void beginFrame(int drawingFrameIndex, const glm::vec4 frustumPlanes[6]) {
+		FrameResources& frame = m_frames.at(drawingFrameIndex);
+		if (frame.m_objectsGeneration != m_objectsGeneration) {
+			if (!m_objects.empty()) {
+				memcpy(frame.m_objects.m_mappedMemory, m_objects.data(), m_objects.size() * sizeof(Object));
+			}
+			frame.m_objectsGeneration = m_objectsGeneration;
+		}
+		CullParams* pCullParams = static_cast<CullParams*>(frame.m_params.m_mappedMemory);
+		std::copy(frustumPlanes, frustumPlanes + 6, pCullParams->m_frustumPlanes);
+		pCullParams->m_objectCount = objectCount();
+	}
+
+	//	Outside the render pass, before recordDraws.  queueFamilyIndex is
+	//	the command buffer's.  On graphics the draws are ordered after the
+	//	cull by the render graph, from the draw buffers' usages.  Other than
+	//	graphics, e.g. an async compute queue, the draw buffers are released
+	//	to graphics, whose command buffer has to recordAcquire them.
+	void recordCull(
+		vkcpp::CommandBuffer	commandBuffer,
+		int						drawingFrameIndex,
+		uint32_t				queueFamilyIndex = MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX
+	) {
+		FrameResources& frame = m_frames.at(drawingFrameIndex);
+
+		commandBuffer.cmdFillBuffer(frame.m_drawCount.m_buffer, 0);
+		vkcpp::DependencyInfo clearDependencyInfo;
+		clearDependencyInfo.addBufferMemoryBarrier(vkcpp::BufferMemoryBarrier2(
+			frame.m_drawCount.m_buffer,
+			VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+		commandBuffer.cmdPipelineBarrier2(clearDependencyInfo);
+
+		commandBuffer.cmdBindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		commandBuffer.cmdBindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, frame.m_descriptorSet);
+		commandBuffer.cmdDispatch((objectCount() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+
+		if (queueFamilyIndex == MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX) {
+			return;
+		}
+		//	The semaphore the graphics submit waits on makes the writes available.
+		vkcpp::DependencyInfo releaseDependencyInfo;
+		for (vkcpp::Buffer buffer : { frame.m_drawCommands.m_buffer, frame.m_drawCount.m_buffer }) {
+			releaseDependencyInfo.addBufferMemoryBarrier(vkcpp::BufferMemoryBarrier2(
+				buffer,
+				VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE)
+				.setQueueFamilies(queueFamilyIndex, MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX));
+		}
+		commandBuffer.cmdPipelineBarrier2(releaseDependencyInfo);
+	}
+
+	//	On the graphics queue, outside the render pass, when recordCull went
+	//	to cullQueueFamilyIndex.  The submit has to wait for the cull at
+	//	DRAW_INDIRECT, the acquire chains on from that wait.
+	//	The compute side overwrites the buffers every frame, so they aren't
+	//	handed back.
+	void recordAcquire(vkcpp::CommandBuffer commandBuffer, int drawingFrameIndex, uint32_t cullQueueFamilyIndex) {
+		FrameResources& frame = m_frames.at(drawingFrameIndex);
+		vkcpp::DependencyInfo acquireDependencyInfo;
+		for (vkcpp::Buffer buffer : { frame.m_drawCommands.m_buffer, frame.m_drawCount.m_buffer }) {
+			acquireDependencyInfo.addBufferMemoryBarrier(vkcpp::BufferMemoryBarrier2(
+				buffer,
+				VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_NONE,
+				VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT)
+				.setQueueFamilies(cullQueueFamilyIndex, MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX));
+		}
+		commandBuffer.cmdPipelineBarrier2(acquireDependencyInfo);
+	}
+
+	//	What recordCull writes and recordDraws reads, for the render graph.
+	VkBuffer drawCommandsBuffer(int drawingFrameIndex) const {
+		return m_frames.at(drawingFrameIndex).m_drawCommands.m_buffer;
+	}
+
+	VkBuffer drawCountBuffer(int drawingFrameIndex) const {
+		return m_frames.at(drawingFrameIndex).m_drawCount.m_buffer;
+	}
+
+	//	Inside the subpass, with its pipeline and descriptors bound.
+	void recordDraws(
+		vkcpp::CommandBuffer	commandBuffer,
+		int						drawingFrameIndex,
+		PointVertexDeviceBuffer& pointVertexDeviceBuffer
+	) {
+		FrameResources& frame = m_frames.at(drawingFrameIndex);
+		pointVertexDeviceBuffer.drawIndirectCount(
+			commandBuffer, frame.m_drawCommands.m_buffer, frame.m_drawCount.m_buffer, objectCount());
+	}
+
+};
 
-	return vkcpp::RenderPass(renderPassCreateInfo, device);
-}
 
 
 class Renderer {
 
 public:
 
-	vkcpp::RenderPass	m_renderPass;
+	//	The cull, subpass 0 and subpass 1, declared by what they use.  It
+	//	makes the render pass the pipelines are made for, the barriers and
+	//	the depth buffer.
+	vkcpp::RenderGraph	m_renderGraph;
+	vkcpp::RenderGraph::ResourceId	m_swapchainImage = 0;
+	vkcpp::RenderGraph::ResourceId	m_drawCommands = 0;
+	vkcpp::RenderGraph::ResourceId	m_drawCount = 0;
+	vkcpp::RenderGraph::PassId	m_cullPass = 0;
+	vkcpp::RenderGraph::PassId	m_subpass0 = 0;
+	vkcpp::RenderGraph::PassId	m_subpass1 = 0;
 
 	//	TODO:	pipelines should remember their layouts,
 	//	or vice-versa, or both.
@@ -1071,59 +1627,368 @@ public:
 	PointVertexDeviceBuffer	m_pointVertexDeviceBuffer0;
 	PointVertexDeviceBuffer	m_pointVertexDeviceBuffer1;
 
+	struct DrawCommand {
+		PointVertexDeviceBuffer*	m_pointVertexDeviceBuffer = nullptr;
+		uint32_t					m_instanceCount = 1;
+	};
 
-	//	TODO: either the drawing frame or frame buffer should know the image extent
-	void recordCommandBuffer(
-		DrawingFrame& drawingFrame,
-		const vkcpp::Framebuffer& framebufferArg,
-		const VkExtent2D			imageExtent
-	) {
-		VkRenderPassBeginInfo vkRenderPassBeginInfo{};
-		vkRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		vkRenderPassBeginInfo.renderPass = m_renderPass;
-		vkRenderPassBeginInfo.framebuffer = framebufferArg;
-		vkRenderPassBeginInfo.renderArea.offset = { 0, 0 };
-		vkRenderPassBeginInfo.renderArea.extent = imageExtent;
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-		vkRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		vkRenderPassBeginInfo.pClearValues = clearValues.data();
+	//	Subpass 0 goes into secondaries recorded across the recording
+	//	workers.  Small lists stay in one chunk on the render thread.
+	static const size_t	MIN_DRAWS_PER_CHUNK = 256;
+	std::vector<DrawCommand>	m_drawList0;
+	std::unique_ptr<vkcpp::ParallelCommandRecorder>	m_parallelRecorder0;
+
+	//	Subpass 0 culled and drawn on the gpu instead of from m_drawList0.
+	//	Not created without drawIndirectCount.
+	GpuDrawCuller	m_drawCuller0;
+
+	//	With a separate compute family the cull goes there, ahead of the
+	//	graphics submit, and overlaps the previous frame's rendering.
+	//	Empty otherwise, the cull is then recorded in front of the render pass.
+	vkcpp::AsyncComputeScheduler	m_asyncCompute;
+
+	//	For static content the command buffer of each (drawing frame,
+	//	swapchain image) pair is recorded once and resubmitted as is.
+	//	Only the uniform data changes, and it lands at the same offsets
+	//	since a frame's ring segment is pushed in the same order each time.
+	bool	m_cacheCommandBuffers = true;
+	uint64_t	m_recordedCount = 0;
+	uint64_t	m_reusedCount = 0;
 
-		const int drawingFrameIndex = drawingFrame.m_index;
+private:
 
-		UniformBufferMemory::updateUniformBuffer(drawingFrameIndex, imageExtent);
+	struct CachedCommandBuffer {
+		vkcpp::CommandBuffer	m_commandBuffer;
+		uint64_t	m_contentGeneration = 0;	//	0 until recorded.
+		uint64_t	m_swapchainGeneration = 0;
+		uint32_t	m_dynamicOffset0 = 0;
+		uint32_t	m_dynamicOffset1 = 0;
+	};
 
-		vkcpp::CommandBuffer commandBuffer = drawingFrame.m_commandBuffer;
-		commandBuffer.reset();
-		commandBuffer.begin();
+	vkcpp::CommandPool	m_cachedCommandPool;	//	Before the buffers, so they are freed first.
+	std::vector<std::vector<CachedCommandBuffer>>	m_cachedCommandBuffers;	//	[drawing frame][swapchain image]
+	uint64_t	m_contentGeneration = 1;
 
-		commandBuffer.cmdBeginRenderPass(vkRenderPassBeginInfo);
+	bool	m_gpuDrivenDraws = false;
 
+	//	What the graph's passes record with, set before it executes.
+	struct FrameRecording {
+		VkExtent2D		m_imageExtent{};
+		VkDescriptorSet	m_vkDescriptorSet = VK_NULL_HANDLE;
+		uint32_t		m_dynamicOffset0 = 0;
+		uint32_t		m_dynamicOffset1 = 0;
+		int				m_drawingFrameIndex = 0;
+		const std::vector<VkCommandBuffer>*	m_pSecondaryCommandBuffers0 = nullptr;
+	};
+	FrameRecording	m_frameRecording;
+
+	uint64_t	m_renderGraphSwapchainGeneration = 0;
+
+	void recordSubpass0(
+		vkcpp::CommandBuffer	commandBuffer,
+		size_t					first,
+		size_t					count,
+		const VkExtent2D		imageExtent,
+		VkDescriptorSet			vkDescriptorSet,
+		uint32_t				dynamicOffset0,
+		int						drawingFrameIndex
+	) {
 		commandBuffer.cmdSetViewport(imageExtent);
 		commandBuffer.cmdSetScissor(imageExtent);
-
 		commandBuffer.cmdBindPipeline(m_graphicsPipeline0);
-		commandBuffer.cmdBindDescriptorSet(m_pipelineLayout0,
-			DescriptorSetWithBinding::getDescriptorSet(drawingFrameIndex));
-
-		vkCmdSetDepthTestEnable(commandBuffer, VK_TRUE);
-		m_pointVertexDeviceBuffer0.draw(commandBuffer);
+		commandBuffer.cmdBindDescriptorSet(m_pipelineLayout0, vkDescriptorSet, dynamicOffset0);
+		commandBuffer.cmdSetDepthTestEnable(VK_TRUE);
+		for (size_t i = first; i < first + count; i++) {
+			const DrawCommand& drawCommand = m_drawList0[i];
+			drawCommand.m_pointVertexDeviceBuffer->draw(commandBuffer, drawCommand.m_instanceCount);
+		}
+		if (first == 0) {
+			//	Chunk 0, on the render thread.
+			if (gpuDrivenDraws()) {
+				m_drawCuller0.recordDraws(commandBuffer, drawingFrameIndex, m_pointVertexDeviceBuffer0);
+			}
+			g_vertexPlacementBenchmark.draw(commandBuffer, drawingFrameIndex);
+		}
+	}
 
-		VkSubpassContents vkSubpassContents{};
-		vkCmdNextSubpass(commandBuffer, vkSubpassContents);
+	void recordSubpass1(vkcpp::CommandBuffer commandBuffer) {
+		const VkExtent2D imageExtent = m_frameRecording.m_imageExtent;
+		commandBuffer.cmdSetViewport(imageExtent);
+		commandBuffer.cmdSetScissor(imageExtent);
 		commandBuffer.cmdBindPipeline(m_graphicsPipeline1);
-		commandBuffer.cmdBindDescriptorSet(m_pipelineLayout1,
-			DescriptorSetWithBinding::getDescriptorSet(drawingFrameIndex));
+		commandBuffer.cmdBindDescriptorSet(m_pipelineLayout1, m_frameRecording.m_vkDescriptorSet, m_frameRecording.m_dynamicOffset1);
+		commandBuffer.cmdSetDepthTestEnable(VK_FALSE);
+		m_pointVertexDeviceBuffer1.draw(commandBuffer);
+	}
 
+	//	Without secondaries subpass 0 is recorded inline.
+	void recordFrame(
+		vkcpp::CommandBuffer	commandBuffer,
+		const std::vector<VkCommandBuffer>* pSecondaryCommandBuffers0
+	) {
+		const int drawingFrameIndex = m_frameRecording.m_drawingFrameIndex;
 
-		vkCmdSetDepthTestEnable(commandBuffer, VK_FALSE);
-		m_pointVertexDeviceBuffer1.draw(commandBuffer);
+		g_vertexPlacementBenchmark.beginFrame(commandBuffer, drawingFrameIndex);
+		if (gpuDrivenDraws() && m_asyncCompute) {
+			m_drawCuller0.recordAcquire(commandBuffer, drawingFrameIndex, m_asyncCompute.queueFamilyIndex());
+		}
+		if (m_drawCuller0.created() && !m_asyncCompute) {
+			m_renderGraph.setPassEnabled(m_cullPass, gpuDrivenDraws());
+		}
+
+		m_frameRecording.m_pSecondaryCommandBuffers0 = pSecondaryCommandBuffers0;
+		m_renderGraph.setSubpassContents(m_subpass0,
+			pSecondaryCommandBuffers0 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		m_renderGraph.execute(commandBuffer);
+	}
 
-		commandBuffer.cmdEndRenderPass();
+	static bool sameGeometry(const PointVertexDeviceBuffer& a, const PointVertexDeviceBuffer& b) {
+		return static_cast<VkBuffer>(a.m_points.m_buffer) == static_cast<VkBuffer>(b.m_points.m_buffer)
+			&& static_cast<VkBuffer>(a.m_vertices.m_buffer) == static_cast<VkBuffer>(b.m_vertices.m_buffer)
+			&& a.m_vertexCount == b.m_vertexCount;
+	}
 
+public:
+
+	//	Once the culler and the async compute queue are set up, they decide
+	//	whether there is a cull pass.  Before the pipelines, which need the
+	//	graph's render pass.
+	void createRenderGraph(
+		VkFormat	swapchainImageFormat,
+		vkcpp::DeviceMemoryArena&		deviceMemoryArena,
+		vkcpp::DeferredDeletionQueue*	pDeferredDeletionQueue
+	) {
+		m_renderGraph = vkcpp::RenderGraph(deviceMemoryArena);
+		m_renderGraph.setDeferredDeletionQueue(pDeferredDeletionQueue);
+
+		//	The submit waits for the acquire at COLOR_ATTACHMENT_OUTPUT.
+		m_swapchainImage = m_renderGraph.importImage("swapchain image", swapchainImageFormat,
+			{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED },
+			vkcpp::ImageUsage::PRESENT);
+		//	One for all the frames in flight rather than one per swapchain
+		//	image, each frame's use is ordered after the last one's.
+		const vkcpp::RenderGraph::ResourceId depthImage = m_renderGraph.createImage("depth", VK_FORMAT_D32_SFLOAT);
+
+		const bool gpuCull = m_drawCuller0.created();
+		if (gpuCull) {
+			//	With the cull on the async compute queue, recordAcquire has
+			//	already left the buffers ready for the draws.
+			const vkcpp::ImageUsageScope initialScope = m_asyncCompute
+				? vkcpp::ImageUsageScope::of(vkcpp::BufferUsage::INDIRECT) : vkcpp::ImageUsageScope{};
+			m_drawCommands = m_renderGraph.importBuffer("draw commands", initialScope);
+			m_drawCount = m_renderGraph.importBuffer("draw count", initialScope);
+			if (!m_asyncCompute) {
+				m_cullPass = m_renderGraph.addPass("cull", vkcpp::RenderGraph::PassType::COMMANDS,
+					[this](vkcpp::CommandBuffer commandBuffer) {
+						m_drawCuller0.recordCull(commandBuffer, m_frameRecording.m_drawingFrameIndex);
+					})
+					.write(m_drawCommands, vkcpp::BufferUsage::STORAGE_COMPUTE)
+					.write(m_drawCount, vkcpp::BufferUsage::TRANSFER_DST)
+					.write(m_drawCount, vkcpp::BufferUsage::STORAGE_COMPUTE)
+					.id();
+			}
+		}
+
+		vkcpp::RenderGraph::PassBuilder subpass0 = m_renderGraph.addPass("subpass 0", vkcpp::RenderGraph::PassType::RASTER,
+			[this](vkcpp::CommandBuffer commandBuffer) {
+				if (m_frameRecording.m_pSecondaryCommandBuffers0) {
+					commandBuffer.cmdExecuteCommands(*m_frameRecording.m_pSecondaryCommandBuffers0);
+					return;
+				}
+				recordSubpass0(commandBuffer, 0, m_drawList0.size(), m_frameRecording.m_imageExtent,
+					m_frameRecording.m_vkDescriptorSet, m_frameRecording.m_dynamicOffset0, m_frameRecording.m_drawingFrameIndex);
+			});
+		subpass0
+			.colorAttachment(m_swapchainImage, VK_ATTACHMENT_LOAD_OP_CLEAR, { { 0.0f, 0.0f, 0.0f, 1.0f } })
+			.depthAttachment(depthImage, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		if (gpuCull) {
+			subpass0
+				.read(m_drawCommands, vkcpp::BufferUsage::INDIRECT)
+				.read(m_drawCount, vkcpp::BufferUsage::INDIRECT);
+		}
+		m_subpass0 = subpass0.id();
+
+		//	Draws over subpass 0 with the depth test off, but keeps the depth
+		//	attachment so both can share the render pass.
+		m_subpass1 = m_renderGraph.addPass("subpass 1", vkcpp::RenderGraph::PassType::RASTER,
+			[this](vkcpp::CommandBuffer commandBuffer) {
+				recordSubpass1(commandBuffer);
+			})
+			.colorAttachment(m_swapchainImage, VK_ATTACHMENT_LOAD_OP_LOAD)
+			.depthAttachment(depthImage, VK_ATTACHMENT_LOAD_OP_LOAD)
+			.id();
+
+		m_renderGraph.compile();
+	}
+
+	void createCommandBufferCache(uint32_t queueFamilyIndex, VkDevice vkDevice, int drawingFrameCount) {
+		m_cachedCommandBuffers.clear();
+		m_cachedCommandPool = vkcpp::CommandPool(
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, queueFamilyIndex, vkDevice);
+		m_cachedCommandBuffers.resize(drawingFrameCount);
+		invalidateCommandBuffers();
+	}
+
+	//	After anything a recording depends on changes: pipelines, geometry
+	//	or descriptor set contents.  Swapchain recreation is noticed on its own.
+	void invalidateCommandBuffers() {
+		m_contentGeneration++;
+	}
+
+	void setGeometry(
+		const PointVertexDeviceBuffer& pointVertexDeviceBuffer0,
+		const PointVertexDeviceBuffer& pointVertexDeviceBuffer1
+	) {
+		if (sameGeometry(m_pointVertexDeviceBuffer0, pointVertexDeviceBuffer0)
+			&& sameGeometry(m_pointVertexDeviceBuffer1, pointVertexDeviceBuffer1)) {
+			return;
+		}
+		m_pointVertexDeviceBuffer0 = pointVertexDeviceBuffer0;
+		m_pointVertexDeviceBuffer1 = pointVertexDeviceBuffer1;
+		if (m_drawCuller0.created()) {
+			m_drawCuller0.setObjects({ GpuDrawCuller::object(m_pointVertexDeviceBuffer0) });
+		}
+		invalidateCommandBuffers();
+	}
+
+	bool gpuDrivenDraws() const {
+		return m_gpuDrivenDraws && m_drawCuller0.created();
+	}
+
+	//	Returns whether it is on, it stays off without the culler.
+	bool setGpuDrivenDraws(bool enable) {
+		m_gpuDrivenDraws = enable;
+		invalidateCommandBuffers();
+		return gpuDrivenDraws();
+	}
+
+	//	Whatever recordCommandBuffer sent to the async compute queue for the
+	//	frame, the graphics submit waits for.
+	void addComputeWaits(vkcpp::SubmitInfo2& submitInfo2, int drawingFrameIndex) {
+		if (m_asyncCompute) {
+			m_asyncCompute.addWait(submitInfo2, drawingFrameIndex, vkcpp::PIPELINE_STAGE_2_DRAW_INDIRECT);
+		}
+	}
+
+	//	Leaves the command buffer to submit in drawingFrame.m_commandBuffer,
+	//	which has to addComputeWaits.
+	void recordCommandBuffer(
+		DrawingFrame& drawingFrame,
+		vkcpp::Swapchain_FrameBuffers& swapchain_frameBuffers,
+		uint32_t					swapchainImageIndex,
+		vkcpp::WorkerPool&			recordingWorkerPool
+	) {
+		const VkExtent2D imageExtent = swapchain_frameBuffers.getImageExtent();
+		const int drawingFrameIndex = drawingFrame.m_index;
+
+		//	The graph's framebuffers hold the old swapchain's image views.
+		if (m_renderGraphSwapchainGeneration != swapchain_frameBuffers.generation()) {
+			m_renderGraph.setExtent(imageExtent);
+			m_renderGraphSwapchainGeneration = swapchain_frameBuffers.generation();
+		}
+		m_renderGraph.bindImage(m_swapchainImage,
+			swapchain_frameBuffers.getImage(swapchainImageIndex),
+			swapchain_frameBuffers.getImageView(swapchainImageIndex));
+		if (m_drawCuller0.created()) {
+			m_renderGraph.bindBuffer(m_drawCommands, m_drawCuller0.drawCommandsBuffer(drawingFrameIndex));
+			m_renderGraph.bindBuffer(m_drawCount, m_drawCuller0.drawCountBuffer(drawingFrameIndex));
+		}
+
+		const ModelViewProjTransform frameTransform =
+			UniformBufferMemory::beginFrame(drawingFrameIndex, imageExtent);
+
+		m_drawList0.clear();
+		if (gpuDrivenDraws()) {
+			glm::vec4 frustumPlanes[6];
+			g_theCamera.frustumPlanes(frameTransform.m_modelTransform, frustumPlanes);
+			m_drawCuller0.beginFrame(drawingFrameIndex, frustumPlanes);
+			//	Every frame, even when the graphics command buffer is reused,
+			//	since it acquires what this releases.
+			if (m_asyncCompute) {
+				vkcpp::CommandBuffer computeCommandBuffer = m_asyncCompute.begin(drawingFrameIndex);
+				m_drawCuller0.recordCull(computeCommandBuffer, drawingFrameIndex, m_asyncCompute.queueFamilyIndex());
+				m_asyncCompute.submit(drawingFrameIndex);
+			}
+		}
+		else {
+			m_drawList0.push_back({ &m_pointVertexDeviceBuffer0 });
+		}
+
+		//	The uniform ring isn't thread safe, so the offsets are pushed here,
+		//	every frame, whether or not the command buffer is recorded.
+		const uint32_t dynamicOffset0 = UniformBufferMemory::push(frameTransform);
+		const uint32_t dynamicOffset1 = UniformBufferMemory::push(frameTransform);
+		const VkDescriptorSet vkDescriptorSet = DescriptorSetWithBinding::getDescriptorSet(drawingFrameIndex);
+		m_frameRecording = { imageExtent, vkDescriptorSet, dynamicOffset0, dynamicOffset1, drawingFrameIndex, nullptr };
+
+		//	The benchmark changes what is recorded every frame.
+		if (m_cacheCommandBuffers && m_cachedCommandPool && !g_vertexPlacementBenchmark.running()) {
+			std::vector<CachedCommandBuffer>& frameCache = m_cachedCommandBuffers.at(drawingFrameIndex);
+			if (frameCache.size() <= swapchainImageIndex) {
+				frameCache.resize(swapchainImageIndex + 1);
+			}
+			CachedCommandBuffer& cached = frameCache[swapchainImageIndex];
+			if (cached.m_contentGeneration == m_contentGeneration
+				&& cached.m_swapchainGeneration == swapchain_frameBuffers.generation()
+				&& cached.m_dynamicOffset0 == dynamicOffset0
+				&& cached.m_dynamicOffset1 == dynamicOffset1) {
+				drawingFrame.m_commandBuffer = cached.m_commandBuffer;
+				m_reusedCount++;
+				return;
+			}
+
+			//	The frame's last submit is done, so its cached buffers aren't pending.
+			if (!cached.m_commandBuffer) {
+				cached.m_commandBuffer = vkcpp::CommandBuffer(m_cachedCommandPool);
+			}
+			vkcpp::CommandBufferState commandBufferState;
+			vkcpp::CommandBuffer commandBuffer = cached.m_commandBuffer;
+			commandBuffer.trackState(&commandBufferState);
+			commandBuffer.reset();
+			commandBuffer.begin();	//	Not one time, it is submitted again.
+			recordFrame(commandBuffer, nullptr);
+			commandBuffer.end();
+
+			cached.m_contentGeneration = m_contentGeneration;
+			cached.m_swapchainGeneration = swapchain_frameBuffers.generation();
+			cached.m_dynamicOffset0 = dynamicOffset0;
+			cached.m_dynamicOffset1 = dynamicOffset1;
+			//	The state lives on this stack frame, don't let the stored copy keep it.
+			commandBuffer.trackState(nullptr);
+			drawingFrame.m_commandBuffer = commandBuffer;
+			m_recordedCount++;
+			return;
+		}
+
+		VkCommandBufferInheritanceInfo inheritanceInfo0{};
+		inheritanceInfo0.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo0.renderPass = m_renderGraph.renderPass(m_subpass0);
+		inheritanceInfo0.subpass = m_renderGraph.subpass(m_subpass0);
+		inheritanceInfo0.framebuffer = m_renderGraph.framebuffer(m_subpass0);
+
+		//	Dynamic state isn't inherited, every chunk sets its own.
+		const std::vector<VkCommandBuffer>& secondaryCommandBuffers0 = m_parallelRecorder0->record(
+			drawingFrameIndex,
+			inheritanceInfo0,
+			m_drawList0.size(),
+			MIN_DRAWS_PER_CHUNK,
+			[&](vkcpp::CommandBuffer secondaryCommandBuffer, size_t first, size_t count) {
+				//	Already begun, so the state starts out empty by construction.
+				vkcpp::CommandBufferState commandBufferState;
+				secondaryCommandBuffer.trackState(&commandBufferState);
+				recordSubpass0(secondaryCommandBuffer, first, count,
+					imageExtent, vkDescriptorSet, dynamicOffset0, drawingFrameIndex);
+			},
+			recordingWorkerPool);
+
+		drawingFrame.m_commandBuffer = drawingFrame.m_commandAllocator.allocate();
+		vkcpp::CommandBufferState commandBufferState;
+		vkcpp::CommandBuffer commandBuffer = drawingFrame.m_commandBuffer;
+		commandBuffer.trackState(&commandBufferState);
+		commandBuffer.beginOneTimeSubmit();
+		recordFrame(commandBuffer, &secondaryCommandBuffers0);
 		commandBuffer.end();
+		m_recordedCount++;
 
 	}
 
@@ -1157,8 +2022,6 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 	const VkColorSpaceKHR swapchainImageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
 	const VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
-	vkcpp::RenderPass renderPass(createRenderPass(swapchainImageFormat, g_vulkanGpuAssets.m_device));
-
 	vkcpp::Swapchain_FrameBuffers::setDevice(g_vulkanGpuAssets.m_device);
 
 	vkcpp::SwapchainCreateInfo swapchainCreateInfo(
@@ -1172,36 +2035,84 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 	//	The swapchainCreateInfo does not hold the smart Surface object so
 	//	we need to pass it in separately.
 	vkcpp::Swapchain_FrameBuffers swapchain_frameBuffers(swapchainCreateInfo, surfaceOriginal);
-	swapchain_frameBuffers.setRenderPass(renderPass);
-
-	UniformBufferMemory::createUniformBufferMemorys(g_vulkanGpuAssets.m_device);
+	swapchain_frameBuffers.setDeferredDeletionQueue(&g_deferredDeletionQueue);
+	if (g_vulkanGpuAssets.m_swapchainMaintenance1) {
+		swapchain_frameBuffers.usePresentFences(&g_syncObjectPool);
+	}
 
-	PointVertexDeviceBuffer	pointVertexDeviceBuffer0(g_pointVertexBuffer0, g_vulkanGpuAssets.m_device);
-	PointVertexDeviceBuffer	pointVertexDeviceBuffer1(g_pointVertexBuffer1, g_vulkanGpuAssets.m_device);
+	UniformBufferMemory::createUniformBufferMemorys(g_deviceMemoryArena);
 
 
-	for (const ShaderName& shaderName : g_shaderNames) {
-		ShaderLibrary::createShaderModuleFromFile(
+	//	The shaders load on the workers while the rest of the setup goes on.
+	std::vector<vkcpp::Task<>> shaderLoads;
+	std::vector<ShaderName> shaderNames = g_shaderNames;
+	if (g_vulkanGpuAssets.m_drawIndirectCount) {
+		shaderNames.push_back(g_cullDrawsShaderName);
+	}
+	for (const ShaderName& shaderName : shaderNames) {
+		shaderLoads.push_back(ShaderLibrary::loadShaderModuleFromFile(
 			shaderName.m_shaderName,
 			shaderName.m_fileName,
-			g_vulkanGpuAssets.m_device);
+			g_vulkanGpuAssets.m_device,
+			globals.g_streamingWorkerPool,
+			globals.g_assetExecutor));
+		shaderLoads.back().start();
 	}
 
 
-	VkCommandPoolCreateInfo commandPoolCreateInfo{};
-	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	commandPoolCreateInfo.queueFamilyIndex = MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX;
-	vkcpp::CommandPool commandPoolOriginal(commandPoolCreateInfo, g_vulkanGpuAssets.m_device);
-
-
-	ImageLibrary::createImageMemoryViewFromFile(
-		"statueImage", "c:/vulkan/statue.jpg",
-		g_vulkanGpuAssets.m_device, commandPoolOriginal, g_vulkanGpuAssets.m_graphicsQueue);
+	//	All the textures and static geometry go up on the transfer queue,
+	//	then get handed to the graphics family.
+	vkcpp::UploadBatch uploadBatch(
+		g_deviceMemoryArena,
+		g_vulkanGpuAssets.m_transferQueue,
+		g_vulkanGpuAssets.m_graphicsQueue);
+	uploadBatch.setSyncObjectPool(&g_syncObjectPool);
+
+	PointVertexDeviceBuffer	pointVertexDeviceBuffer0(g_pointVertexBuffer0, g_deviceMemoryArena, uploadBatch);
+	PointVertexDeviceBuffer	pointVertexDeviceBuffer1(g_pointVertexBuffer1, g_deviceMemoryArena, uploadBatch);
+
+	const VkPhysicalDeviceProperties physicalDeviceProperties =
+		g_vulkanGpuAssets.physicalDevice().getPhysicalDeviceProperties();
+	g_vertexPlacementBenchmark.create(
+		g_pointVertexBuffer0,
+		g_deviceMemoryArena,
+		uploadBatch,
+		physicalDeviceProperties.limits.timestampComputeAndGraphics ? physicalDeviceProperties.limits.timestampPeriod : 0.0f,
+		MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT,
+		g_vulkanGpuAssets.m_device);
+
+	//	Stands in for textures that are still loading or have been evicted.
+	ImageLibrary::createPlaceholderImage("placeholderImage", 0x808080ff, uploadBatch);
+
+	//	Textures stream in behind the first frames, the render loop polls them along.
+	globals.g_streamingUploadBatch = std::make_unique<vkcpp::UploadBatch>(
+		g_deviceMemoryArena,
+		g_vulkanGpuAssets.m_transferQueue,
+		g_vulkanGpuAssets.m_graphicsQueue);
+	globals.g_streamingUploadBatch->setSubmitBatch(&globals.g_submitBatch);
+	globals.g_streamingUploadBatch->setSyncObjectPool(&g_syncObjectPool);
+	const std::vector<ImageLibrary::ImageFile> imageFiles{
+		{ "statueImage", "c:/vulkan/statue.jpg" },
+		{ "spaceImage", "c:/vulkan/space.jpg" },
+	};
+	for (const ImageLibrary::ImageFile& imageFile : imageFiles) {
+		globals.g_assetLoads.push_back(ImageLibrary::loadImageMemoryViewFromFile(
+			imageFile.m_imageName,
+			imageFile.m_fileName,
+			*globals.g_streamingUploadBatch,
+			globals.g_streamingWorkerPool,
+			globals.g_assetExecutor,
+			true));		//	Mipmaps, so minified textures sample smaller levels.
+		globals.g_assetLoads.back().start();
+	}
 
-	ImageLibrary::createImageMemoryViewFromFile(
-		"spaceImage", "c:/vulkan/space.jpg",
-		g_vulkanGpuAssets.m_device, commandPoolOriginal, g_vulkanGpuAssets.m_graphicsQueue);
+	vkcpp::UploadBatch::Stats uploadStats = uploadBatch.submitAndWait();
+	std::cout << "upload: " << uploadStats.m_imageCount << " images, "
+		<< uploadStats.m_bufferCount << " buffers, "
+		<< uploadStats.m_bytesUploaded << " bytes, "
+		<< uploadStats.m_submitCount << " submits, "
+		<< uploadStats.m_duration << " (gpu wait " << uploadStats.m_gpuWaitDuration << ")"
+		<< (uploadStats.m_ownershipTransferred ? " via transfer queue" : "") << "\n";
 
 
 	vkcpp::SamplerCreateInfo textureSamplerCreateInfo;
@@ -1217,6 +2128,31 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 	pipelineLayoutCreateInfo.addDescriptorSetLayout(descriptorSetLayoutOriginal);
 	vkcpp::PipelineLayout pipelineLayout(pipelineLayoutCreateInfo, g_vulkanGpuAssets.m_device);
 
+	//	The pipelines can't be made without them.
+	globals.g_assetExecutor.pollUntil([&shaderLoads] {
+		return std::all_of(shaderLoads.begin(), shaderLoads.end(),
+			[](const vkcpp::Task<>& shaderLoad) { return shaderLoad.done(); });
+		});
+	for (vkcpp::Task<>& shaderLoad : shaderLoads) {
+		shaderLoad.get();
+	}
+
+	if (g_vulkanGpuAssets.m_drawIndirectCount) {
+		theRenderer.m_drawCuller0.create(
+			ShaderLibrary::shaderModule("cullDraws"),
+			g_deviceMemoryArena,
+			MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT,
+			g_vulkanGpuAssets.m_device);
+		if (g_vulkanGpuAssets.m_computeQueueFamilyIndex != MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX) {
+			theRenderer.m_asyncCompute = vkcpp::AsyncComputeScheduler(
+				g_vulkanGpuAssets.m_computeQueue,
+				MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT,
+				g_vulkanGpuAssets.m_device);
+		}
+	}
+	theRenderer.createRenderGraph(swapchainImageFormat, g_deviceMemoryArena, &g_deferredDeletionQueue);
+	const vkcpp::RenderPass renderPass = theRenderer.m_renderGraph.renderPass(theRenderer.m_subpass0);
+
 	vkcpp::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
 	graphicsPipelineCreateInfo.addDynamicState(VK_DYNAMIC_STATE_VIEWPORT);
 	graphicsPipelineCreateInfo.addDynamicState(VK_DYNAMIC_STATE_SCISSOR);
@@ -1228,7 +2164,7 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 
 	//	TODO: move pipeline creation to the renderer
 	graphicsPipelineCreateInfo.setPipelineLayout(pipelineLayout);
-	graphicsPipelineCreateInfo.setRenderPass(renderPass, 0);
+	graphicsPipelineCreateInfo.setRenderPass(renderPass, theRenderer.m_renderGraph.subpass(theRenderer.m_subpass0));
 	graphicsPipelineCreateInfo.addShaderModule(
 		ShaderLibrary::shaderModule("vert4"), VK_SHADER_STAGE_VERTEX_BIT, "main");
 	graphicsPipelineCreateInfo.addShaderModule(
@@ -1237,18 +2173,18 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 	//	ShaderLibrary::shaderModule("identityFrag"), VK_SHADER_STAGE_FRAGMENT_BIT, "main");
 
 	vkcpp::GraphicsPipeline graphicsPipeline0(graphicsPipelineCreateInfo, g_vulkanGpuAssets.m_device);
-	graphicsPipelineCreateInfo.setRenderPass(renderPass, 1);
+	graphicsPipelineCreateInfo.setRenderPass(renderPass, theRenderer.m_renderGraph.subpass(theRenderer.m_subpass1));
 	vkcpp::GraphicsPipeline graphicsPipeline1(graphicsPipelineCreateInfo, g_vulkanGpuAssets.m_device);
 
 	DescriptorSetWithBinding::createDescriptorSets(
 		descriptorSetLayoutOriginal,
 		descriptorPoolOriginal,
-		ImageLibrary::imageView("statueImage"),
+		ImageLibrary::imageView("placeholderImage"),
 		textureSampler);
 
 	DrawingFrame::createDrawingFrames(
 		g_vulkanGpuAssets.m_device,
-		commandPoolOriginal
+		MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX
 	);
 
 
@@ -1267,15 +2203,20 @@ void VulkanStuff(HINSTANCE hInstance, HWND hWnd, Globals& globals) {
 	globals.g_pointVertexDeviceBuffer0 = std::move(pointVertexDeviceBuffer0);
 	globals.g_pointVertexDeviceBuffer1 = std::move(pointVertexDeviceBuffer1);
 
-	theRenderer.m_renderPass = std::move(renderPass);
 	theRenderer.m_pipelineLayout = std::move(pipelineLayout);
 	theRenderer.m_pipelineLayout0 = theRenderer.m_pipelineLayout;
 	theRenderer.m_graphicsPipeline0 = std::move(graphicsPipeline0);
 	theRenderer.m_pipelineLayout1 = theRenderer.m_pipelineLayout;
 	theRenderer.m_graphicsPipeline1 = std::move(graphicsPipeline1);
-
-
-	globals.g_commandPoolOriginal = std::move(commandPoolOriginal);
+	theRenderer.m_parallelRecorder0 = std::make_unique<vkcpp::ParallelCommandRecorder>(
+		MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT,
+		globals.g_recordingWorkerPool.threadCount() + 1,
+		MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+		g_vulkanGpuAssets.m_device);
+	theRenderer.createCommandBufferCache(
+		MagicValues::GRAPHICS_QUEUE_FAMILY_INDEX,
+		g_vulkanGpuAssets.m_device,
+		MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT);
 
 	globals.g_swapchain_frameBuffers = std::move(swapchain_frameBuffers);
 
@@ -1288,6 +2229,54 @@ int64_t	g_drawFrameCalls;
 int64_t g_drawFrameDraws;
 
 
+#ifdef CHECK_DRAW_FRAME_HEAP_ALLOCATIONS
+
+//	Every operator new on this thread, so MessageLoop can check that
+//	steady state drawFrame calls don't touch the heap.  The array and
+//	nothrow forms come through these too.  Off by default, and meant for
+//	release builds: MSVC's debug iterators allocate on their own.
+thread_local uint64_t	t_heapAllocationCount;
+uint64_t	g_drawFrameHeapAllocations;
+
+void* operator new(std::size_t size) {
+	t_heapAllocationCount++;
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	t_heapAllocationCount++;
+	if (void* p = _aligned_malloc(size == 0 ? 1 : size, static_cast<std::size_t>(alignment))) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	_aligned_free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+	_aligned_free(p);
+}
+
+#endif
+
+
+uint64_t	g_frameNumber;
+ImageLibrary::ResidencyStats	g_residencyStats;
+
+
 std::chrono::high_resolution_clock::time_point g_nextFrameTime = std::chrono::high_resolution_clock::now();
 
 
@@ -1318,7 +2307,14 @@ void drawFrame(Globals& globals)
 	DrawingFrame& currentDrawingFrame = DrawingFrame::getNextFrameToDraw();
 	//	Wait for this drawing frame to be free
 	//	TODO: does this need a warning timer?
-	currentDrawingFrame.m_inFlightFence.wait();
+	g_vulkanGpuAssets.m_graphicsTimeline->wait(currentDrawingFrame.m_submittedTimelineValue);
+	currentDrawingFrame.m_commandAllocator.reset();
+	g_deferredDeletionQueue.collect();
+	//	The last acquire's semaphore was waited on by that submit,
+	//	or was never signaled, so it can be recycled.
+	g_syncObjectPool.releaseSemaphore(std::move(currentDrawingFrame.m_swapchainImageAvailableSemaphore));
+	currentDrawingFrame.m_swapchainImageAvailableSemaphore = g_syncObjectPool.acquireSemaphore();
+	g_vertexPlacementBenchmark.collect(currentDrawingFrame.m_index);
 
 	//	Need to grab the device from somewhere, might as well be from here.
 	vkcpp::Device device = currentDrawingFrame.getDevice();
@@ -1341,14 +2337,28 @@ void drawFrame(Globals& globals)
 		return;
 	}
 
+	//	The frame is really going to be drawn, so this is where textures get used.
+	g_frameNumber++;
+	g_residencyStats = ImageLibrary::updateResidency(
+		g_frameNumber,
+		MagicValues::MAX_DRAWING_FRAMES_IN_FLIGHT,
+		*globals.g_streamingUploadBatch,
+		globals.g_streamingWorkerPool);
+	if (DescriptorSetWithBinding::setTextureImageView(
+		currentDrawingFrame.m_index,
+		ImageLibrary::useImageView("statueImage", g_frameNumber),
+		globals.g_textureSampler)) {
+		theRenderer.invalidateCommandBuffers();
+	}
+
 	//	TODO: this is kind of clunky
-	theRenderer.m_pointVertexDeviceBuffer0 = globals.g_pointVertexDeviceBuffer0;
-	theRenderer.m_pointVertexDeviceBuffer1 = globals.g_pointVertexDeviceBuffer1;
+	theRenderer.setGeometry(globals.g_pointVertexDeviceBuffer0, globals.g_pointVertexDeviceBuffer1);
 
 	theRenderer.recordCommandBuffer(
 		currentDrawingFrame,
-		globals.g_swapchain_frameBuffers.getFrameBuffer(swapchainImageIndex),
-		globals.g_swapchain_frameBuffers.getImageExtent());
+		globals.g_swapchain_frameBuffers,
+		swapchainImageIndex,
+		globals.g_recordingWorkerPool);
 
 	vkcpp::SubmitInfo2 submitInfo2;
 	//	Command can proceed but wait for the image to
@@ -1359,16 +2369,21 @@ void drawFrame(Globals& globals)
 		vkcpp::PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT
 	);
 
+	//	The cull on the async compute queue, if it went there.
+	theRenderer.addComputeWaits(submitInfo2, currentDrawingFrame.m_index);
+
 	submitInfo2.addCommandBuffer(currentDrawingFrame.m_commandBuffer);
 	submitInfo2.addSignalSemaphore(currentDrawingFrame.m_renderFinishedSemaphore);
 
 
-	//	Show that this drawing frame is now in use ..
-	//	Fence will be opened when graphics queue is finished.
-	currentDrawingFrame.m_inFlightFence.close();
 	g_drawFrameDraws++;
 
-	g_vulkanGpuAssets.m_graphicsQueue.submit2(submitInfo2, currentDrawingFrame.m_inFlightFence);
+	//	Along with any uploads streamed in since the last flush.
+	//	The flush fills in the timeline value the frame waits on next time around.
+	globals.g_submitBatch.add(
+		g_vulkanGpuAssets.m_graphicsQueue, std::move(submitInfo2),
+		VK_NULL_HANDLE, &currentDrawingFrame.m_submittedTimelineValue);
+	globals.g_submitBatch.flush();
 
 	//	TODO: Is this where we are supposed to add an image memory barrier
 	//	to avoid the present after write hazard?
@@ -1378,7 +2393,8 @@ void drawFrame(Globals& globals)
 	presentInfo.addWaitSemaphore(currentDrawingFrame.m_renderFinishedSemaphore);
 	presentInfo.addSwapchain(
 		globals.g_swapchain_frameBuffers.vkSwapchain(),
-		swapchainImageIndex
+		swapchainImageIndex,
+		globals.g_swapchain_frameBuffers.presentFence()
 	);
 
 	//	TODO: add timer to check for blocking call?
@@ -1401,6 +2417,9 @@ const int32_t	KEY_W = 'W';
 const int32_t	KEY_A = 'A';
 const int32_t	KEY_S = 'S';
 const int32_t	KEY_D = 'D';
+const int32_t	KEY_B = 'B';
+const int32_t	KEY_C = 'C';
+const int32_t	KEY_G = 'G';
 
 
 
@@ -1419,6 +2438,17 @@ void handleKeyDown(int32_t key) {
 	case KEY_W:	g_theCamera.eyeDelta(0.0, 0.0, -0.1); break;
 	case KEY_S:	g_theCamera.eyeDelta(0.0, 0.0, 0.1); break;
 
+	case KEY_B:	g_vertexPlacementBenchmark.start(); break;
+	case KEY_C:
+		theRenderer.m_cacheCommandBuffers = !theRenderer.m_cacheCommandBuffers;
+		std::cout << "command buffer cache " << (theRenderer.m_cacheCommandBuffers ? "on" : "off") << "\n";
+		break;
+	case KEY_G:
+		std::cout << "gpu driven draws "
+			<< (theRenderer.setGpuDrivenDraws(!theRenderer.gpuDrivenDraws()) ? "on" : "off (needs drawIndirectCount)")
+			<< (theRenderer.gpuDrivenDraws() && theRenderer.m_asyncCompute ? ", culled on the async compute queue" : "") << "\n";
+		break;
+
 
 	}
 
@@ -1514,6 +2544,9 @@ HWND CreateFirstWindow(HINSTANCE hInstance)
 }
 
 auto g_statStart = std::chrono::high_resolution_clock::now();
+uint64_t g_lastSubmitCount;
+uint64_t g_lastIssuedCommandCount;
+uint64_t g_lastElidedCommandCount;
 
 void showStats() {
 
@@ -1525,6 +2558,52 @@ void showStats() {
 		std::cout << "  time: " << statDiff << "  " << statDiff.count() << "\n";
 		std::cout << "  drawFrameCalls: " << g_drawFrameCalls << "\n";
 		std::cout << "  drawFrameDraws: " << g_drawFrameDraws << "\n";
+		const uint64_t submitCount = vkcpp::Queue::submitCount();
+		std::cout << "  queue submits: " << submitCount - g_lastSubmitCount;
+		if (g_drawFrameDraws > 0) {
+			std::cout << " (" << static_cast<double>(submitCount - g_lastSubmitCount) / g_drawFrameDraws << " per frame)";
+		}
+		std::cout << "\n";
+		g_lastSubmitCount = submitCount;
+		const uint64_t issuedCommandCount = vkcpp::CommandBufferState::issuedCount() - g_lastIssuedCommandCount;
+		const uint64_t elidedCommandCount = vkcpp::CommandBufferState::elidedCount() - g_lastElidedCommandCount;
+		std::cout << "  binds/state sets issued/elided: " << issuedCommandCount << "/" << elidedCommandCount;
+		if (g_drawFrameDraws > 0) {
+			std::cout << " (" << static_cast<double>(elidedCommandCount) / g_drawFrameDraws << " elided per frame)";
+		}
+		std::cout << "\n";
+		g_lastIssuedCommandCount += issuedCommandCount;
+		g_lastElidedCommandCount += elidedCommandCount;
+#ifdef CHECK_DRAW_FRAME_HEAP_ALLOCATIONS
+		//	Should be 0 once textures are resident and command buffers cached.
+		std::cout << "  drawFrame heap allocations: " << g_drawFrameHeapAllocations << "\n";
+		g_drawFrameHeapAllocations = 0;
+#endif
+		std::cout << "  deferred deletions pending: " << g_deferredDeletionQueue.pendingCount() << "\n";
+		const vkcpp::SyncObjectPool::Stats syncStats = g_syncObjectPool.getStats();
+		std::cout << "  sync pool fence hits/misses: " << syncStats.m_fenceHits << "/" << syncStats.m_fenceMisses
+			<< "  semaphore hits/misses: " << syncStats.m_semaphoreHits << "/" << syncStats.m_semaphoreMisses
+			<< " (" << syncStats.m_freeFenceCount << " fences, " << syncStats.m_freeSemaphoreCount << " semaphores free)\n";
+
+		vkcpp::DeviceMemoryArena::Stats arenaStats = g_deviceMemoryArena.getStats();
+		std::cout << "  memory blocks: " << arenaStats.m_blockCount
+			<< " (" << arenaStats.m_totalBlockAllocations << " vkAllocateMemory calls)\n";
+		std::cout << "  memory sub-allocations: " << arenaStats.m_subAllocationCount
+			<< " (" << arenaStats.m_totalSubAllocations << " total)\n";
+		std::cout << "  memory bytes in use/reserved: " << arenaStats.m_bytesInUse
+			<< "/" << arenaStats.m_bytesReserved << "\n";
+		std::cout << "  memory free ranges: " << arenaStats.m_freeRangeCount
+			<< "  fragmentation: " << arenaStats.fragmentation() << "\n";
+		std::cout << "  textures resident/loading/evicted: " << g_residencyStats.m_residentCount
+			<< "/" << g_residencyStats.m_loadingCount << "/" << g_residencyStats.m_evictedCount
+			<< " (" << g_residencyStats.m_totalEvictions << " evictions, "
+			<< g_residencyStats.m_totalReloads << " reloads)\n";
+		std::cout << "  device local usage/budget: " << g_residencyStats.m_usage
+			<< "/" << g_residencyStats.m_budget << "\n";
+		std::cout << "  command buffers recorded/reused: " << theRenderer.m_recordedCount
+			<< "/" << theRenderer.m_reusedCount << "\n";
+		theRenderer.m_recordedCount = 0;
+		theRenderer.m_reusedCount = 0;
 
 		g_drawFrameCalls = 0;
 		g_drawFrameDraws = 0;
@@ -1649,6 +2728,53 @@ void snapCommandWindow() {
 
 
 
+//	Moves the asset loads along and reports the ones that finished.
+void streamAssets(Globals& globals) {
+	globals.g_assetExecutor.poll();
+	std::erase_if(globals.g_assetLoads, [](vkcpp::Task<>& assetLoad) {
+		if (!assetLoad.done()) {
+			return false;
+		}
+		try {
+			assetLoad.get();
+		}
+		catch (const std::exception& e) {
+			std::cout << "asset load failed: " << e.what() << "\n";
+		}
+		return true;
+		});
+}
+
+
+#ifdef CHECK_DRAW_FRAME_HEAP_ALLOCATIONS
+
+//	Enough frames for every drawing frame and swapchain image to have
+//	its command buffers cached.
+const uint64_t	STEADY_STATE_WARM_UP_FRAMES = 60;
+
+uint64_t	g_steadyStateSwapchainGeneration;
+uint64_t	g_steadyStateSinceFrame;
+
+//	Nothing loading and the same swapchain for the warm up, then a
+//	drawFrame call that allocates is a bug.
+void checkDrawFrameHeapAllocations(Globals& globals, uint64_t heapAllocationCount) {
+	g_drawFrameHeapAllocations += heapAllocationCount;
+	const bool settled = globals.g_assetLoads.empty()
+		&& g_residencyStats.m_loadingCount == 0
+		&& globals.g_swapchain_frameBuffers.generation() == g_steadyStateSwapchainGeneration;
+	if (!settled) {
+		g_steadyStateSwapchainGeneration = globals.g_swapchain_frameBuffers.generation();
+		g_steadyStateSinceFrame = g_frameNumber;
+		return;
+	}
+	if (g_frameNumber - g_steadyStateSinceFrame >= STEADY_STATE_WARM_UP_FRAMES && heapAllocationCount > 0) {
+		throw std::runtime_error("steady state drawFrame allocated on the heap");
+	}
+}
+
+#endif
+
+
 void MessageLoop(Globals& globals) {
 
 	MSG msg;
@@ -1668,12 +2794,21 @@ void MessageLoop(Globals& globals) {
 		}
 
 		//		snapCommandWindow();
+		streamAssets(globals);
+#ifdef CHECK_DRAW_FRAME_HEAP_ALLOCATIONS
+		const uint64_t heapAllocationCount = t_heapAllocationCount;
+#endif
 		try {
 			drawFrame(globals);
 		}
 		catch (vkcpp::ShutdownException&) {
 			done = true;
 		}
+		//	Uploads still go out on the calls that don't draw.
+		globals.g_submitBatch.flush();
+#ifdef CHECK_DRAW_FRAME_HEAP_ALLOCATIONS
+		checkDrawFrameHeapAllocations(globals, t_heapAllocationCount - heapAllocationCount);
+#endif
 		showStats();
 	}
 	return;
@@ -1734,6 +2869,9 @@ int main()
 
 	MessageLoop(g_globals);
 
+	//	Reloads still decoding write into the image library.
+	g_globals.g_streamingWorkerPool.waitIdle();
+
 	//	Wait for device to be idle before exiting and cleaning up globals.
 	g_vulkanGpuAssets.m_device.waitIdle();
 
@@ -8,6 +8,20 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <list>
+#include <memory>
+#include <coroutine>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
 
 #include <vulkan/vulkan.h>
 
@@ -59,6 +73,138 @@ namespace vkcpp {
 	}
 
 
+	//	A vector of Vulkan structs for the info builders that are made
+	//	every frame.  The first N elements live in the object, so the usual
+	//	handful of barriers or semaphores costs no heap allocation.
+	//	Past N it moves everything to a std::vector and stays there;
+	//	clear goes back to the inline storage but keeps the heap capacity
+	//	for the next time.  Only for plain structs and handles.
+	template<typename T, size_t N>
+	class InlineVector {
+
+		static_assert(N > 0);
+		static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+		alignas(T) unsigned char	m_inline[N * sizeof(T)];
+		std::vector<T>	m_heap;
+		size_t	m_size = 0;
+		bool	m_onHeap = false;
+
+		T* inlineData() {
+			return reinterpret_cast<T*>(m_inline);
+		}
+
+		const T* inlineData() const {
+			return reinterpret_cast<const T*>(m_inline);
+		}
+
+	public:
+
+		InlineVector() {}
+
+		InlineVector(const InlineVector& other) {
+			for (const T& element : other) {
+				push_back(element);
+			}
+		}
+
+		InlineVector& operator=(const InlineVector& other) {
+			if (this != &other) {
+				clear();
+				for (const T& element : other) {
+					push_back(element);
+				}
+			}
+			return *this;
+		}
+
+		InlineVector(InlineVector&& other) noexcept
+			: m_heap(std::move(other.m_heap))
+			, m_size(other.m_size)
+			, m_onHeap(other.m_onHeap) {
+			if (!m_onHeap) {
+				std::memcpy(m_inline, other.m_inline, m_size * sizeof(T));
+			}
+			other.m_heap.clear();
+			other.m_size = 0;
+			other.m_onHeap = false;
+		}
+
+		InlineVector& operator=(InlineVector&& other) noexcept {
+			if (this != &other) {
+				(*this).~InlineVector();
+				new(this) InlineVector(std::move(other));
+			}
+			return *this;
+		}
+
+		T* data() {
+			return m_onHeap ? m_heap.data() : inlineData();
+		}
+
+		const T* data() const {
+			return m_onHeap ? m_heap.data() : inlineData();
+		}
+
+		size_t size() const {
+			return m_size;
+		}
+
+		bool empty() const {
+			return m_size == 0;
+		}
+
+		T& operator[](size_t index) {
+			return data()[index];
+		}
+
+		const T& operator[](size_t index) const {
+			return data()[index];
+		}
+
+		T& back() {
+			return data()[m_size - 1];
+		}
+
+		T* begin() { return data(); }
+		T* end() { return data() + m_size; }
+		const T* begin() const { return data(); }
+		const T* end() const { return data() + m_size; }
+
+		void push_back(const T& element) {
+			if (m_onHeap) {
+				m_heap.push_back(element);
+			}
+			else if (m_size < N) {
+				std::memcpy(inlineData() + m_size, &element, sizeof(T));
+			}
+			else {
+				//	Copy first, element may be one of ours.
+				const T copy = element;
+				m_heap.reserve(2 * N);
+				m_heap.assign(inlineData(), inlineData() + N);
+				m_heap.push_back(copy);
+				m_onHeap = true;
+			}
+			m_size++;
+		}
+
+		void pop_back() {
+			if (m_onHeap) {
+				m_heap.pop_back();
+			}
+			m_size--;
+		}
+
+		void clear() {
+			m_heap.clear();
+			m_size = 0;
+			m_onHeap = false;
+		}
+
+	};
+
+
 	//	Yikes! Vulkan uses enums for bit values but uses
 	//	non-typesafe uints for the combination of flags.
 	//	The newer flags use 64 bit uints for values and combinations
@@ -456,6 +602,15 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			return allInstanceExtensionProperties;
 		}
 
+		static bool supportsExtension(const char* extensionName) {
+			for (const VkExtensionProperties& extensionProperties : getAllInstanceExtensionProperties()) {
+				if (std::string(extensionProperties.extensionName) == extensionName) {
+					return true;
+				}
+			}
+			return false;
+		}
+
 	};
 
 
@@ -594,12 +749,74 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			return vkPhysicalDeviceFeatures2;
 		}
 
+		//	pNext is cleared, it pointed at our stack.
+		VkPhysicalDeviceVulkan12Features getVulkan12Features() {
+			VkPhysicalDeviceVulkan12Features vkPhysicalDeviceVulkan12Features{};
+			vkPhysicalDeviceVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			VkPhysicalDeviceFeatures2	vkPhysicalDeviceFeatures2{};
+			vkPhysicalDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			vkPhysicalDeviceFeatures2.pNext = &vkPhysicalDeviceVulkan12Features;
+			vkGetPhysicalDeviceFeatures2(m_vkPhysicalDevice, &vkPhysicalDeviceFeatures2);
+			vkPhysicalDeviceVulkan12Features.pNext = nullptr;
+			return vkPhysicalDeviceVulkan12Features;
+		}
+
+		//	Check supportsExtension(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME) first.
+		VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT getSwapchainMaintenance1Features() {
+			VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT vkSwapchainMaintenance1Features{};
+			vkSwapchainMaintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2	vkPhysicalDeviceFeatures2{};
+			vkPhysicalDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			vkPhysicalDeviceFeatures2.pNext = &vkSwapchainMaintenance1Features;
+			vkGetPhysicalDeviceFeatures2(m_vkPhysicalDevice, &vkPhysicalDeviceFeatures2);
+			vkSwapchainMaintenance1Features.pNext = nullptr;
+			return vkSwapchainMaintenance1Features;
+		}
+
+		VkPhysicalDeviceProperties getPhysicalDeviceProperties() {
+			VkPhysicalDeviceProperties vkPhysicalDeviceProperties;
+			vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &vkPhysicalDeviceProperties);
+			return vkPhysicalDeviceProperties;
+		}
+
+		VkFormatProperties getFormatProperties(VkFormat vkFormat) const {
+			VkFormatProperties vkFormatProperties;
+			vkGetPhysicalDeviceFormatProperties(m_vkPhysicalDevice, vkFormat, &vkFormatProperties);
+			return vkFormatProperties;
+		}
+
 		VkPhysicalDeviceMemoryProperties getPhysicalDeviceMemoryProperties() {
 			VkPhysicalDeviceMemoryProperties vkPhysicalDeviceMemoryProperties;
 			vkGetPhysicalDeviceMemoryProperties(m_vkPhysicalDevice, &vkPhysicalDeviceMemoryProperties);
 			return vkPhysicalDeviceMemoryProperties;
 		}
 
+		//	Per heap budget and current usage, in bytes, as of the call.
+		//	Only valid if VK_EXT_memory_budget is supported.
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT getMemoryBudget() const {
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT vkMemoryBudget{};
+			vkMemoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 vkPhysicalDeviceMemoryProperties2{};
+			vkPhysicalDeviceMemoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			vkPhysicalDeviceMemoryProperties2.pNext = &vkMemoryBudget;
+			vkGetPhysicalDeviceMemoryProperties2(m_vkPhysicalDevice, &vkPhysicalDeviceMemoryProperties2);
+			vkMemoryBudget.pNext = nullptr;
+			return vkMemoryBudget;
+		}
+
+		bool supportsExtension(const char* extensionName) const {
+			uint32_t extensionCount = 0;
+			vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> allExtensionProperties(extensionCount);
+			vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &extensionCount, allExtensionProperties.data());
+			for (const VkExtensionProperties& extensionProperties : allExtensionProperties) {
+				if (std::string(extensionProperties.extensionName) == extensionName) {
+					return true;
+				}
+			}
+			return false;
+		}
+
 		uint32_t findMemoryTypeIndex(
 			uint32_t usableMemoryIndexBits,
 			MemoryPropertyFlags requiredProperties
@@ -625,6 +842,24 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			return allQueueFamilyProperties;
 		}
 
+		//	Finds a family that has all the required flags and none of the excluded ones,
+		//	e.g. (TRANSFER, GRAPHICS | COMPUTE) finds a dedicated transfer family.
+		std::optional<uint32_t> findQueueFamilyIndex(
+			VkQueueFlags requiredFlags,
+			VkQueueFlags excludedFlags = 0
+		) const {
+			const std::vector<VkQueueFamilyProperties> allQueueFamilyProperties = getAllQueueFamilyProperties();
+			for (uint32_t index = 0; index < allQueueFamilyProperties.size(); index++) {
+				const VkQueueFlags queueFlags = allQueueFamilyProperties[index].queueFlags;
+				if ((queueFlags & requiredFlags) == requiredFlags
+					&& (queueFlags & excludedFlags) == 0
+					&& allQueueFamilyProperties[index].queueCount > 0) {
+					return index;
+				}
+			}
+			return std::nullopt;
+		}
+
 	};
 
 
@@ -956,8 +1191,9 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 		std::array<int, MAX_DEVICE_QUEUE_FAMILIES> m_deviceQueueCounts{};
 		std::vector<VkDeviceQueueCreateInfo>	m_deviceQueueCreateInfos;
 
-		VkPhysicalDeviceSynchronization2Features m_sync2Features;
-
+		VkPhysicalDeviceSynchronization2Features m_sync2Features{};
+		VkPhysicalDeviceVulkan12Features m_vulkan12Features{};
+		VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT m_swapchainMaintenance1Features{};
 
 
 	public:
@@ -1017,10 +1253,32 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			m_sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
 			m_sync2Features.synchronization2 = TRUE;
 			pNext = &m_sync2Features;
+			//	Queues signal a GpuTimeline on every submit.  Core and required since 1.2.
+			//	The 1.2 features go in one structure, the per feature ones can't be mixed in.
+			m_vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			m_vulkan12Features.timelineSemaphore = TRUE;
+			m_sync2Features.pNext = &m_vulkan12Features;
+			if (m_swapchainMaintenance1Features.swapchainMaintenance1) {
+				m_swapchainMaintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+				m_vulkan12Features.pNext = &m_swapchainMaintenance1Features;
+			}
 
 			return this;
 		}
 
+		//	Optional in 1.2, check PhysicalDevice::getVulkan12Features first.
+		void enableDrawIndirectCount() {
+			m_vulkan12Features.drawIndirectCount = TRUE;
+		}
+
+		//	Present fences, for knowing when an old swapchain can go.  Check
+		//	PhysicalDevice::getSwapchainMaintenance1Features first, and the
+		//	instance needs VK_EXT_surface_maintenance1.
+		void enableSwapchainMaintenance1() {
+			addExtension(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+			m_swapchainMaintenance1Features.swapchainMaintenance1 = TRUE;
+		}
+
 
 		void addExtension(const char* extensionName) {
 			m_extensionNames.push_back(extensionName);
@@ -1157,374 +1415,1414 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			vkWaitForFences(m_owner, 1, &vkFence, VK_TRUE, UINT64_MAX);
 		}
 
+		bool signaled() const {
+			return vkGetFenceStatus(m_owner, *this) == VK_SUCCESS;
+		}
+
 	};
 
 
+	//	Keeps fences and binary semaphores for reuse instead of creating
+	//	and destroying them around every one-shot submit.
+	//	Fences are handed out closed, semaphores unsignaled.  Give them back
+	//	once they have retired: the fence has opened (or was never submitted),
+	//	and any wait on the semaphore has completed.
+	//	Locked, so any thread can use it.  Must outlive anything that gives back.
+	class SyncObjectPool {
 
-	class DeviceMemory : public HandleWithOwner<VkDeviceMemory> {
+	public:
 
-		static void destroy(VkDeviceMemory vkDeviceMemory, VkDevice vkDevice) {
-			vkFreeMemory(vkDevice, vkDeviceMemory, nullptr);
-		}
+		struct Stats {
+			uint64_t	m_fenceHits = 0;
+			uint64_t	m_fenceMisses = 0;		//	Created a new one.
+			uint64_t	m_semaphoreHits = 0;
+			uint64_t	m_semaphoreMisses = 0;
+			uint64_t	m_freeFenceCount = 0;
+			uint64_t	m_freeSemaphoreCount = 0;
+		};
 
+	private:
 
-		DeviceMemory(VkDeviceMemory vkDeviceMemory, VkDevice vkDevice, VkDeviceSize size, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkDeviceMemory, vkDevice, pfnDestroy)
-			, m_size(size) {
-		}
+		VkDevice	m_vkDevice = nullptr;
+		std::vector<Fence>		m_freeFences;
+		std::vector<Semaphore>	m_freeSemaphores;
+		std::mutex	m_mutex;
+		Stats		m_stats;
 
+	public:
 
-		VkDeviceSize	m_size = 0;
+		SyncObjectPool(const SyncObjectPool&) = delete;
+		SyncObjectPool& operator=(const SyncObjectPool&) = delete;
+		SyncObjectPool(SyncObjectPool&&) = delete;
+		SyncObjectPool& operator=(SyncObjectPool&&) = delete;
 
-	public:
+		explicit SyncObjectPool(VkDevice vkDevice)
+			: m_vkDevice(vkDevice) {
+		}
 
-		DeviceMemory() {}
+		Fence acquireFence() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_freeFences.empty()) {
+				m_stats.m_fenceMisses++;
+				return Fence(m_vkDevice);
+			}
+			m_stats.m_fenceHits++;
+			Fence fence = std::move(m_freeFences.back());
+			m_freeFences.pop_back();
+			return fence;
+		}
 
-		DeviceMemory(const VkMemoryAllocateInfo& vkMemoryAllocateInfo, VkDevice vkDevice) {
-			VkDeviceMemory vkDeviceMemory;
-			VkResult vkResult = vkAllocateMemory(vkDevice, &vkMemoryAllocateInfo, nullptr, &vkDeviceMemory);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		//	Closes it again if it was submitted.
+		void releaseFence(Fence&& fence) {
+			if (!fence) {
+				return;
 			}
-			new(this)DeviceMemory(vkDeviceMemory, vkDevice, vkMemoryAllocateInfo.allocationSize, &destroy);
+			if (fence.signaled()) {
+				fence.close();
+			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freeFences.push_back(std::move(fence));
 		}
 
+		Semaphore acquireSemaphore() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_freeSemaphores.empty()) {
+				m_stats.m_semaphoreMisses++;
+				return Semaphore(m_vkDevice);
+			}
+			m_stats.m_semaphoreHits++;
+			Semaphore semaphore = std::move(m_freeSemaphores.back());
+			m_freeSemaphores.pop_back();
+			return semaphore;
+		}
 
-		DeviceMemory(
-			VkMemoryRequirements vkMemoryRequirements,
-			MemoryPropertyFlags requiredMemoryPropertyFlags,
-			Device	device
-		) {
-			VkMemoryAllocateInfo vkMemoryAllocateInfo{};
-			vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
-			vkMemoryAllocateInfo.memoryTypeIndex =
-				device.findMemoryTypeIndex(vkMemoryRequirements.memoryTypeBits, requiredMemoryPropertyFlags);
-			new(this)DeviceMemory(vkMemoryAllocateInfo, device);
+		void releaseSemaphore(Semaphore&& semaphore) {
+			if (!semaphore) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freeSemaphores.push_back(std::move(semaphore));
 		}
 
+		Stats getStats() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Stats stats = m_stats;
+			stats.m_freeFenceCount = m_freeFences.size();
+			stats.m_freeSemaphoreCount = m_freeSemaphores.size();
+			return stats;
+		}
 
 	};
 
 
-	class Buffer : public HandleWithOwner<VkBuffer, Device> {
+	//	Timestamp queries only for now.
+	class QueryPool : public HandleWithOwner<VkQueryPool> {
 
-		static void destroy(VkBuffer vkBuffer, Device device) {
-			vkDestroyBuffer(device, vkBuffer, nullptr);
+		QueryPool(VkQueryPool vkQueryPool, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkQueryPool, vkDevice, pfnDestroy) {
 		}
 
-		Buffer(VkBuffer vkBuffer, Device device, VkDeviceSize size, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkBuffer, device, pfnDestroy)
-			, m_size(size) {
+		static void destroy(VkQueryPool vkQueryPool, VkDevice vkDevice) {
+			vkDestroyQueryPool(vkDevice, vkQueryPool, nullptr);
 		}
 
-		Buffer(const VkBufferCreateInfo& vkBufferCreateInfo, Device device) {
-			VkBuffer vkBuffer;
-			VkResult vkResult = vkCreateBuffer(device, &vkBufferCreateInfo, nullptr, &vkBuffer);
+	public:
+
+		QueryPool() {}
+
+		QueryPool(uint32_t queryCount, VkDevice vkDevice) {
+			VkQueryPoolCreateInfo vkQueryPoolCreateInfo{};
+			vkQueryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			vkQueryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			vkQueryPoolCreateInfo.queryCount = queryCount;
+			VkQueryPool vkQueryPool;
+			VkResult vkResult = vkCreateQueryPool(vkDevice, &vkQueryPoolCreateInfo, nullptr, &vkQueryPool);
 			if (vkResult != VK_SUCCESS) {
 				throw Exception(vkResult);
 			}
-			new(this)Buffer(vkBuffer, device, vkBufferCreateInfo.size, &destroy);
+			new(this) QueryPool(vkQueryPool, vkDevice, &destroy);
 		}
 
-		VkDeviceSize	m_size = 0;
+		//	Doesn't wait, returns false if any of the queries aren't available yet.
+		bool getResults(uint32_t firstQuery, uint32_t queryCount, uint64_t* pResults) const {
+			VkResult vkResult = vkGetQueryPoolResults(
+				m_owner, *this, firstQuery, queryCount,
+				queryCount * sizeof(uint64_t), pResults, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT);
+			if (vkResult == VK_NOT_READY) {
+				return false;
+			}
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			return true;
+		}
+
+	};
+
+
+
+	//	A fixed set of threads pulling jobs off one queue.
+	//	Jobs should catch their own exceptions; an escaped one is kept
+	//	and rethrown from the next waitIdle.
+	class WorkerPool {
+
+		std::vector<std::thread>	m_threads;
+		std::deque<std::function<void()>>	m_jobs;
+		std::mutex	m_mutex;
+		std::condition_variable	m_jobAvailable;
+		std::condition_variable	m_idle;
+		uint32_t	m_busyCount = 0;
+		bool		m_stopping = false;
+		std::exception_ptr	m_exception;
+
+		void run() {
+			for (;;) {
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+					if (m_jobs.empty()) {
+						return;		//	Stopping and drained.
+					}
+					job = std::move(m_jobs.front());
+					m_jobs.pop_front();
+					m_busyCount++;
+				}
+
+				try {
+					job();
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (!m_exception) {
+						m_exception = std::current_exception();
+					}
+				}
 
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_busyCount--;
+				if (m_busyCount == 0 && m_jobs.empty()) {
+					m_idle.notify_all();
+				}
+			}
+		}
 
 	public:
 
-		Buffer() {}
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+		WorkerPool(WorkerPool&&) = delete;
+		WorkerPool& operator=(WorkerPool&&) = delete;
 
-		Buffer(
-			VkBufferUsageFlags	vkBufferUsageFlags,
-			VkDeviceSize		size,
-			uint32_t			queueFamilyIndex,
-			Device				device
-		) {
-			VkBufferCreateInfo vkBufferCreateInfo{};
-			vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			vkBufferCreateInfo.usage = vkBufferUsageFlags;
-			vkBufferCreateInfo.size = size;
-			vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			uint32_t	queueFamilyIndexLocal = queueFamilyIndex;
-			vkBufferCreateInfo.pQueueFamilyIndices = &queueFamilyIndexLocal;
-			new(this)Buffer(vkBufferCreateInfo, device);
+		//	Leaves a core for the thread that feeds the pool.
+		static uint32_t defaultThreadCount() {
+			const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
 
+		explicit WorkerPool(uint32_t threadCount = defaultThreadCount()) {
+			for (uint32_t i = 0; i < threadCount; i++) {
+				m_threads.emplace_back(&WorkerPool::run, this);
+			}
 		}
 
-		VkDeviceSize size() const {
-			return m_size;
+		//	Finishes the queued jobs before the threads exit.
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_jobAvailable.notify_all();
+			for (std::thread& thread : m_threads) {
+				thread.join();
+			}
 		}
 
-		VkMemoryRequirements  getMemoryRequirements() {
-			VkMemoryRequirements vkMemoryRequirements;
-			vkGetBufferMemoryRequirements(getVkDevice(), *this, &vkMemoryRequirements);
-			return vkMemoryRequirements;
+		uint32_t threadCount() const {
+			return static_cast<uint32_t>(m_threads.size());
 		}
 
-		DeviceMemory allocateDeviceMemory(MemoryPropertyFlags requiredMemoryPropertyFlags) {
-			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
-			return DeviceMemory(vkMemoryRequirements, requiredMemoryPropertyFlags, getOwner());
+		void enqueue(std::function<void()> job) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.push_back(std::move(job));
+			}
+			m_jobAvailable.notify_one();
+		}
+
+		void waitIdle() {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_idle.wait(lock, [this] { return m_busyCount == 0 && m_jobs.empty(); });
+			if (m_exception) {
+				std::exception_ptr exception = m_exception;
+				m_exception = nullptr;
+				std::rethrow_exception(exception);
+			}
+		}
+
+		//	co_await workerPool.schedule() continues the coroutine on one of the workers.
+		auto schedule() {
+			struct Awaiter {
+				WorkerPool& m_workerPool;
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) {
+					m_workerPool.enqueue([handle] { handle.resume(); });
+				}
+				void await_resume() const noexcept {}
+			};
+			return Awaiter{ *this };
 		}
 
 	};
 
 
-	class Buffer_DeviceMemory {
+	namespace detail {
 
-		Buffer_DeviceMemory(Buffer&& buffer, DeviceMemory&& deviceMemory, void* mappedMemory)
-			: m_buffer(std::move(buffer))
-			, m_deviceMemory(std::move(deviceMemory))
-			, m_mappedMemory(mappedMemory) {
+		template <typename T>
+		struct TaskResult {
+			std::optional<T>	m_value;
+
+			void return_value(T value) {
+				m_value = std::move(value);
+			}
+
+			T take() {
+				return std::move(*m_value);
+			}
+		};
+
+		template <>
+		struct TaskResult<void> {
+			void return_void() {}
+			void take() {}
+		};
+
+	}
+
+
+	//	A coroutine that doesn't run until it is awaited or started.
+	//	Awaiting runs it to completion, then resumes the awaiter on whatever
+	//	thread the task finished on.  A started task can be polled with
+	//	done() from any thread, and once it is done get() returns its result
+	//	or rethrows what escaped it.  Destroying an unfinished task is only
+	//	safe while it is suspended somewhere that won't resume it.
+	template <typename T = void>
+	class Task {
+
+	public:
+
+		struct promise_type : detail::TaskResult<T> {
+			std::coroutine_handle<>	m_continuation;
+			std::exception_ptr		m_exception;
+			std::atomic<bool>		m_done = false;		//	Publishes the result to done().
+
+			struct FinalAwaiter {
+				bool await_ready() const noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+					std::coroutine_handle<> continuation = handle.promise().m_continuation;
+					//	The poller can destroy the frame as soon as it sees this.
+					handle.promise().m_done.store(true, std::memory_order_release);
+					if (continuation) {
+						return continuation;
+					}
+					return std::noop_coroutine();
+				}
+				void await_resume() const noexcept {}
+			};
+
+			Task get_return_object() {
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+
+			void unhandled_exception() {
+				m_exception = std::current_exception();
+			}
+		};
+
+	private:
+
+		std::coroutine_handle<promise_type>	m_handle;
+
+		explicit Task(std::coroutine_handle<promise_type> handle)
+			: m_handle(handle) {
+		}
+
+		T result() {
+			promise_type& promise = m_handle.promise();
+			if (promise.m_exception) {
+				std::rethrow_exception(promise.m_exception);
+			}
+			return promise.take();
 		}
 
 	public:
 
-		Buffer			m_buffer;
-		DeviceMemory	m_deviceMemory;
-		void* m_mappedMemory = nullptr;
+		Task() {}
 
-		Buffer_DeviceMemory() {}
+		~Task() {
+			if (m_handle) {
+				m_handle.destroy();
+			}
+			m_handle = nullptr;
+		}
 
-		Buffer_DeviceMemory(const Buffer_DeviceMemory& other)
-			: m_buffer(other.m_buffer)
-			, m_deviceMemory(other.m_deviceMemory)
-			, m_mappedMemory(other.m_mappedMemory) {
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		Task(Task&& other) noexcept
+			: m_handle(other.m_handle) {
+			other.m_handle = nullptr;
 		}
-		Buffer_DeviceMemory& operator=(const Buffer_DeviceMemory& other) {
+
+		Task& operator=(Task&& other) noexcept {
 			if (this == &other) {
 				return *this;
 			}
-			(*this).~Buffer_DeviceMemory();
-			new(this) Buffer_DeviceMemory(other);
+			(*this).~Task();
+			new(this) Task(std::move(other));
 			return *this;
 		}
 
-		Buffer_DeviceMemory(Buffer_DeviceMemory&& other) noexcept
-			: m_buffer(std::move(other.m_buffer))
-			, m_deviceMemory(std::move(other.m_deviceMemory))
-			, m_mappedMemory(other.m_mappedMemory) {
+		//	Runs on this thread up to the first suspension.
+		void start() {
+			m_handle.resume();
 		}
 
-		Buffer_DeviceMemory& operator=(Buffer_DeviceMemory&& other) noexcept {
-			if (this == &other) {
-				return *this;
-			}
-			(*this).~Buffer_DeviceMemory();
-			new(this) Buffer_DeviceMemory(std::move(other));
-			return *this;
+		bool done() const {
+			return m_handle && m_handle.promise().m_done.load(std::memory_order_acquire);
 		}
 
+		T get() {
+			return result();
+		}
 
+		auto operator co_await() {
+			struct Awaiter {
+				Task& m_task;
 
-		Buffer_DeviceMemory(
-			VkBufferUsageFlags vkBufferUsageFlags,
-			VkDeviceSize size,
-			uint32_t	queueFamilyIndex,
-			MemoryPropertyFlags memoryPropertyFlags,
-			Device device
-		) {
-			Buffer buffer(vkBufferUsageFlags, size, queueFamilyIndex, device);
+				bool await_ready() const noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+					m_task.m_handle.promise().m_continuation = awaiting;
+					return m_task.m_handle;
+				}
+				T await_resume() {
+					return m_task.result();
+				}
+			};
+			return Awaiter{ *this };
+		}
 
-			DeviceMemory deviceMemory = buffer.allocateDeviceMemory(memoryPropertyFlags);
+	};
 
-			VkResult vkResult = vkBindBufferMemory(device, buffer, deviceMemory, 0);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
 
-			// TODO: should this be a method on DeviceMemory?
-			void* mappedMemory;
-			vkResult = vkMapMemory(device, deviceMemory, 0, size, 0, &mappedMemory);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
+	//	Resumes coroutines on the thread that calls poll, e.g. the render loop
+	//	once a frame, for work that has to stay on that thread.  schedule() can
+	//	be awaited from any thread.  until(ready) resumes on the first poll that
+	//	finds ready() true; ready is only ever called from poll.
+	class PollingExecutor {
 
-			new(this) Buffer_DeviceMemory(std::move(buffer), std::move(deviceMemory), mappedMemory);
+		struct Waiting {
+			std::function<bool()>	m_ready;
+			std::coroutine_handle<>	m_handle;
+		};
 
-		}
+		std::mutex	m_mutex;
+		std::condition_variable	m_scheduledAvailable;
+		std::vector<std::coroutine_handle<>>	m_scheduled;
+		std::vector<Waiting>	m_waiting;
 
-		Buffer_DeviceMemory(
-			VkBufferUsageFlags vkBufferUsageFlags,
-			int64_t size,
-			uint32_t	queueFamilyIndex,
-			MemoryPropertyFlags requiredMemoryPropertyFlags,
-			void* pSrcMem,
-			Device device
-		) {
-			new(this)Buffer_DeviceMemory(
-				vkBufferUsageFlags,
-				size,
-				queueFamilyIndex,
-				requiredMemoryPropertyFlags,
-				device
-			);
-			memcpy(m_mappedMemory, pSrcMem, size);
-			//unmapMemory();
+	public:
+
+		PollingExecutor() {}
+
+		PollingExecutor(const PollingExecutor&) = delete;
+		PollingExecutor& operator=(const PollingExecutor&) = delete;
+		PollingExecutor(PollingExecutor&&) = delete;
+		PollingExecutor& operator=(PollingExecutor&&) = delete;
+
+		auto schedule() {
+			struct Awaiter {
+				PollingExecutor& m_pollingExecutor;
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) {
+					//	Notify under the lock, once it is released the coroutine
+					//	(and this awaiter in its frame) may be resumed and gone.
+					std::lock_guard<std::mutex> lock(m_pollingExecutor.m_mutex);
+					m_pollingExecutor.m_scheduled.push_back(handle);
+					m_pollingExecutor.m_scheduledAvailable.notify_one();
+				}
+				void await_resume() const noexcept {}
+			};
+			return Awaiter{ *this };
 		}
 
+		auto until(std::function<bool()> ready) {
+			struct Awaiter {
+				PollingExecutor& m_pollingExecutor;
+				std::function<bool()>	m_ready;
 
-		void unmapMemory() {
-			vkUnmapMemory(m_deviceMemory.getVkDevice(), m_deviceMemory);
-			m_mappedMemory = nullptr;
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) {
+					std::lock_guard<std::mutex> lock(m_pollingExecutor.m_mutex);
+					m_pollingExecutor.m_waiting.push_back({ std::move(m_ready), handle });
+				}
+				void await_resume() const noexcept {}
+			};
+			return Awaiter{ *this, std::move(ready) };
+		}
+
+		//	Resumes everything scheduled and everything whose wait is over.
+		//	Returns how many were resumed.
+		size_t poll() {
+			std::vector<std::coroutine_handle<>> scheduled;
+			std::vector<Waiting> waiting;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				scheduled.swap(m_scheduled);
+				waiting.swap(m_waiting);
+			}
+
+			size_t resumedCount = scheduled.size();
+			for (std::coroutine_handle<> handle : scheduled) {
+				handle.resume();
+			}
+
+			std::vector<Waiting> stillWaiting;
+			for (Waiting& wait : waiting) {
+				if (wait.m_ready()) {
+					wait.m_handle.resume();
+					resumedCount++;
+				}
+				else {
+					stillWaiting.push_back(std::move(wait));
+				}
+			}
 
+			//	Anything resumed above may have started waiting again meanwhile.
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_waiting.insert(m_waiting.begin(),
+				std::make_move_iterator(stillWaiting.begin()),
+				std::make_move_iterator(stillWaiting.end()));
+			return resumedCount;
+		}
+
+		//	Polls until done() is true, sleeping while there is nothing to resume.
+		void pollUntil(const std::function<bool()>& done) {
+			while (!done()) {
+				if (poll() == 0) {
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_scheduledAvailable.wait_for(lock, std::chrono::milliseconds(1),
+						[this] { return !m_scheduled.empty(); });
+				}
+			}
 		}
 
 	};
 
 
-	class ShaderModule : public HandleWithOwner<VkShaderModule> {
+	//	Hands out aligned ranges of a few large VkDeviceMemory blocks
+	//	instead of doing one vkAllocateMemory per buffer/image.
+	//	Blocks are kept per memory type.  Host visible blocks are mapped
+	//	once for their whole life.
+	//	The arena must outlive everything allocated from it.
+	class DeviceMemoryArena {
 
-		static std::vector<char> readFile(const std::string& filename) {
-			std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	public:
 
-			if (!file.is_open()) {
-				throw std::runtime_error("failed to open file!");
+		static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+		//	Linear resources (buffers) and optimal resources (images) can't
+		//	share a bufferImageGranularity sized page.
+		enum class ResourceKind {
+			LINEAR,
+			OPTIMAL
+		};
+
+		struct Allocation {
+			VkDeviceMemory	m_vkDeviceMemory = nullptr;
+			VkDeviceSize	m_offset = 0;
+			VkDeviceSize	m_size = 0;
+			uint32_t		m_memoryTypeIndex = 0;
+			void* m_mappedMemory = nullptr;
+		};
+
+		struct Stats {
+			uint64_t		m_blockCount = 0;				//	Live vkAllocateMemory allocations.
+			uint64_t		m_totalBlockAllocations = 0;
+			uint64_t		m_subAllocationCount = 0;		//	Live ranges handed out.
+			uint64_t		m_totalSubAllocations = 0;
+			VkDeviceSize	m_bytesReserved = 0;
+			VkDeviceSize	m_bytesInUse = 0;
+			uint64_t		m_freeRangeCount = 0;
+			VkDeviceSize	m_largestFreeRange = 0;
+
+			//	0 when all the free space is one range, approaching 1
+			//	as free space gets chopped into small pieces.
+			double fragmentation() const {
+				const VkDeviceSize bytesFree = m_bytesReserved - m_bytesInUse;
+				if (bytesFree == 0) {
+					return 0.0;
+				}
+				return 1.0 - (double)m_largestFreeRange / (double)bytesFree;
 			}
-			size_t fileSize = (size_t)file.tellg();
-			std::vector<char> buffer(fileSize);
-			file.seekg(0);
-			file.read(buffer.data(), fileSize);
-			file.close();
+		};
 
-			return buffer;
-		}
+	private:
 
-		static void destroy(VkShaderModule vkShaderModule, VkDevice vkDevice) {
-			vkDestroyShaderModule(vkDevice, vkShaderModule, nullptr);
-		}
+		struct FreeRange {
+			VkDeviceSize	m_offset = 0;
+			VkDeviceSize	m_size = 0;
+		};
 
-		ShaderModule(VkShaderModule vkShaderModule, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner<VkShaderModule>(vkShaderModule, vkDevice, pfnDestroy) {
-		}
+		struct Block {
+			VkDeviceMemory	m_vkDeviceMemory = nullptr;
+			VkDeviceSize	m_size = 0;
+			void* m_mappedMemory = nullptr;
+			uint32_t		m_subAllocationCount = 0;
+			std::vector<FreeRange>	m_freeRanges;	//	Sorted by offset, adjacent ranges merged.
+		};
 
+		Device			m_device;
+		VkDeviceSize	m_blockSize = DEFAULT_BLOCK_SIZE;
+		VkDeviceSize	m_bufferImageGranularity = 1;
+		VkPhysicalDeviceMemoryProperties	m_memoryProperties{};
 
+		std::array<std::vector<Block>, VK_MAX_MEMORY_TYPES>	m_blocks;
+		std::mutex		m_mutex;
 
-	public:
+		uint64_t	m_totalBlockAllocations = 0;
+		uint64_t	m_totalSubAllocations = 0;
 
-		ShaderModule() {}
 
-		static ShaderModule createShaderModuleFromFile(const char* fileName, VkDevice vkDevice) {
-			auto fragShaderCode = readFile(fileName);
-			VkShaderModuleCreateInfo createInfo{};
-			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			createInfo.codeSize = fragShaderCode.size();
-			createInfo.pCode = reinterpret_cast<const uint32_t*>(fragShaderCode.data());
-			VkShaderModule vkShaderModule;
-			VkResult vkResult = vkCreateShaderModule(vkDevice, &createInfo, nullptr, &vkShaderModule);
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		uint32_t findMemoryTypeIndex(uint32_t usableMemoryIndexBits, MemoryPropertyFlags requiredProperties) const {
+			for (uint32_t index = 0; index < m_memoryProperties.memoryTypeCount; index++) {
+				if ((usableMemoryIndexBits & (1 << index))
+					&& bitsSet(m_memoryProperties.memoryTypes[index].propertyFlags, requiredProperties)) {
+					return index;
+				}
+			}
+			throw std::runtime_error("failed to find suitable memory type!");
+		}
+
+		Block& allocateBlock(uint32_t memoryTypeIndex, VkDeviceSize size) {
+			VkMemoryAllocateInfo vkMemoryAllocateInfo{};
+			vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			vkMemoryAllocateInfo.allocationSize = size;
+			vkMemoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+			Block block;
+			VkResult vkResult = vkAllocateMemory(m_device, &vkMemoryAllocateInfo, nullptr, &block.m_vkDeviceMemory);
 			if (vkResult != VK_SUCCESS) {
 				throw Exception(vkResult);
 			}
-			return ShaderModule(vkShaderModule, vkDevice, &destroy);
+			block.m_size = size;
+			block.m_freeRanges.push_back({ 0, size });
+
+			if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+				vkResult = vkMapMemory(m_device, block.m_vkDeviceMemory, 0, VK_WHOLE_SIZE, 0, &block.m_mappedMemory);
+				if (vkResult != VK_SUCCESS) {
+					vkFreeMemory(m_device, block.m_vkDeviceMemory, nullptr);
+					throw Exception(vkResult);
+				}
+			}
+
+			m_totalBlockAllocations++;
+			m_blocks[memoryTypeIndex].push_back(std::move(block));
+			return m_blocks[memoryTypeIndex].back();
 		}
 
-	};
+		//	First fit.  Any alignment padding in front stays in the free list.
+		static bool carve(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+			for (size_t i = 0; i < block.m_freeRanges.size(); i++) {
+				FreeRange freeRange = block.m_freeRanges[i];
+				const VkDeviceSize alignedOffset = alignUp(freeRange.m_offset, alignment);
+				const VkDeviceSize freeEnd = freeRange.m_offset + freeRange.m_size;
+				if (alignedOffset + size > freeEnd) {
+					continue;
+				}
+				block.m_freeRanges.erase(block.m_freeRanges.begin() + i);
+				if (alignedOffset + size < freeEnd) {
+					block.m_freeRanges.insert(
+						block.m_freeRanges.begin() + i,
+						{ alignedOffset + size, freeEnd - (alignedOffset + size) });
+				}
+				if (alignedOffset > freeRange.m_offset) {
+					block.m_freeRanges.insert(
+						block.m_freeRanges.begin() + i,
+						{ freeRange.m_offset, alignedOffset - freeRange.m_offset });
+				}
+				offset = alignedOffset;
+				block.m_subAllocationCount++;
+				return true;
+			}
+			return false;
+		}
 
+		static void release(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+			auto it = std::lower_bound(
+				block.m_freeRanges.begin(),
+				block.m_freeRanges.end(),
+				offset,
+				[](const FreeRange& freeRange, VkDeviceSize value) { return freeRange.m_offset < value; });
+			it = block.m_freeRanges.insert(it, { offset, size });
 
-	class AttachmentDescription : public VkAttachmentDescription {
+			auto next = it + 1;
+			if (next != block.m_freeRanges.end() && it->m_offset + it->m_size == next->m_offset) {
+				it->m_size += next->m_size;
+				block.m_freeRanges.erase(next);
+			}
+			if (it != block.m_freeRanges.begin()) {
+				auto prev = it - 1;
+				if (prev->m_offset + prev->m_size == it->m_offset) {
+					prev->m_size += it->m_size;
+					block.m_freeRanges.erase(it);
+				}
+			}
+			block.m_subAllocationCount--;
+		}
 
 	public:
 
-		AttachmentDescription()
-			: VkAttachmentDescription{} {
+		DeviceMemoryArena(const DeviceMemoryArena&) = delete;
+		DeviceMemoryArena& operator=(const DeviceMemoryArena&) = delete;
+		DeviceMemoryArena(DeviceMemoryArena&&) = delete;
+		DeviceMemoryArena& operator=(DeviceMemoryArena&&) = delete;
+
+		DeviceMemoryArena(Device device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE)
+			: m_device(device)
+			, m_blockSize(blockSize) {
+			PhysicalDevice physicalDevice = m_device.getPhysicalDevice();
+			m_bufferImageGranularity = physicalDevice.getPhysicalDeviceProperties().limits.bufferImageGranularity;
+			if (m_bufferImageGranularity == 0) {
+				m_bufferImageGranularity = 1;
+			}
+			m_memoryProperties = physicalDevice.getPhysicalDeviceMemoryProperties();
 		}
 
-		static AttachmentDescription simpleColorAttachmentPresentDescription(
-			VkFormat	colorAttachmentVkFormat
-		) {
-			AttachmentDescription	colorAttachmentDescription;
-			//	Reasonable defaults
-			colorAttachmentDescription.format = colorAttachmentVkFormat;
-			colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-			return colorAttachmentDescription;
+		~DeviceMemoryArena() {
+			for (std::vector<Block>& blocks : m_blocks) {
+				for (Block& block : blocks) {
+					vkFreeMemory(m_device, block.m_vkDeviceMemory, nullptr);
+				}
+				blocks.clear();
+			}
 		}
 
-		static AttachmentDescription simpleColorAttachmentDescription(
-			VkFormat	colorAttachmentVkFormat
+		Device getDevice() const {
+			return m_device;
+		}
+
+		Allocation allocate(
+			const VkMemoryRequirements& vkMemoryRequirements,
+			MemoryPropertyFlags requiredProperties,
+			ResourceKind resourceKind
 		) {
-			AttachmentDescription	colorAttachmentDescription;
-			//	Reasonable defaults
-			colorAttachmentDescription.format = colorAttachmentVkFormat;
-			colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			return colorAttachmentDescription;
+			const uint32_t memoryTypeIndex =
+				findMemoryTypeIndex(vkMemoryRequirements.memoryTypeBits, requiredProperties);
+
+			VkDeviceSize alignment = std::max<VkDeviceSize>(vkMemoryRequirements.alignment, 1);
+			VkDeviceSize size = vkMemoryRequirements.size;
+			//	Optimal resources get whole granularity pages to themselves,
+			//	so nothing linear can ever land on the same page.
+			if (resourceKind == ResourceKind::OPTIMAL && m_bufferImageGranularity > 1) {
+				alignment = std::max(alignment, m_bufferImageGranularity);
+				size = alignUp(size, m_bufferImageGranularity);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			VkDeviceSize offset = 0;
+			Block* pBlock = nullptr;
+			for (Block& block : m_blocks[memoryTypeIndex]) {
+				if (carve(block, size, alignment, offset)) {
+					pBlock = &block;
+					break;
+				}
+			}
+			if (!pBlock) {
+				//	Oversized requests get a block of their own.
+				pBlock = &allocateBlock(memoryTypeIndex, std::max(m_blockSize, alignUp(size, alignment)));
+				if (!carve(*pBlock, size, alignment, offset)) {
+					throw Exception(VK_ERROR_OUT_OF_DEVICE_MEMORY);
+				}
+			}
+			m_totalSubAllocations++;
+
+			Allocation allocation;
+			allocation.m_vkDeviceMemory = pBlock->m_vkDeviceMemory;
+			allocation.m_offset = offset;
+			allocation.m_size = size;
+			allocation.m_memoryTypeIndex = memoryTypeIndex;
+			if (pBlock->m_mappedMemory) {
+				allocation.m_mappedMemory = (char*)pBlock->m_mappedMemory + offset;
+			}
+			return allocation;
 		}
 
+		void free(const Allocation& allocation) {
+			std::lock_guard<std::mutex> lock(m_mutex);
 
-		static AttachmentDescription simpleDepthAttachmentDescription() {
-			AttachmentDescription depthAttachmentDescription;
-			//	Reasonable defaults
-			depthAttachmentDescription.format = VK_FORMAT_D32_SFLOAT;
-			depthAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			depthAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			depthAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			depthAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			depthAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			depthAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			depthAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-			return depthAttachmentDescription;
+			std::vector<Block>& blocks = m_blocks[allocation.m_memoryTypeIndex];
+			for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+				if (it->m_vkDeviceMemory != allocation.m_vkDeviceMemory) {
+					continue;
+				}
+				release(*it, allocation.m_offset, allocation.m_size);
+				//	Hang on to the last block of a type so that
+				//	alloc/free churn doesn't keep hitting the driver.
+				if (it->m_subAllocationCount == 0 && blocks.size() > 1) {
+					vkFreeMemory(m_device, it->m_vkDeviceMemory, nullptr);
+					blocks.erase(it);
+				}
+				return;
+			}
+			throw Exception("DeviceMemoryArena::free: unknown allocation");
 		}
 
+		//	Space in our blocks on a heap that new allocations can use
+		//	without the heap's usage going up.
+		VkDeviceSize freeBytesInHeap(uint32_t heapIndex) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			VkDeviceSize bytesFree = 0;
+			for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < m_memoryProperties.memoryTypeCount; memoryTypeIndex++) {
+				if (m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex != heapIndex) {
+					continue;
+				}
+				for (const Block& block : m_blocks[memoryTypeIndex]) {
+					for (const FreeRange& freeRange : block.m_freeRanges) {
+						bytesFree += freeRange.m_size;
+					}
+				}
+			}
+			return bytesFree;
+		}
+
+		Stats getStats() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			Stats stats;
+			stats.m_totalBlockAllocations = m_totalBlockAllocations;
+			stats.m_totalSubAllocations = m_totalSubAllocations;
+			for (const std::vector<Block>& blocks : m_blocks) {
+				for (const Block& block : blocks) {
+					stats.m_blockCount++;
+					stats.m_subAllocationCount += block.m_subAllocationCount;
+					stats.m_bytesReserved += block.m_size;
+					VkDeviceSize bytesFree = 0;
+					for (const FreeRange& freeRange : block.m_freeRanges) {
+						bytesFree += freeRange.m_size;
+						stats.m_largestFreeRange = std::max(stats.m_largestFreeRange, freeRange.m_size);
+					}
+					stats.m_freeRangeCount += block.m_freeRanges.size();
+					stats.m_bytesInUse += block.m_size - bytesFree;
+				}
+			}
+			return stats;
+		}
 
 	};
-	static_assert(sizeof(AttachmentDescription) == sizeof(VkAttachmentDescription));
 
 
+	class DeviceMemory : public HandleWithOwner<VkDeviceMemory> {
 
-	class SubpassDescription : public VkSubpassDescription {
+		static void destroy(VkDeviceMemory vkDeviceMemory, VkDevice vkDevice) {
+			vkFreeMemory(vkDevice, vkDeviceMemory, nullptr);
+		}
 
-		std::vector<VkAttachmentReference>	m_inputAttachmentReferences;
-		std::vector<VkAttachmentReference>	m_colorAttachmentReferences;
-		VkAttachmentReference				m_depthStencilAttachmentReference{};
-		bool								m_haveDepthStencilAttachmentReference{};
+
+		DeviceMemory(VkDeviceMemory vkDeviceMemory, VkDevice vkDevice, VkDeviceSize size, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkDeviceMemory, vkDevice, pfnDestroy)
+			, m_size(size) {
+		}
 
 
+		VkDeviceSize	m_size = 0;
+
+		//	Only filled in for memory that is a range of an arena block.
+		//	The handle is then the arena's block, which we never free ourselves.
+		//	Like the handle, only the original (not a copy) gives the range back.
+		DeviceMemoryArena::Allocation	m_arenaAllocation{};
+		DeviceMemoryArena* m_pDeviceMemoryArena = nullptr;
+
 	public:
 
-		VkSubpassDescription* operator&() = delete;
+		DeviceMemory() {}
 
-		SubpassDescription()
-			: VkSubpassDescription{} {
+		~DeviceMemory() {
+			if (m_pDeviceMemoryArena) {
+				m_pDeviceMemoryArena->free(m_arenaAllocation);
+			}
+			m_pDeviceMemoryArena = nullptr;
 		}
 
-		SubpassDescription& setPipelineBindPoint(VkPipelineBindPoint vkPipelineBindPoint) {
-			pipelineBindPoint = vkPipelineBindPoint;
-			return *this;
+		DeviceMemory(const DeviceMemory& other)
+			: HandleWithOwner(other)
+			, m_size(other.m_size)
+			, m_arenaAllocation(other.m_arenaAllocation)
+			, m_pDeviceMemoryArena(nullptr) {
 		}
 
-		SubpassDescription& addInputAttachmentReference(VkAttachmentReference& vkAttachmentReference) {
-			m_inputAttachmentReferences.push_back(vkAttachmentReference);
+		DeviceMemory& operator=(const DeviceMemory& other) {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~DeviceMemory();
+			new(this) DeviceMemory(other);
 			return *this;
 		}
 
-		SubpassDescription& addColorAttachmentReference(VkAttachmentReference& vkAttachmentReference) {
-			m_colorAttachmentReferences.push_back(vkAttachmentReference);
-			return *this;
+		DeviceMemory(DeviceMemory&& other) noexcept
+			: HandleWithOwner(std::move(other))
+			, m_size(other.m_size)
+			, m_arenaAllocation(other.m_arenaAllocation)
+			, m_pDeviceMemoryArena(other.m_pDeviceMemoryArena) {
+			other.m_pDeviceMemoryArena = nullptr;
 		}
 
-		SubpassDescription& setDepthStencilAttachmentReference(VkAttachmentReference& vkDepthStencilAttachmentReference) {
-			m_depthStencilAttachmentReference = vkDepthStencilAttachmentReference;
-			m_haveDepthStencilAttachmentReference = true;
+		DeviceMemory& operator=(DeviceMemory&& other) noexcept {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~DeviceMemory();
+			new(this) DeviceMemory(std::move(other));
 			return *this;
 		}
 
-		//static inline const std::array<uint32_t, 2> s_preserve = { 0,1 };
-
-		VkSubpassDescription* assemble() {
-
-			inputAttachmentCount = static_cast<uint32_t>(m_inputAttachmentReferences.size());
-			if (inputAttachmentCount > 0) {
-				pInputAttachments = m_inputAttachmentReferences.data();
+		DeviceMemory(const VkMemoryAllocateInfo& vkMemoryAllocateInfo, VkDevice vkDevice) {
+			VkDeviceMemory vkDeviceMemory;
+			VkResult vkResult = vkAllocateMemory(vkDevice, &vkMemoryAllocateInfo, nullptr, &vkDeviceMemory);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)DeviceMemory(vkDeviceMemory, vkDevice, vkMemoryAllocateInfo.allocationSize, &destroy);
+		}
+
+
+		DeviceMemory(
+			VkMemoryRequirements vkMemoryRequirements,
+			MemoryPropertyFlags requiredMemoryPropertyFlags,
+			Device	device
+		) {
+			VkMemoryAllocateInfo vkMemoryAllocateInfo{};
+			vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
+			vkMemoryAllocateInfo.memoryTypeIndex =
+				device.findMemoryTypeIndex(vkMemoryRequirements.memoryTypeBits, requiredMemoryPropertyFlags);
+			new(this)DeviceMemory(vkMemoryAllocateInfo, device);
+		}
+
+		DeviceMemory(
+			VkMemoryRequirements vkMemoryRequirements,
+			MemoryPropertyFlags requiredMemoryPropertyFlags,
+			DeviceMemoryArena::ResourceKind resourceKind,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			DeviceMemoryArena::Allocation allocation =
+				deviceMemoryArena.allocate(vkMemoryRequirements, requiredMemoryPropertyFlags, resourceKind);
+			new(this)DeviceMemory(allocation.m_vkDeviceMemory, deviceMemoryArena.getDevice(), allocation.m_size, nullptr);
+			m_arenaAllocation = allocation;
+			m_pDeviceMemoryArena = &deviceMemoryArena;
+		}
+
+		VkDeviceSize size() const {
+			return m_size;
+		}
+
+		//	Where resources need to be bound.  Always 0 unless sub-allocated.
+		VkDeviceSize offset() const {
+			return m_arenaAllocation.m_offset;
+		}
+
+		bool isSubAllocated() const {
+			return m_arenaAllocation.m_vkDeviceMemory != nullptr;
+		}
+
+		//	Arena blocks in host visible memory are persistently mapped.
+		void* mappedMemory() const {
+			return m_arenaAllocation.m_mappedMemory;
+		}
+
+	};
+
+
+	class Buffer : public HandleWithOwner<VkBuffer, Device> {
+
+		static void destroy(VkBuffer vkBuffer, Device device) {
+			vkDestroyBuffer(device, vkBuffer, nullptr);
+		}
+
+		Buffer(VkBuffer vkBuffer, Device device, VkDeviceSize size, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkBuffer, device, pfnDestroy)
+			, m_size(size) {
+		}
+
+		Buffer(const VkBufferCreateInfo& vkBufferCreateInfo, Device device) {
+			VkBuffer vkBuffer;
+			VkResult vkResult = vkCreateBuffer(device, &vkBufferCreateInfo, nullptr, &vkBuffer);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)Buffer(vkBuffer, device, vkBufferCreateInfo.size, &destroy);
+		}
+
+		VkDeviceSize	m_size = 0;
+
+
+	public:
+
+		Buffer() {}
+
+		Buffer(
+			VkBufferUsageFlags	vkBufferUsageFlags,
+			VkDeviceSize		size,
+			uint32_t			queueFamilyIndex,
+			Device				device
+		) {
+			VkBufferCreateInfo vkBufferCreateInfo{};
+			vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			vkBufferCreateInfo.usage = vkBufferUsageFlags;
+			vkBufferCreateInfo.size = size;
+			vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			uint32_t	queueFamilyIndexLocal = queueFamilyIndex;
+			vkBufferCreateInfo.pQueueFamilyIndices = &queueFamilyIndexLocal;
+			new(this)Buffer(vkBufferCreateInfo, device);
+
+		}
+
+		VkDeviceSize size() const {
+			return m_size;
+		}
+
+		VkMemoryRequirements  getMemoryRequirements() {
+			VkMemoryRequirements vkMemoryRequirements;
+			vkGetBufferMemoryRequirements(getVkDevice(), *this, &vkMemoryRequirements);
+			return vkMemoryRequirements;
+		}
+
+		DeviceMemory allocateDeviceMemory(MemoryPropertyFlags requiredMemoryPropertyFlags) {
+			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
+			return DeviceMemory(vkMemoryRequirements, requiredMemoryPropertyFlags, getOwner());
+		}
+
+		DeviceMemory allocateDeviceMemory(
+			MemoryPropertyFlags requiredMemoryPropertyFlags,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
+			return DeviceMemory(
+				vkMemoryRequirements,
+				requiredMemoryPropertyFlags,
+				DeviceMemoryArena::ResourceKind::LINEAR,
+				deviceMemoryArena);
+		}
+
+	};
+
+
+	class Buffer_DeviceMemory {
+
+		Buffer_DeviceMemory(Buffer&& buffer, DeviceMemory&& deviceMemory, void* mappedMemory)
+			: m_buffer(std::move(buffer))
+			, m_deviceMemory(std::move(deviceMemory))
+			, m_mappedMemory(mappedMemory) {
+		}
+
+	public:
+
+		Buffer			m_buffer;
+		DeviceMemory	m_deviceMemory;
+		void* m_mappedMemory = nullptr;
+
+		Buffer_DeviceMemory() {}
+
+		Buffer_DeviceMemory(const Buffer_DeviceMemory& other)
+			: m_buffer(other.m_buffer)
+			, m_deviceMemory(other.m_deviceMemory)
+			, m_mappedMemory(other.m_mappedMemory) {
+		}
+		Buffer_DeviceMemory& operator=(const Buffer_DeviceMemory& other) {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~Buffer_DeviceMemory();
+			new(this) Buffer_DeviceMemory(other);
+			return *this;
+		}
+
+		Buffer_DeviceMemory(Buffer_DeviceMemory&& other) noexcept
+			: m_buffer(std::move(other.m_buffer))
+			, m_deviceMemory(std::move(other.m_deviceMemory))
+			, m_mappedMemory(other.m_mappedMemory) {
+		}
+
+		Buffer_DeviceMemory& operator=(Buffer_DeviceMemory&& other) noexcept {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~Buffer_DeviceMemory();
+			new(this) Buffer_DeviceMemory(std::move(other));
+			return *this;
+		}
+
+
+
+		Buffer_DeviceMemory(
+			VkBufferUsageFlags vkBufferUsageFlags,
+			VkDeviceSize size,
+			uint32_t	queueFamilyIndex,
+			MemoryPropertyFlags memoryPropertyFlags,
+			Device device
+		) {
+			Buffer buffer(vkBufferUsageFlags, size, queueFamilyIndex, device);
+
+			DeviceMemory deviceMemory = buffer.allocateDeviceMemory(memoryPropertyFlags);
+
+			VkResult vkResult = vkBindBufferMemory(device, buffer, deviceMemory, 0);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+			// TODO: should this be a method on DeviceMemory?
+			void* mappedMemory;
+			vkResult = vkMapMemory(device, deviceMemory, 0, size, 0, &mappedMemory);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+			new(this) Buffer_DeviceMemory(std::move(buffer), std::move(deviceMemory), mappedMemory);
+
+		}
+
+		Buffer_DeviceMemory(
+			VkBufferUsageFlags vkBufferUsageFlags,
+			int64_t size,
+			uint32_t	queueFamilyIndex,
+			MemoryPropertyFlags requiredMemoryPropertyFlags,
+			void* pSrcMem,
+			Device device
+		) {
+			new(this)Buffer_DeviceMemory(
+				vkBufferUsageFlags,
+				size,
+				queueFamilyIndex,
+				requiredMemoryPropertyFlags,
+				device
+			);
+			memcpy(m_mappedMemory, pSrcMem, size);
+			//unmapMemory();
+		}
+
+		//	Same as above, but the memory is a range out of the arena.
+		//	Host visible memory is already mapped by the arena, device local
+		//	memory is left unmapped.
+		Buffer_DeviceMemory(
+			VkBufferUsageFlags vkBufferUsageFlags,
+			VkDeviceSize size,
+			uint32_t	queueFamilyIndex,
+			MemoryPropertyFlags memoryPropertyFlags,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			Device device = deviceMemoryArena.getDevice();
+			Buffer buffer(vkBufferUsageFlags, size, queueFamilyIndex, device);
+
+			DeviceMemory deviceMemory = buffer.allocateDeviceMemory(memoryPropertyFlags, deviceMemoryArena);
+
+			VkResult vkResult = vkBindBufferMemory(device, buffer, deviceMemory, deviceMemory.offset());
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+			void* mappedMemory = deviceMemory.mappedMemory();
+			new(this) Buffer_DeviceMemory(std::move(buffer), std::move(deviceMemory), mappedMemory);
+		}
+
+		Buffer_DeviceMemory(
+			VkBufferUsageFlags vkBufferUsageFlags,
+			int64_t size,
+			uint32_t	queueFamilyIndex,
+			MemoryPropertyFlags requiredMemoryPropertyFlags,
+			void* pSrcMem,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			new(this)Buffer_DeviceMemory(
+				vkBufferUsageFlags,
+				size,
+				queueFamilyIndex,
+				requiredMemoryPropertyFlags,
+				deviceMemoryArena
+			);
+			if (!m_mappedMemory) {
+				throw Exception("Buffer_DeviceMemory: source data needs host visible memory");
+			}
+			memcpy(m_mappedMemory, pSrcMem, size);
+		}
+
+
+		void unmapMemory() {
+			//	Arena blocks stay mapped until the arena goes away.
+			if (!m_deviceMemory.isSubAllocated()) {
+				vkUnmapMemory(m_deviceMemory.getVkDevice(), m_deviceMemory);
+			}
+			m_mappedMemory = nullptr;
+
+		}
+
+	};
+
+
+	//	Persistently mapped uniform buffer split into one segment per frame in flight.
+	//	Each draw pushes its own slice and binds it with a dynamic offset
+	//	(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC), so one buffer and one
+	//	descriptor set serve any number of objects.
+	//	A segment must not be restarted until the gpu is done with that frame.
+	class UniformRingBuffer {
+
+		Buffer_DeviceMemory	m_buffer_deviceMemory;
+		VkDeviceSize	m_alignment = 1;
+		VkDeviceSize	m_segmentSize = 0;
+		uint32_t		m_segmentCount = 0;
+		uint32_t		m_currentSegment = 0;
+		VkDeviceSize	m_segmentHead = 0;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+	public:
+
+		UniformRingBuffer() {}
+
+		UniformRingBuffer(const UniformRingBuffer&) = delete;
+		UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+		UniformRingBuffer(UniformRingBuffer&&) = default;
+		UniformRingBuffer& operator=(UniformRingBuffer&&) = default;
+
+		//	Each slice takes sliceSize rounded up to the offset alignment, the
+		//	same stride push advances by, so slicesPerSegment of them always fit.
+		UniformRingBuffer(
+			VkDeviceSize sliceSize,
+			uint32_t	slicesPerSegment,
+			uint32_t	segmentCount,
+			uint32_t	queueFamilyIndex,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			m_alignment = deviceMemoryArena.getDevice().getPhysicalDevice()
+				.getPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
+			if (m_alignment == 0) {
+				m_alignment = 1;
+			}
+			m_segmentSize = alignUp(sliceSize, m_alignment) * slicesPerSegment;
+			m_segmentCount = segmentCount;
+			m_buffer_deviceMemory = Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				m_segmentSize * m_segmentCount,
+				queueFamilyIndex,
+				MEMORY_PROPERTY_HOST_VISIBLE | MEMORY_PROPERTY_HOST_COHERENT,
+				deviceMemoryArena);
+		}
+
+		Buffer buffer() const {
+			return m_buffer_deviceMemory.m_buffer;
+		}
+
+		VkDeviceSize alignment() const {
+			return m_alignment;
+		}
+
+		//	Start handing out slices from the segment for this frame.
+		void beginSegment(uint32_t segmentIndex) {
+			m_currentSegment = segmentIndex % m_segmentCount;
+			m_segmentHead = 0;
+		}
+
+		//	Returns the dynamic offset to bind the slice with.
+		uint32_t push(const void* pSrcMem, VkDeviceSize size) {
+			if (m_segmentHead + size > m_segmentSize) {
+				throw Exception("UniformRingBuffer: frame segment is full");
+			}
+			const VkDeviceSize offset = m_currentSegment * m_segmentSize + m_segmentHead;
+			memcpy((char*)m_buffer_deviceMemory.m_mappedMemory + offset, pSrcMem, size);
+			m_segmentHead = alignUp(m_segmentHead + size, m_alignment);
+			return static_cast<uint32_t>(offset);
+		}
+
+		template<typename T>
+		uint32_t push(const T& data) {
+			return push(&data, sizeof(T));
+		}
+
+	};
+
+
+	class ShaderModule : public HandleWithOwner<VkShaderModule> {
+
+		static std::vector<char> readFile(const std::string& filename) {
+			std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to open file!");
+			}
+			size_t fileSize = (size_t)file.tellg();
+			std::vector<char> buffer(fileSize);
+			file.seekg(0);
+			file.read(buffer.data(), fileSize);
+			file.close();
+
+			return buffer;
+		}
+
+		static void destroy(VkShaderModule vkShaderModule, VkDevice vkDevice) {
+			vkDestroyShaderModule(vkDevice, vkShaderModule, nullptr);
+		}
+
+		ShaderModule(VkShaderModule vkShaderModule, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner<VkShaderModule>(vkShaderModule, vkDevice, pfnDestroy) {
+		}
+
+
+
+	public:
+
+		ShaderModule() {}
+
+		static ShaderModule createShaderModuleFromFile(const char* fileName, VkDevice vkDevice) {
+			auto fragShaderCode = readFile(fileName);
+			return createShaderModule(fragShaderCode.data(), fragShaderCode.size(), vkDevice);
+		}
+
+		//	The code must be 4 byte aligned, e.g. a mapped file.
+		static ShaderModule createShaderModule(const void* pCode, size_t codeSize, VkDevice vkDevice) {
+			VkShaderModuleCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			createInfo.codeSize = codeSize;
+			createInfo.pCode = static_cast<const uint32_t*>(pCode);
+			VkShaderModule vkShaderModule;
+			VkResult vkResult = vkCreateShaderModule(vkDevice, &createInfo, nullptr, &vkShaderModule);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			return ShaderModule(vkShaderModule, vkDevice, &destroy);
+		}
+
+	};
+
+
+	class AttachmentDescription : public VkAttachmentDescription {
+
+	public:
+
+		AttachmentDescription()
+			: VkAttachmentDescription{} {
+		}
+
+		static AttachmentDescription simpleColorAttachmentPresentDescription(
+			VkFormat	colorAttachmentVkFormat
+		) {
+			AttachmentDescription	colorAttachmentDescription;
+			//	Reasonable defaults
+			colorAttachmentDescription.format = colorAttachmentVkFormat;
+			colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			return colorAttachmentDescription;
+		}
+
+		static AttachmentDescription simpleColorAttachmentDescription(
+			VkFormat	colorAttachmentVkFormat
+		) {
+			AttachmentDescription	colorAttachmentDescription;
+			//	Reasonable defaults
+			colorAttachmentDescription.format = colorAttachmentVkFormat;
+			colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			return colorAttachmentDescription;
+		}
+
+
+		static AttachmentDescription simpleDepthAttachmentDescription() {
+			AttachmentDescription depthAttachmentDescription;
+			//	Reasonable defaults
+			depthAttachmentDescription.format = VK_FORMAT_D32_SFLOAT;
+			depthAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			depthAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			depthAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			depthAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			return depthAttachmentDescription;
+		}
+
+
+	};
+	static_assert(sizeof(AttachmentDescription) == sizeof(VkAttachmentDescription));
+
+
+
+	class SubpassDescription : public VkSubpassDescription {
+
+		std::vector<VkAttachmentReference>	m_inputAttachmentReferences;
+		std::vector<VkAttachmentReference>	m_colorAttachmentReferences;
+		VkAttachmentReference				m_depthStencilAttachmentReference{};
+		bool								m_haveDepthStencilAttachmentReference{};
+
+
+	public:
+
+		VkSubpassDescription* operator&() = delete;
+
+		SubpassDescription()
+			: VkSubpassDescription{} {
+		}
+
+		SubpassDescription& setPipelineBindPoint(VkPipelineBindPoint vkPipelineBindPoint) {
+			pipelineBindPoint = vkPipelineBindPoint;
+			return *this;
+		}
+
+		SubpassDescription& addInputAttachmentReference(VkAttachmentReference& vkAttachmentReference) {
+			m_inputAttachmentReferences.push_back(vkAttachmentReference);
+			return *this;
+		}
+
+		SubpassDescription& addColorAttachmentReference(VkAttachmentReference& vkAttachmentReference) {
+			m_colorAttachmentReferences.push_back(vkAttachmentReference);
+			return *this;
+		}
+
+		SubpassDescription& setDepthStencilAttachmentReference(VkAttachmentReference& vkDepthStencilAttachmentReference) {
+			m_depthStencilAttachmentReference = vkDepthStencilAttachmentReference;
+			m_haveDepthStencilAttachmentReference = true;
+			return *this;
+		}
+
+		//static inline const std::array<uint32_t, 2> s_preserve = { 0,1 };
+
+		VkSubpassDescription* assemble() {
+
+			inputAttachmentCount = static_cast<uint32_t>(m_inputAttachmentReferences.size());
+			if (inputAttachmentCount > 0) {
+				pInputAttachments = m_inputAttachmentReferences.data();
 			}
 
 			colorAttachmentCount = static_cast<uint32_t>(m_colorAttachmentReferences.size());
@@ -1532,922 +2830,3245 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 				pColorAttachments = m_colorAttachmentReferences.data();
 			}
 
-			if (m_haveDepthStencilAttachmentReference) {
-				pDepthStencilAttachment = &m_depthStencilAttachmentReference;
+			if (m_haveDepthStencilAttachmentReference) {
+				pDepthStencilAttachment = &m_depthStencilAttachmentReference;
+			}
+
+
+
+			//	TODO:	need to figure out which attachments to preserve.
+			//preserveAttachmentCount = 2;
+			//pPreserveAttachments = s_preserve.data();
+
+
+			return this;
+		}
+
+	};
+
+
+	class SubpassDependency : public VkSubpassDependency {
+
+	public:
+
+		SubpassDependency()
+			: VkSubpassDependency{} {
+		}
+
+
+		SubpassDependency& setDependency(
+			uint32_t	srcSubpassArg,
+			uint32_t	dstSubpassArg
+		) {
+			srcSubpass = srcSubpassArg;
+			dstSubpass = dstSubpassArg;
+			return *this;
+		}
+
+		SubpassDependency& setSrc(
+			VkPipelineStageFlags    srcStageMaskArg,
+			VkAccessFlags           srcAccessMaskArg
+		) {
+			srcStageMask = srcStageMaskArg;
+			srcAccessMask = srcAccessMaskArg;
+			return *this;
+		}
+
+		SubpassDependency& addSrc(
+			VkPipelineStageFlags    srcStageMaskArg,
+			VkAccessFlags           srcAccessMaskArg
+		) {
+			srcStageMask |= srcStageMaskArg;
+			srcAccessMask |= srcAccessMaskArg;
+			return *this;
+		}
+
+
+		SubpassDependency& setDst(
+			VkPipelineStageFlags    dstStageMaskArg,
+			VkAccessFlags           dstAccessMaskArg
+		) {
+			dstStageMask = dstStageMaskArg;
+			dstAccessMask = dstAccessMaskArg;
+			return *this;
+		}
+
+		SubpassDependency& addDst(
+			VkPipelineStageFlags    dstStageMaskArg,
+			VkAccessFlags           dstAccessMaskArg
+		) {
+			dstStageMask |= dstStageMaskArg;
+			dstAccessMask |= dstAccessMaskArg;
+			return *this;
+		}
+
+	};
+	static_assert(sizeof(SubpassDependency) == sizeof(VkSubpassDependency));
+
+
+	class RenderPassCreateInfo : public VkRenderPassCreateInfo {
+
+		std::vector<VkAttachmentDescription>	m_attachmentDescriptions;
+
+		std::vector<SubpassDescription> m_subpassDescriptions;
+		std::vector<VkSubpassDescription>	m_vkSubpassDescriptions;
+
+		std::vector<SubpassDependency> m_subpassDependencies;
+		std::vector<VkSubpassDependency> m_vkSubpassDependencies;
+
+	public:
+
+		RenderPassCreateInfo()
+			: VkRenderPassCreateInfo{} {
+		}
+
+		VkRenderPassCreateInfo* operator&() = delete;
+
+		VkAttachmentReference addAttachment(
+			const AttachmentDescription& attachmentDescription,
+			VkImageLayout	imageLayout
+		) {
+			m_attachmentDescriptions.emplace_back(attachmentDescription);
+			//	"attachment" really means "attachment index in the array of attachments"
+			VkAttachmentReference attachmentReference{};
+			attachmentReference.attachment = static_cast<uint32_t>(m_attachmentDescriptions.size() - 1);
+			attachmentReference.layout = imageLayout;
+			return attachmentReference;
+		}
+
+		SubpassDescription& addSubpass() {
+			SubpassDescription& subpassDescription = m_subpassDescriptions.emplace_back();
+			subpassDescription.setPipelineBindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS);
+			return subpassDescription;
+		}
+
+		SubpassDependency& addSubpassDependency(
+			uint32_t	srcSubpass,
+			uint32_t	dstSubpass
+		) {
+			SubpassDependency& subpassDependency = m_subpassDependencies.emplace_back();
+			subpassDependency.setDependency(srcSubpass, dstSubpass);
+			return subpassDependency;
+		}
+
+
+		VkRenderPassCreateInfo* assemble() {
+
+			//	TODO: where do these magic layout transitions happen?
+
+			sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+
+			pAttachments = nullptr;
+			attachmentCount = static_cast<uint32_t>(m_attachmentDescriptions.size());
+			if (attachmentCount > 0) {
+				pAttachments = m_attachmentDescriptions.data();
+			}
+
+			pSubpasses = nullptr;
+			m_vkSubpassDescriptions.clear();
+			subpassCount = static_cast<uint32_t>(m_subpassDescriptions.size());
+			if (subpassCount > 0) {
+				for (SubpassDescription& subpassDescription : m_subpassDescriptions) {
+					//	TODO: investigate.  This is either really clever or really risky.
+					//	We assemble the the subpass description and then push back
+					//	a copy of the VkSubpassDescription part of our structure.
+					m_vkSubpassDescriptions.push_back(*subpassDescription.assemble());
+				}
+				pSubpasses = m_vkSubpassDescriptions.data();
+			}
+
+			pDependencies = nullptr;
+			m_vkSubpassDependencies.clear();
+			dependencyCount = static_cast<uint32_t>(m_subpassDependencies.size());
+			if (dependencyCount > 0) {
+				for (SubpassDependency& subpassDependency : m_subpassDependencies) {
+					m_vkSubpassDependencies.push_back(subpassDependency);
+				}
+				pDependencies = m_vkSubpassDependencies.data();
+			}
+
+			return this;
+
+		}
+
+
+	};
+
+
+	class SubpassDescription2 : public VkSubpassDescription2 {
+
+		std::vector<VkAttachmentReference2>	m_colorAttachmentReferences;
+		VkAttachmentReference2				m_depthStencilAttachmentReference{};
+		bool								m_haveDepthStencilAttachmentReference{};
+
+	public:
+
+		VkSubpassDescription2* operator&() = delete;
+
+		SubpassDescription2()
+			: VkSubpassDescription2{} {
+			sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2;
+			pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		}
+
+		SubpassDescription2& addColorAttachmentReference(const VkAttachmentReference2& vkAttachmentReference) {
+			m_colorAttachmentReferences.push_back(vkAttachmentReference);
+			return *this;
+		}
+
+		SubpassDescription2& setDepthStencilAttachmentReference(const VkAttachmentReference2& vkDepthStencilAttachmentReference) {
+			m_depthStencilAttachmentReference = vkDepthStencilAttachmentReference;
+			m_haveDepthStencilAttachmentReference = true;
+			return *this;
+		}
+
+		VkSubpassDescription2* assemble() {
+			colorAttachmentCount = static_cast<uint32_t>(m_colorAttachmentReferences.size());
+			pColorAttachments = colorAttachmentCount > 0 ? m_colorAttachmentReferences.data() : nullptr;
+			pDepthStencilAttachment = m_haveDepthStencilAttachmentReference ? &m_depthStencilAttachmentReference : nullptr;
+			return this;
+		}
+
+	};
+
+
+	//	The stages and accesses go in a chained VkMemoryBarrier2, which
+	//	takes the place of the synchronization1 masks.
+	class SubpassDependency2 : public VkSubpassDependency2 {
+
+		VkMemoryBarrier2	m_memoryBarrier{};
+
+	public:
+
+		VkSubpassDependency2* operator&() = delete;
+
+		SubpassDependency2(uint32_t srcSubpassArg, uint32_t dstSubpassArg)
+			: VkSubpassDependency2{} {
+			sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
+			srcSubpass = srcSubpassArg;
+			dstSubpass = dstSubpassArg;
+			m_memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		}
+
+		SubpassDependency2& addSrc(VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask) {
+			m_memoryBarrier.srcStageMask |= srcStageMask;
+			m_memoryBarrier.srcAccessMask |= srcAccessMask;
+			return *this;
+		}
+
+		SubpassDependency2& addDst(VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask) {
+			m_memoryBarrier.dstStageMask |= dstStageMask;
+			m_memoryBarrier.dstAccessMask |= dstAccessMask;
+			return *this;
+		}
+
+		SubpassDependency2& setDependencyFlags(VkDependencyFlags vkDependencyFlags) {
+			dependencyFlags = vkDependencyFlags;
+			return *this;
+		}
+
+		VkSubpassDependency2* assemble() {
+			pNext = &m_memoryBarrier;
+			return this;
+		}
+
+	};
+
+
+	class RenderPassCreateInfo2 : public VkRenderPassCreateInfo2 {
+
+		std::vector<VkAttachmentDescription2>	m_attachmentDescriptions;
+
+		std::vector<SubpassDescription2>	m_subpassDescriptions;
+		std::vector<VkSubpassDescription2>	m_vkSubpassDescriptions;
+
+		std::vector<SubpassDependency2>		m_subpassDependencies;
+		std::vector<VkSubpassDependency2>	m_vkSubpassDependencies;
+
+	public:
+
+		RenderPassCreateInfo2()
+			: VkRenderPassCreateInfo2{} {
+		}
+
+		VkRenderPassCreateInfo2* operator&() = delete;
+
+		//	The description's sType is filled in here.
+		VkAttachmentReference2 addAttachment(
+			VkAttachmentDescription2	vkAttachmentDescription,
+			VkImageLayout				imageLayout,
+			VkImageAspectFlags			aspectMask
+		) {
+			vkAttachmentDescription.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+			m_attachmentDescriptions.push_back(vkAttachmentDescription);
+			VkAttachmentReference2 attachmentReference{};
+			attachmentReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+			attachmentReference.attachment = static_cast<uint32_t>(m_attachmentDescriptions.size() - 1);
+			attachmentReference.layout = imageLayout;
+			attachmentReference.aspectMask = aspectMask;
+			return attachmentReference;
+		}
+
+		SubpassDescription2& addSubpass() {
+			return m_subpassDescriptions.emplace_back();
+		}
+
+		SubpassDependency2& addSubpassDependency(uint32_t srcSubpass, uint32_t dstSubpass) {
+			return m_subpassDependencies.emplace_back(srcSubpass, dstSubpass);
+		}
+
+		VkRenderPassCreateInfo2* assemble() {
+
+			sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
+
+			attachmentCount = static_cast<uint32_t>(m_attachmentDescriptions.size());
+			pAttachments = attachmentCount > 0 ? m_attachmentDescriptions.data() : nullptr;
+
+			m_vkSubpassDescriptions.clear();
+			for (SubpassDescription2& subpassDescription : m_subpassDescriptions) {
+				m_vkSubpassDescriptions.push_back(*subpassDescription.assemble());
+			}
+			subpassCount = static_cast<uint32_t>(m_vkSubpassDescriptions.size());
+			pSubpasses = subpassCount > 0 ? m_vkSubpassDescriptions.data() : nullptr;
+
+			//	The copies still point at the barriers in m_subpassDependencies.
+			m_vkSubpassDependencies.clear();
+			for (SubpassDependency2& subpassDependency : m_subpassDependencies) {
+				m_vkSubpassDependencies.push_back(*subpassDependency.assemble());
+			}
+			dependencyCount = static_cast<uint32_t>(m_vkSubpassDependencies.size());
+			pDependencies = dependencyCount > 0 ? m_vkSubpassDependencies.data() : nullptr;
+
+			return this;
+		}
+
+	};
+
+
+	class RenderPass : public HandleWithOwner<VkRenderPass> {
+
+		RenderPass(VkRenderPass vkRenderPass, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkRenderPass, vkDevice, pfnDestroy) {
+		}
+
+		static void destroy(VkRenderPass vkRenderPass, VkDevice vkDevice) {
+			vkDestroyRenderPass(vkDevice, vkRenderPass, nullptr);
+		}
+
+	public:
+
+		RenderPass() {}
+		RenderPass(RenderPassCreateInfo& renderPassCreateInfo, VkDevice vkDevice) {
+			VkRenderPass	vkRenderPass;
+			VkResult vkResult = vkCreateRenderPass(vkDevice, renderPassCreateInfo.assemble(), nullptr, &vkRenderPass);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)RenderPass(vkRenderPass, vkDevice, &destroy);
+		}
+
+		RenderPass(RenderPassCreateInfo2& renderPassCreateInfo2, VkDevice vkDevice) {
+			VkRenderPass	vkRenderPass;
+			VkResult vkResult = vkCreateRenderPass2(vkDevice, renderPassCreateInfo2.assemble(), nullptr, &vkRenderPass);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)RenderPass(vkRenderPass, vkDevice, &destroy);
+		}
+
+	};
+
+	class ImageCreateInfo : public VkImageCreateInfo {
+
+	public:
+
+		ImageCreateInfo(
+			VkFormat vkFormat,
+			VkImageUsageFlags vkUsage)
+			: VkImageCreateInfo{} {
+			sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			format = vkFormat;
+			usage = vkUsage;
+
+			imageType = VK_IMAGE_TYPE_2D;
+
+			extent.depth = 1;
+			mipLevels = 1;
+			arrayLayers = 1;
+			initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			samples = VK_SAMPLE_COUNT_1_BIT;
+			sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		}
+
+		ImageCreateInfo& setExtent(VkExtent2D  vkExtent2D) {
+			extent.width = vkExtent2D.width;
+			extent.height = vkExtent2D.height;
+			return *this;
+		}
+
+		ImageCreateInfo& setMipLevels(uint32_t mipLevelsArg) {
+			mipLevels = mipLevelsArg;
+			return *this;
+		}
+
+		//	Levels in a full chain down to 1x1.
+		static uint32_t fullMipLevelCount(VkExtent2D vkExtent2D) {
+			uint32_t largest = std::max(vkExtent2D.width, vkExtent2D.height);
+			uint32_t levelCount = 1;
+			while (largest > 1) {
+				largest >>= 1;
+				levelCount++;
+			}
+			return levelCount;
+		}
+
+	};
+
+	//	What an image is about to be used for, the dst half of its barrier.
+	enum class ImageUsage {
+		TRANSFER_SRC,		//	Copied from.
+		TRANSFER_DST,		//	Copied into.
+		BLIT_SRC,
+		BLIT_DST,
+		SAMPLED_FRAGMENT,	//	Sampled by fragment shaders.
+		SAMPLED_COMPUTE,
+		STORAGE_COMPUTE,	//	Read and written by compute shaders.
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		PRESENT,
+	};
+
+	//	The same for buffers, which have no layout.
+	enum class BufferUsage {
+		TRANSFER_SRC,
+		TRANSFER_DST,		//	Copied into or filled.
+		STORAGE_COMPUTE,	//	Read and written by compute shaders.
+		INDIRECT,			//	Draw or dispatch parameters.
+		VERTEX_INPUT,		//	Vertices and indices.
+	};
+
+
+	//	The narrowest stages, accesses and layout that cover a usage.
+	struct ImageUsageScope {
+
+		VkPipelineStageFlags2	m_stages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2			m_access = VK_ACCESS_2_NONE;
+		VkImageLayout			m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		static ImageUsageScope of(ImageUsage imageUsage) {
+			switch (imageUsage) {
+			case ImageUsage::TRANSFER_SRC:
+				return { VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+			case ImageUsage::TRANSFER_DST:
+				return { VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+			case ImageUsage::BLIT_SRC:
+				return { VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+			case ImageUsage::BLIT_DST:
+				return { VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+			case ImageUsage::SAMPLED_FRAGMENT:
+				return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			case ImageUsage::SAMPLED_COMPUTE:
+				return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			case ImageUsage::STORAGE_COMPUTE:
+				return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+			case ImageUsage::COLOR_ATTACHMENT:
+				return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+			case ImageUsage::DEPTH_ATTACHMENT:
+				return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			case ImageUsage::PRESENT:
+				//	The present waits on a semaphore, not on a stage.
+				return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+			}
+			throw Exception("ImageUsageScope: unknown usage");
+		}
+
+		//	The layout is left UNDEFINED.
+		static ImageUsageScope of(BufferUsage bufferUsage) {
+			switch (bufferUsage) {
+			case BufferUsage::TRANSFER_SRC:
+				return { VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+			case BufferUsage::TRANSFER_DST:
+				return { VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+			case BufferUsage::STORAGE_COMPUTE:
+				return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+			case BufferUsage::INDIRECT:
+				return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT };
+			case BufferUsage::VERTEX_INPUT:
+				return { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT };
+			}
+			throw Exception("ImageUsageScope: unknown usage");
+		}
+
+		VkAccessFlags2 writeAccess() const {
+			return m_access & (VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+				| VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+		}
+
+	};
+
+
+	//	What each subresource of an image was last used for, so a barrier
+	//	only waits on what really touched it and is left out when nothing
+	//	did.  Follows the order command buffers are recorded in, which has
+	//	to be the order they run in.  Only sees transitions made through
+	//	DependencyInfo::addImageTransition; render passes and hand made
+	//	barriers leave it behind.  Not thread safe, an image's transitions
+	//	are recorded on one thread at a time.
+	class ImageState {
+
+	public:
+
+		struct Subresource {
+			VkImageLayout	m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			//	The last write, or the barrier that changed the layout.
+			VkPipelineStageFlags2	m_writeStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2			m_writeAccess = VK_ACCESS_2_NONE;
+			VkPipelineStageFlags2	m_readStages = VK_PIPELINE_STAGE_2_NONE;	//	Since then.
+			//	What a barrier already ordered after it and made it visible to.
+			VkPipelineStageFlags2	m_visibleStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2			m_visibleAccess = VK_ACCESS_2_NONE;
+		};
+
+		//	The src half of a barrier, the dst half comes from the usage.
+		struct Barrier {
+			VkImageLayout			m_oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags2	m_srcStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2			m_srcAccess = VK_ACCESS_2_NONE;
+
+			bool operator==(const Barrier&) const = default;
+		};
+
+	private:
+
+		uint32_t	m_mipLevels = 1;
+		uint32_t	m_arrayLayers = 1;
+		VkImageAspectFlags	m_aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		std::vector<Subresource>	m_subresources;		//	[layer][level]
+
+	public:
+
+		//	A single subresource, e.g. to follow a buffer with, whose layout
+		//	never changes.
+		ImageState()
+			: m_subresources(1) {
+		}
+
+		explicit ImageState(const VkImageCreateInfo& vkImageCreateInfo)
+			: m_mipLevels(vkImageCreateInfo.mipLevels)
+			, m_arrayLayers(vkImageCreateInfo.arrayLayers)
+			, m_aspectMask(aspectMask(vkImageCreateInfo.format))
+			, m_subresources(m_mipLevels * m_arrayLayers) {
+		}
+
+		static VkImageAspectFlags aspectMask(VkFormat vkFormat) {
+			switch (vkFormat) {
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_S8_UINT:
+				return VK_IMAGE_ASPECT_STENCIL_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+
+		uint32_t mipLevels() const {
+			return m_mipLevels;
+		}
+
+		uint32_t arrayLayers() const {
+			return m_arrayLayers;
+		}
+
+		VkImageAspectFlags aspectMask() const {
+			return m_aspectMask;
+		}
+
+		const Subresource& subresource(uint32_t mipLevel, uint32_t arrayLayer) const {
+			return m_subresources.at(arrayLayer * m_mipLevels + mipLevel);
+		}
+
+		//	Starts the subresource off as if a barrier had just made it usable
+		//	as usageScope, for whatever was synchronized some other way first,
+		//	e.g. by a semaphore wait.
+		void assume(uint32_t mipLevel, uint32_t arrayLayer, const ImageUsageScope& usageScope) {
+			Subresource& subresource = m_subresources.at(arrayLayer * m_mipLevels + mipLevel);
+			subresource.m_layout = usageScope.m_layout;
+			subresource.m_writeStages = usageScope.m_stages;
+			subresource.m_writeAccess = usageScope.writeAccess();
+			subresource.m_readStages = VK_PIPELINE_STAGE_2_NONE;
+			subresource.m_visibleStages = usageScope.m_stages;
+			subresource.m_visibleAccess = usageScope.m_access;
+		}
+
+		//	Records the subresource being used as usageScope and returns the
+		//	barrier it needs first, if any.  Reads after reads need none, nor
+		//	does anything a barrier already ordered after the last write.
+		//	discardContents lets a layout change start from UNDEFINED.
+		//	A queue family ownership transfer always needs one.
+		std::optional<Barrier> use(
+			uint32_t	mipLevel,
+			uint32_t	arrayLayer,
+			const ImageUsageScope&	usageScope,
+			bool		discardContents = false,
+			bool		ownershipTransfer = false
+		) {
+			Subresource& subresource = m_subresources.at(arrayLayer * m_mipLevels + mipLevel);
+			const VkAccessFlags2 writeAccess = usageScope.writeAccess();
+			const bool layoutChange = subresource.m_layout != usageScope.m_layout;
+			const bool visible = (usageScope.m_stages & ~subresource.m_visibleStages) == 0
+				&& (usageScope.m_access & ~subresource.m_visibleAccess) == 0;
+			const bool untouched = subresource.m_writeStages == VK_PIPELINE_STAGE_2_NONE
+				&& subresource.m_readStages == VK_PIPELINE_STAGE_2_NONE;
+
+			bool needed = ownershipTransfer || layoutChange;
+			if (!needed && !untouched) {
+				//	A write has to come after every earlier read and write, but
+				//	behind a barrier that only changed the layout it already is.
+				needed = !visible
+					|| (writeAccess != VK_ACCESS_2_NONE
+						&& (subresource.m_writeAccess != VK_ACCESS_2_NONE || subresource.m_readStages != VK_PIPELINE_STAGE_2_NONE));
+			}
+
+			std::optional<Barrier> barrier;
+			if (needed) {
+				barrier = Barrier{
+					discardContents && layoutChange ? VK_IMAGE_LAYOUT_UNDEFINED : subresource.m_layout,
+					subresource.m_writeStages | subresource.m_readStages,
+					subresource.m_writeAccess };
+			}
+
+			subresource.m_layout = usageScope.m_layout;
+			if (writeAccess != VK_ACCESS_2_NONE) {
+				subresource.m_writeStages = usageScope.m_stages;
+				subresource.m_writeAccess = writeAccess;
+				subresource.m_readStages = VK_PIPELINE_STAGE_2_NONE;
+				subresource.m_visibleStages = VK_PIPELINE_STAGE_2_NONE;
+				subresource.m_visibleAccess = VK_ACCESS_2_NONE;
+			}
+			else if (needed && (layoutChange || ownershipTransfer)) {
+				subresource.m_writeStages = usageScope.m_stages;
+				subresource.m_writeAccess = VK_ACCESS_2_NONE;
+				subresource.m_readStages = usageScope.m_stages;
+				subresource.m_visibleStages = usageScope.m_stages;
+				subresource.m_visibleAccess = usageScope.m_access;
+			}
+			else {
+				subresource.m_readStages |= usageScope.m_stages;
+				if (needed) {
+					subresource.m_visibleStages |= usageScope.m_stages;
+					subresource.m_visibleAccess |= usageScope.m_access;
+				}
+			}
+			return barrier;
+		}
+
+	};
+
+
+	class Image : public HandleWithOwner<VkImage, Device> {
+
+		//	Shared by every copy.  None for images not created here.
+		std::shared_ptr<ImageState>	m_pState;
+
+		Image(VkImage vkImage, Device device, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkImage, device, pfnDestroy) {
+		}
+
+		static void destroy(VkImage vkImage, Device device) {
+			vkDestroyImage(device, vkImage, nullptr);
+		}
+
+	public:
+		Image() {}
+
+		Image(const ImageCreateInfo& imageCreateInfo, Device device) {
+			VkImage vkImage;
+			VkResult vkResult = vkCreateImage(device, &imageCreateInfo, nullptr, &vkImage);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this) Image(vkImage, device, &destroy);
+			m_pState = std::make_shared<ImageState>(imageCreateInfo);
+		}
+
+		ImageState* state() const {
+			return m_pState.get();
+		}
+
+		//static Image fromExisting(VkImage vkImage, Device device) {
+		//	return Image(vkImage, device, nullptr);
+		//}
+
+		//static std::vector<Image> fromExisting(std::vector<VkImage>& vkImages, Device device) {
+		//	std::vector<Image> images;
+		//	for (VkImage vkImage : vkImages) {
+		//		images.push_back(fromExisting(vkImage, device));
+		//	}
+		//	return images;
+		//}
+
+		VkMemoryRequirements  getMemoryRequirements() {
+			VkMemoryRequirements vkMemoryRequirements;
+			vkGetImageMemoryRequirements(getVkDevice(), *this, &vkMemoryRequirements);
+			return vkMemoryRequirements;
+		}
+
+		DeviceMemory allocateDeviceMemory(MemoryPropertyFlags requiredProperties) {
+			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
+			VkMemoryAllocateInfo vkMemoryAllocateInfo{};
+			vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
+			vkMemoryAllocateInfo.memoryTypeIndex =
+				getOwner().findMemoryTypeIndex(vkMemoryRequirements.memoryTypeBits, requiredProperties);
+			return vkcpp::DeviceMemory(vkMemoryAllocateInfo, getOwner());
+		}
+
+		//	Images are treated as optimal tiling, which is what ImageCreateInfo gives.
+		DeviceMemory allocateDeviceMemory(
+			MemoryPropertyFlags requiredProperties,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
+			return DeviceMemory(
+				vkMemoryRequirements,
+				requiredProperties,
+				DeviceMemoryArena::ResourceKind::OPTIMAL,
+				deviceMemoryArena);
+		}
+
+	};
+
+
+	class ImageViewCreateInfo : public VkImageViewCreateInfo {
+
+	public:
+		ImageViewCreateInfo(
+			VkImage			vkImage,
+			VkImageViewType vkImageViewType,
+			VkFormat	vkFormat,
+			VkImageAspectFlags aspectFlags)
+			: VkImageViewCreateInfo{} {
+			sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			image = vkImage;
+			viewType = vkImageViewType;
+			format = vkFormat;
+			subresourceRange.aspectMask = aspectFlags;
+			components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+			components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+			components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+			components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = 1;
+			subresourceRange.baseArrayLayer = 0;
+			subresourceRange.layerCount = 1;
+		}
+
+		ImageViewCreateInfo& setMipLevels(uint32_t levelCount) {
+			subresourceRange.levelCount = levelCount;
+			return *this;
+		}
+
+	};
+
+	class ImageView : public HandleWithOwner<VkImageView> {
+
+		ImageView(VkImageView vkImageView, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkImageView, vkDevice, pfnDestroy) {
+
+		}
+
+		static void destroy(VkImageView vkImageView, VkDevice vkDevice) {
+			vkDestroyImageView(vkDevice, vkImageView, nullptr);
+		}
+
+	public:
+
+		//	TODO: need to start remembering some info about the image and how the
+		//	imageview was created to make things easier to use later.
+		ImageView() {}
+
+		ImageView(const VkImageViewCreateInfo& vkImageViewCreateInfo, VkDevice vkDevice) {
+			VkImageView vkImageView;
+			VkResult vkResult = vkCreateImageView(vkDevice, &vkImageViewCreateInfo, nullptr, &vkImageView);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this) ImageView(vkImageView, vkDevice, &destroy);
+		}
+
+
+	};
+
+	class MemoryBarrier2 : public VkMemoryBarrier2 {
+
+	public:
+		MemoryBarrier2(
+			VkPipelineStageFlags2    srcStageMaskArg,
+			VkAccessFlags2           srcAccessMaskArg,
+			VkPipelineStageFlags2    dstStageMaskArg,
+			VkAccessFlags2           dstAccessMaskArg
+		)
+			: VkMemoryBarrier2{} {
+			sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+
+			srcStageMask = srcStageMaskArg;
+			srcAccessMask = srcAccessMaskArg;
+			dstStageMask = dstStageMaskArg;
+			dstAccessMask = dstAccessMaskArg;
+		}
+
+
+	};
+
+
+	class SamplerCreateInfo : public VkSamplerCreateInfo {
+
+	public:
+
+		SamplerCreateInfo()
+			: VkSamplerCreateInfo{}
+		{
+			sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			magFilter = VK_FILTER_LINEAR;
+			minFilter = VK_FILTER_LINEAR;
+			mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			anisotropyEnable = VK_FALSE;
+			maxAnisotropy = 1.0f;
+			borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+			unnormalizedCoordinates = VK_FALSE;
+			compareEnable = VK_FALSE;
+			compareOp = VK_COMPARE_OP_ALWAYS;
+			//	Let the lod pick whatever levels the view has.
+			minLod = 0.0f;
+			maxLod = VK_LOD_CLAMP_NONE;
+		}
+	};
+
+	class Sampler : public HandleWithOwner<VkSampler, Device> {
+
+		Sampler(VkSampler sampler, Device device, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(sampler, device, pfnDestroy) {
+		}
+
+		static void destroy(VkSampler sampler, Device device) {
+			vkDestroySampler(device, sampler, nullptr);
+		}
+
+	public:
+
+		Sampler() {}
+
+		Sampler(const SamplerCreateInfo& samplerCreateInfo, Device device) {
+			VkSampler vkSampler;
+			VkResult vkResult = vkCreateSampler(device, &samplerCreateInfo, nullptr, &vkSampler);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this) Sampler(vkSampler, device, &destroy);
+		}
+
+
+	};
+
+
+	class ImageMemoryBarrier2 : public VkImageMemoryBarrier2 {
+
+	public:
+		ImageMemoryBarrier2(VkImageLayout oldLayoutArg, VkImageLayout newLayoutArg, VkImage vkImage)
+			:VkImageMemoryBarrier2{} {
+			sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+
+			oldLayout = oldLayoutArg;
+			newLayout = newLayoutArg;
+			srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image = vkImage;
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = 1;
+			subresourceRange.baseArrayLayer = 0;
+			subresourceRange.layerCount = 1;
+
+			//	The stage and access masks are left to the caller.
+			//	DependencyInfo::addImageTransition fills them in from the image's state.
+
+		}
+
+		//	Set both to make this a queue family ownership release or acquire.
+		//	The same barrier is recorded on both queues: the release with no
+		//	dst stage/access, the acquire with no src stage/access.
+		ImageMemoryBarrier2& setQueueFamilies(uint32_t srcQueueFamilyIndexArg, uint32_t dstQueueFamilyIndexArg) {
+			srcQueueFamilyIndex = srcQueueFamilyIndexArg;
+			dstQueueFamilyIndex = dstQueueFamilyIndexArg;
+			return *this;
+		}
+
+		ImageMemoryBarrier2& setMipLevels(uint32_t baseMipLevel, uint32_t levelCount) {
+			subresourceRange.baseMipLevel = baseMipLevel;
+			subresourceRange.levelCount = levelCount;
+			return *this;
+		}
+
+		ImageMemoryBarrier2& setArrayLayers(uint32_t baseArrayLayer, uint32_t layerCount) {
+			subresourceRange.baseArrayLayer = baseArrayLayer;
+			subresourceRange.layerCount = layerCount;
+			return *this;
+		}
+
+		ImageMemoryBarrier2& setAspectMask(VkImageAspectFlags aspectMask) {
+			subresourceRange.aspectMask = aspectMask;
+			return *this;
+		}
+
+	};
+
+
+	static_assert(sizeof(ImageMemoryBarrier2) == sizeof(VkImageMemoryBarrier2));
+
+
+	class BufferMemoryBarrier2 : public VkBufferMemoryBarrier2 {
+
+	public:
+		BufferMemoryBarrier2(
+			VkBuffer				vkBuffer,
+			VkPipelineStageFlags2	srcStageMaskArg,
+			VkAccessFlags2			srcAccessMaskArg,
+			VkPipelineStageFlags2	dstStageMaskArg,
+			VkAccessFlags2			dstAccessMaskArg
+		)
+			: VkBufferMemoryBarrier2{} {
+			sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+
+			srcStageMask = srcStageMaskArg;
+			srcAccessMask = srcAccessMaskArg;
+			dstStageMask = dstStageMaskArg;
+			dstAccessMask = dstAccessMaskArg;
+			srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			buffer = vkBuffer;
+			offset = 0;
+			size = VK_WHOLE_SIZE;
+		}
+
+		BufferMemoryBarrier2& setQueueFamilies(uint32_t srcQueueFamilyIndexArg, uint32_t dstQueueFamilyIndexArg) {
+			srcQueueFamilyIndex = srcQueueFamilyIndexArg;
+			dstQueueFamilyIndex = dstQueueFamilyIndexArg;
+			return *this;
+		}
+
+	};
+
+
+	static_assert(sizeof(BufferMemoryBarrier2) == sizeof(VkBufferMemoryBarrier2));
+
+
+	class DependencyInfo : public VkDependencyInfo {
+
+		//	TODO: need to add the other dependency types.
+		InlineVector<VkMemoryBarrier2, 4>		m_memoryBarriers;
+		InlineVector<VkBufferMemoryBarrier2, 8>	m_bufferMemoryBarriers;
+		InlineVector<VkImageMemoryBarrier2, 8>	m_imageMemoryBarriers;
+
+		//	One barrier per run of levels in a layer that need the same one.
+		//	With pAcquire it is an ownership transfer: the release half goes
+		//	here, the acquire half there.
+		uint32_t addImageBarriers(
+			Image		image,
+			ImageUsage	imageUsage,
+			uint32_t	baseMipLevel,
+			uint32_t	levelCount,
+			bool		discardContents,
+			DependencyInfo*	pAcquire,
+			uint32_t	srcQueueFamilyIndex,
+			uint32_t	dstQueueFamilyIndex
+		) {
+			ImageState* pState = image.state();
+			if (!pState) {
+				throw Exception("DependencyInfo: the image has no state to transition from");
+			}
+			if (levelCount == VK_REMAINING_MIP_LEVELS) {
+				levelCount = pState->mipLevels() - baseMipLevel;
+			}
+			const ImageUsageScope usageScope = ImageUsageScope::of(imageUsage);
+
+			uint32_t barrierCount = 0;
+			for (uint32_t layer = 0; layer < pState->arrayLayers(); layer++) {
+				std::optional<ImageState::Barrier> run;
+				uint32_t runBaseLevel = 0;
+				auto endRun = [&](uint32_t endLevel) {
+					if (!run) {
+						return;
+					}
+					ImageMemoryBarrier2 barrier(run->m_oldLayout, usageScope.m_layout, image);
+					barrier.setAspectMask(pState->aspectMask())
+						.setMipLevels(runBaseLevel, endLevel - runBaseLevel)
+						.setArrayLayers(layer, 1);
+					barrier.srcStageMask = run->m_srcStages;
+					barrier.srcAccessMask = run->m_srcAccess;
+					barrier.dstStageMask = usageScope.m_stages;
+					barrier.dstAccessMask = usageScope.m_access;
+					if (!pAcquire) {
+						m_imageMemoryBarriers.push_back(barrier);
+					}
+					else {
+						barrier.setQueueFamilies(srcQueueFamilyIndex, dstQueueFamilyIndex);
+						ImageMemoryBarrier2 acquire = barrier;
+						barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+						barrier.dstAccessMask = VK_ACCESS_2_NONE;
+						acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+						acquire.srcAccessMask = VK_ACCESS_2_NONE;
+						m_imageMemoryBarriers.push_back(barrier);
+						pAcquire->m_imageMemoryBarriers.push_back(acquire);
+					}
+					barrierCount++;
+					run.reset();
+				};
+
+				for (uint32_t level = baseMipLevel; level < baseMipLevel + levelCount; level++) {
+					std::optional<ImageState::Barrier> barrier =
+						pState->use(level, layer, usageScope, discardContents, pAcquire != nullptr);
+					if (run && barrier && *barrier == *run) {
+						continue;
+					}
+					endRun(level);
+					if (barrier) {
+						run = barrier;
+						runBaseLevel = level;
+					}
+				}
+				endRun(baseMipLevel + levelCount);
+			}
+			return barrierCount;
+		}
+
+
+	public:
+		DependencyInfo(const DependencyInfo&) = delete;
+		DependencyInfo& operator=(const DependencyInfo&) = delete;
+		DependencyInfo(DependencyInfo&&) noexcept = delete;
+		DependencyInfo& operator=(DependencyInfo&&) noexcept = delete;
+
+		VkDependencyInfo* operator& () = delete;
+
+		DependencyInfo()
+			: VkDependencyInfo{} {
+			sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		}
+
+		void addImageMemoryBarrier(const ImageMemoryBarrier2& imageMemoryBarrier) {
+			m_imageMemoryBarriers.push_back(imageMemoryBarrier);
+		}
+
+		void addMemoryBarrier(const MemoryBarrier2& memoryBarrier) {
+			m_memoryBarriers.push_back(memoryBarrier);
+		}
+
+		void addBufferMemoryBarrier(const BufferMemoryBarrier2& bufferMemoryBarrier) {
+			m_bufferMemoryBarriers.push_back(bufferMemoryBarrier);
+		}
+
+		//	Whatever barriers the image's levels need, from what they were last
+		//	used for, before being used as imageUsage.  Levels already usable
+		//	that way, e.g. sampled again, get none.  Returns how many were added.
+		uint32_t addImageTransition(
+			Image		image,
+			ImageUsage	imageUsage,
+			uint32_t	baseMipLevel = 0,
+			uint32_t	levelCount = VK_REMAINING_MIP_LEVELS,
+			bool		discardContents = false
+		) {
+			return addImageBarriers(image, imageUsage, baseMipLevel, levelCount, discardContents,
+				nullptr, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		}
+
+		//	Moves the levels to another queue family as well: the release half
+		//	goes in this one, to record on the srcQueueFamilyIndex queue, and
+		//	the acquire half in acquire.  The image's state then carries on
+		//	from the acquire.
+		uint32_t addImageOwnershipTransfer(
+			DependencyInfo&	acquire,
+			Image		image,
+			ImageUsage	imageUsage,
+			uint32_t	srcQueueFamilyIndex,
+			uint32_t	dstQueueFamilyIndex,
+			uint32_t	baseMipLevel = 0,
+			uint32_t	levelCount = VK_REMAINING_MIP_LEVELS
+		) {
+			return addImageBarriers(image, imageUsage, baseMipLevel, levelCount, false,
+				std::addressof(acquire), srcQueueFamilyIndex, dstQueueFamilyIndex);
+		}
+
+		bool empty() const {
+			return m_memoryBarriers.empty() && m_bufferMemoryBarriers.empty() && m_imageMemoryBarriers.empty();
+		}
+
+		VkDependencyInfo* assemble() {
+
+			pMemoryBarriers = nullptr;
+			memoryBarrierCount = static_cast<uint32_t>(m_memoryBarriers.size());
+			if (memoryBarrierCount > 0) {
+				pMemoryBarriers = m_memoryBarriers.data();
+			}
+
+			pBufferMemoryBarriers = nullptr;
+			bufferMemoryBarrierCount = static_cast<uint32_t>(m_bufferMemoryBarriers.size());
+			if (bufferMemoryBarrierCount > 0) {
+				pBufferMemoryBarriers = m_bufferMemoryBarriers.data();
+			}
+
+			pImageMemoryBarriers = nullptr;
+			imageMemoryBarrierCount = static_cast<uint32_t>(m_imageMemoryBarriers.size());
+			if (imageMemoryBarrierCount > 0) {
+				pImageMemoryBarriers = m_imageMemoryBarriers.data();
+			}
+
+			return this;
+		}
+
+	};
+
+	//	TODO: should we make some object that has contains a queue and command pool
+	//	and whatever else needed so we don't have to pass the info around as pairs?
+	class CommandPool : public HandleWithOwner<VkCommandPool> {
+
+		CommandPool(VkCommandPool vkCommandPool, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkCommandPool, vkDevice, pfnDestroy) {
+		}
+
+		static void destroy(VkCommandPool vkCommandPool, VkDevice vkDevice) {
+			vkDestroyCommandPool(vkDevice, vkCommandPool, nullptr);
+		}
+
+
+	public:
+
+		CommandPool() {}
+		CommandPool(const VkCommandPoolCreateInfo& commandPoolCreateInfo, VkDevice vkDevice) {
+			VkCommandPool vkCommandPool;
+			VkResult vkResult = vkCreateCommandPool(
+				vkDevice,
+				&commandPoolCreateInfo,
+				nullptr,
+				&vkCommandPool);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)CommandPool(vkCommandPool, vkDevice, &destroy);
+		}
+
+		CommandPool(
+			VkCommandPoolCreateFlags	vkCommandPoolCreateFlags,
+			uint32_t					queueFamilyIndex,
+			VkDevice					vkDevice
+		) {
+			VkCommandPoolCreateInfo commandPoolCreateInfo{};
+			commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolCreateInfo.flags = vkCommandPoolCreateFlags;
+			commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+			new(this)CommandPool(commandPoolCreateInfo, vkDevice);
+
+		}
+
+		//	Recycles every command buffer allocated from the pool at once.
+		void reset() {
+			VkResult vkResult = vkResetCommandPool(getVkDevice(), *this, 0);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
 			}
+		}
 
 
+	};
 
-			//	TODO:	need to figure out which attachments to preserve.
-			//preserveAttachmentCount = 2;
-			//pPreserveAttachments = s_preserve.data();
+	//	What a CommandBuffer last bound or set, so calls that would change
+	//	nothing can be skipped.  Lives on the recording thread's stack (the
+	//	CommandBuffer handle is copied around and just points at it), one
+	//	per command buffer being recorded.  Only what the CommandBuffer
+	//	methods below set is tracked: the graphics pipeline, descriptor
+	//	set 0, vertex bindings, the index buffer, viewport 0, scissor 0 and
+	//	depth test enable.
+	class CommandBufferState {
+
+		static constexpr uint32_t MAX_TRACKED_VERTEX_BINDINGS = 4;
+
+		static inline std::atomic<uint64_t>	s_issuedCount;
+		static inline std::atomic<uint64_t>	s_elidedCount;
+
+		VkPipeline			m_vkPipeline;
+		VkPipelineLayout	m_vkPipelineLayout;
+		VkDescriptorSet		m_vkDescriptorSet;
+		bool				m_hasDynamicOffset;
+		uint32_t			m_dynamicOffset;
+		VkBuffer			m_vertexBuffers[MAX_TRACKED_VERTEX_BINDINGS];
+		VkDeviceSize		m_vertexBufferOffsets[MAX_TRACKED_VERTEX_BINDINGS];
+		VkBuffer			m_indexBuffer;
+		VkDeviceSize		m_indexBufferOffset;
+		VkIndexType			m_indexType;
+		bool				m_hasViewport;
+		VkViewport			m_viewport;
+		bool				m_hasScissor;
+		VkRect2D			m_scissor;
+		int					m_depthTestEnable;	//	-1 unknown.
+
+		uint64_t	m_issuedCount = 0;
+		uint64_t	m_elidedCount = 0;
+
+		bool issueIf(bool changed) {
+			if (changed) {
+				m_issuedCount++;
+			}
+			else {
+				m_elidedCount++;
+			}
+			return changed;
+		}
+
+		//	Pipelines with the state static overwrite it when bound.
+		void forgetDynamicState() {
+			m_hasViewport = false;
+			m_hasScissor = false;
+			m_depthTestEnable = -1;
+		}
+
+	public:
+
+		CommandBufferState(const CommandBufferState&) = delete;
+		CommandBufferState& operator=(const CommandBufferState&) = delete;
+
+		CommandBufferState() {
+			reset();
+		}
+
+		//	Adds this recording's counts to the totals.
+		~CommandBufferState() {
+			s_issuedCount.fetch_add(m_issuedCount, std::memory_order_relaxed);
+			s_elidedCount.fetch_add(m_elidedCount, std::memory_order_relaxed);
+		}
+
+		//	Totals of the tracked calls over every CommandBufferState so far.
+		static uint64_t issuedCount() {
+			return s_issuedCount.load(std::memory_order_relaxed);
+		}
+
+		static uint64_t elidedCount() {
+			return s_elidedCount.load(std::memory_order_relaxed);
+		}
+
+		//	Nothing is known bound: at begin, on a new subpass and after
+		//	executing secondaries, which leave the state undefined.
+		void reset() {
+			m_vkPipeline = VK_NULL_HANDLE;
+			m_vkPipelineLayout = VK_NULL_HANDLE;
+			m_vkDescriptorSet = VK_NULL_HANDLE;
+			m_hasDynamicOffset = false;
+			m_dynamicOffset = 0;
+			for (uint32_t i = 0; i < MAX_TRACKED_VERTEX_BINDINGS; i++) {
+				m_vertexBuffers[i] = VK_NULL_HANDLE;
+				m_vertexBufferOffsets[i] = 0;
+			}
+			m_indexBuffer = VK_NULL_HANDLE;
+			m_indexBufferOffset = 0;
+			m_indexType = VK_INDEX_TYPE_MAX_ENUM;
+			forgetDynamicState();
+		}
+
+		bool bindPipeline(VkPipeline vkPipeline) {
+			if (!issueIf(vkPipeline != m_vkPipeline)) {
+				return false;
+			}
+			m_vkPipeline = vkPipeline;
+			forgetDynamicState();
+			return true;
+		}
+
+		bool bindDescriptorSet(
+			VkPipelineLayout vkPipelineLayout,
+			VkDescriptorSet vkDescriptorSet,
+			bool hasDynamicOffset,
+			uint32_t dynamicOffset
+		) {
+			if (!issueIf(vkPipelineLayout != m_vkPipelineLayout
+				|| vkDescriptorSet != m_vkDescriptorSet
+				|| hasDynamicOffset != m_hasDynamicOffset
+				|| dynamicOffset != m_dynamicOffset)) {
+				return false;
+			}
+			m_vkPipelineLayout = vkPipelineLayout;
+			m_vkDescriptorSet = vkDescriptorSet;
+			m_hasDynamicOffset = hasDynamicOffset;
+			m_dynamicOffset = dynamicOffset;
+			return true;
+		}
+
+		bool bindVertexBuffer(uint32_t binding, VkBuffer vkBuffer, VkDeviceSize offset) {
+			if (binding >= MAX_TRACKED_VERTEX_BINDINGS) {
+				return issueIf(true);
+			}
+			if (!issueIf(vkBuffer != m_vertexBuffers[binding] || offset != m_vertexBufferOffsets[binding])) {
+				return false;
+			}
+			m_vertexBuffers[binding] = vkBuffer;
+			m_vertexBufferOffsets[binding] = offset;
+			return true;
+		}
+
+		bool bindIndexBuffer(VkBuffer vkBuffer, VkDeviceSize offset, VkIndexType vkIndexType) {
+			if (!issueIf(vkBuffer != m_indexBuffer || offset != m_indexBufferOffset || vkIndexType != m_indexType)) {
+				return false;
+			}
+			m_indexBuffer = vkBuffer;
+			m_indexBufferOffset = offset;
+			m_indexType = vkIndexType;
+			return true;
+		}
+
+		bool setViewport(const VkViewport& viewport) {
+			if (!issueIf(!m_hasViewport
+				|| viewport.x != m_viewport.x || viewport.y != m_viewport.y
+				|| viewport.width != m_viewport.width || viewport.height != m_viewport.height
+				|| viewport.minDepth != m_viewport.minDepth || viewport.maxDepth != m_viewport.maxDepth)) {
+				return false;
+			}
+			m_hasViewport = true;
+			m_viewport = viewport;
+			return true;
+		}
+
+		bool setScissor(const VkRect2D& scissor) {
+			if (!issueIf(!m_hasScissor
+				|| scissor.offset.x != m_scissor.offset.x || scissor.offset.y != m_scissor.offset.y
+				|| scissor.extent.width != m_scissor.extent.width || scissor.extent.height != m_scissor.extent.height)) {
+				return false;
+			}
+			m_hasScissor = true;
+			m_scissor = scissor;
+			return true;
+		}
+
+		bool setDepthTestEnable(VkBool32 depthTestEnable) {
+			const int enable = depthTestEnable ? 1 : 0;
+			if (!issueIf(enable != m_depthTestEnable)) {
+				return false;
+			}
+			m_depthTestEnable = enable;
+			return true;
+		}
+
+	};
+
+
+	class CommandBuffer : public HandleWithOwner<VkCommandBuffer, CommandPool> {
+
+		static void destroy(VkCommandBuffer vkCommandBuffer, CommandPool commandPool) {
+			vkFreeCommandBuffers(commandPool.getVkDevice(), commandPool, 1, &vkCommandBuffer);
+		}
+
+		CommandBufferState*	m_pState = nullptr;	//	Copied with the handle.
+
+		CommandBuffer(
+			VkCommandBuffer vkCommandBuffer,
+			CommandPool commandPool,
+			DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkCommandBuffer, commandPool, pfnDestroy) {
+		}
+
+	public:
+
+		CommandBuffer() {}
+
+		CommandBuffer(
+			CommandPool commandPool,
+			VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY
+		) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = level;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+			VkCommandBuffer vkCommandBuffer;
+			vkAllocateCommandBuffers(commandPool.getVkDevice(), &allocInfo, &vkCommandBuffer);
+			new(this) CommandBuffer(vkCommandBuffer, commandPool, &destroy);
+		}
+
+		//	Binds and state sets through this handle (and its copies) go
+		//	through pState and are skipped when they would change nothing.
+		//	Set it before begin, which resets it.
+		void trackState(CommandBufferState* pState) {
+			m_pState = pState;
+		}
+
+		void reset() {
+			VkResult vkResult = vkResetCommandBuffer(*this, 0);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+		}
+
+		void begin() {
+			resetState();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+			VkResult vkResult = vkBeginCommandBuffer(*this, &beginInfo);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+		}
+
+
+		void beginOneTimeSubmit() {
+			resetState();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(*this, &beginInfo);
+		}
+
+		//	For a secondary.  With a render pass in the inheritance info it
+		//	continues that render pass's subpass when executed.
+		void beginSecondary(const VkCommandBufferInheritanceInfo& inheritanceInfo) {
+			resetState();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			if (inheritanceInfo.renderPass != VK_NULL_HANDLE) {
+				beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			}
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			VkResult vkResult = vkBeginCommandBuffer(*this, &beginInfo);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+		}
+
+		void end() {
+			VkResult vkResult = vkEndCommandBuffer(*this);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+		}
+
+		void cmdCopyBufferToImage(
+			Buffer buffer,
+			Image image,
+			uint32_t	width,
+			uint32_t	height
+		) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = 0;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = {
+				width,
+				height,
+				1
+			};
+
+			vkCmdCopyBufferToImage(*this, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		//	TODO: do we need to implement cmdCopyBuffer2?
+		void cmdCopyBuffer(
+			Buffer	srcBuffer,
+			Buffer	dstBuffer,
+			VkDeviceSize	size
+		) {
+			//	TODO: maybe do some size checking on the destination to avoid overwriting.
+			VkBufferCopy	vkBufferCopy{ .srcOffset = 0, .dstOffset = 0, .size = size };
+
+			vkCmdCopyBuffer(*this, srcBuffer, dstBuffer, 1, &vkBufferCopy);
+		}
+
+		void cmdCopyBuffer(
+			Buffer	srcBuffer,
+			Buffer	dstBuffer
+		) {
+			cmdCopyBuffer(srcBuffer, dstBuffer, srcBuffer.size());
+		}
+
+		void cmdPipelineBarrier2(
+			DependencyInfo& dependencyInfo
+		) {
+			vkCmdPipelineBarrier2(*this, dependencyInfo.assemble());
+		}
+
+		//	One image on its own, nothing is recorded if it needs no barrier.
+		//	Several go in one DependencyInfo with addImageTransition instead.
+		void cmdTransition(
+			Image		image,
+			ImageUsage	imageUsage,
+			uint32_t	baseMipLevel = 0,
+			uint32_t	levelCount = VK_REMAINING_MIP_LEVELS
+		) {
+			DependencyInfo dependencyInfo;
+			if (dependencyInfo.addImageTransition(image, imageUsage, baseMipLevel, levelCount) > 0) {
+				cmdPipelineBarrier2(dependencyInfo);
+			}
+		}
+
+		void cmdResetQueryPool(VkQueryPool vkQueryPool, uint32_t firstQuery, uint32_t queryCount) {
+			vkCmdResetQueryPool(*this, vkQueryPool, firstQuery, queryCount);
+		}
+
+		void cmdWriteTimestamp2(VkPipelineStageFlags2 stage, VkQueryPool vkQueryPool, uint32_t query) {
+			vkCmdWriteTimestamp2(*this, stage, vkQueryPool, query);
+		}
+
+		void cmdBeginRenderPass(
+			const VkRenderPassBeginInfo& vkRenderPassBeginInfo,
+			VkSubpassContents vkSubpassContents = VK_SUBPASS_CONTENTS_INLINE
+		) {
+			vkCmdBeginRenderPass(*this, &vkRenderPassBeginInfo, vkSubpassContents);
+		}
+
+		void cmdNextSubpass(VkSubpassContents vkSubpassContents = VK_SUBPASS_CONTENTS_INLINE) {
+			vkCmdNextSubpass(*this, vkSubpassContents);
+			resetState();
+		}
+
+		void cmdExecuteCommands(const std::vector<VkCommandBuffer>& secondaryCommandBuffers) {
+			if (secondaryCommandBuffers.empty()) {
+				return;
+			}
+			vkCmdExecuteCommands(*this,
+				static_cast<uint32_t>(secondaryCommandBuffers.size()),
+				secondaryCommandBuffers.data());
+			resetState();
+		}
+
+		void cmdEndRenderPass() {
+			vkCmdEndRenderPass(*this);
+		}
+
+		void cmdSetViewport(
+			VkExtent2D vkExtent2D
+		) {
+			VkViewport viewport{};
+			viewport.x = 0.0f;
+			viewport.y = 0.0f;
+			viewport.width = static_cast<float>(vkExtent2D.width);
+			viewport.height = static_cast<float>(vkExtent2D.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			if (m_pState && !m_pState->setViewport(viewport)) {
+				return;
+			}
+			vkCmdSetViewport(*this, 0, 1, &viewport);
+		}
+
+		void cmdSetScissor(
+			VkExtent2D vkExtent2D
+		) {
+			VkRect2D scissor{};
+			scissor.offset = { 0, 0 };
+			scissor.extent = vkExtent2D;
+			if (m_pState && !m_pState->setScissor(scissor)) {
+				return;
+			}
+			vkCmdSetScissor(*this, 0, 1, &scissor);
+		}
+
+		void cmdSetDepthTestEnable(VkBool32 depthTestEnable) {
+			if (m_pState && !m_pState->setDepthTestEnable(depthTestEnable)) {
+				return;
+			}
+			vkCmdSetDepthTestEnable(*this, depthTestEnable);
+		}
 
+		//	Only graphics binds are tracked, the bind points are independent.
+		void cmdBindPipeline(
+			VkPipelineBindPoint vkPipelineBindPoint,
+			VkPipeline vkPipeline
+		) {
+			if (vkPipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
+				&& m_pState && !m_pState->bindPipeline(vkPipeline)) {
+				return;
+			}
+			vkCmdBindPipeline(*this, vkPipelineBindPoint, vkPipeline);
+		}
 
-			return this;
+		void cmdBindPipeline(
+			VkPipeline vkPipeline
+		) {
+			cmdBindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipeline);
 		}
 
-	};
+		void cmdBindDescriptorSet(
+			VkPipelineBindPoint vkPipelineBindPoint,
+			VkPipelineLayout vkPipelineLayout,
+			VkDescriptorSet vkDescriptorSet
+		) {
+			if (vkPipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
+				&& m_pState && !m_pState->bindDescriptorSet(vkPipelineLayout, vkDescriptorSet, false, 0)) {
+				return;
+			}
+			vkCmdBindDescriptorSets(*this, vkPipelineBindPoint,
+				vkPipelineLayout, 0, 1, &vkDescriptorSet, 0, nullptr);
 
+		}
 
-	class SubpassDependency : public VkSubpassDependency {
+		void cmdBindDescriptorSet(
+			VkPipelineLayout vkPipelineLayout,
+			VkDescriptorSet vkDescriptorSet
+		) {
+			cmdBindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, vkDescriptorSet);
+		}
 
-	public:
+		//	For sets with one VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding.
+		void cmdBindDescriptorSet(
+			VkPipelineBindPoint vkPipelineBindPoint,
+			VkPipelineLayout vkPipelineLayout,
+			VkDescriptorSet vkDescriptorSet,
+			uint32_t dynamicOffset
+		) {
+			if (vkPipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
+				&& m_pState && !m_pState->bindDescriptorSet(vkPipelineLayout, vkDescriptorSet, true, dynamicOffset)) {
+				return;
+			}
+			vkCmdBindDescriptorSets(*this, vkPipelineBindPoint,
+				vkPipelineLayout, 0, 1, &vkDescriptorSet, 1, &dynamicOffset);
 
-		SubpassDependency()
-			: VkSubpassDependency{} {
 		}
 
-
-		SubpassDependency& setDependency(
-			uint32_t	srcSubpassArg,
-			uint32_t	dstSubpassArg
+		void cmdBindDescriptorSet(
+			VkPipelineLayout vkPipelineLayout,
+			VkDescriptorSet vkDescriptorSet,
+			uint32_t dynamicOffset
 		) {
-			srcSubpass = srcSubpassArg;
-			dstSubpass = dstSubpassArg;
-			return *this;
+			cmdBindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, vkDescriptorSet, dynamicOffset);
 		}
 
-		SubpassDependency& setSrc(
-			VkPipelineStageFlags    srcStageMaskArg,
-			VkAccessFlags           srcAccessMaskArg
+		void cmdBindVertexBuffer(
+			uint32_t binding,
+			VkBuffer vkBuffer,
+			VkDeviceSize offset = 0
 		) {
-			srcStageMask = srcStageMaskArg;
-			srcAccessMask = srcAccessMaskArg;
-			return *this;
+			if (m_pState && !m_pState->bindVertexBuffer(binding, vkBuffer, offset)) {
+				return;
+			}
+			vkCmdBindVertexBuffers(*this, binding, 1, &vkBuffer, &offset);
 		}
 
-		SubpassDependency& addSrc(
-			VkPipelineStageFlags    srcStageMaskArg,
-			VkAccessFlags           srcAccessMaskArg
+		void cmdBindIndexBuffer(
+			VkBuffer vkBuffer,
+			VkIndexType vkIndexType,
+			VkDeviceSize offset = 0
 		) {
-			srcStageMask |= srcStageMaskArg;
-			srcAccessMask |= srcAccessMaskArg;
-			return *this;
+			if (m_pState && !m_pState->bindIndexBuffer(vkBuffer, offset, vkIndexType)) {
+				return;
+			}
+			vkCmdBindIndexBuffer(*this, vkBuffer, offset, vkIndexType);
 		}
 
+		void cmdDrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1) {
+			vkCmdDrawIndexed(*this, indexCount, instanceCount, 0, 0, 0);
+		}
 
-		SubpassDependency& setDst(
-			VkPipelineStageFlags    dstStageMaskArg,
-			VkAccessFlags           dstAccessMaskArg
+		//	Tightly packed VkDrawIndexedIndirectCommands, the count is a
+		//	uint32_t at the start of countBuffer.  Needs drawIndirectCount.
+		void cmdDrawIndexedIndirectCount(
+			Buffer		commandsBuffer,
+			Buffer		countBuffer,
+			uint32_t	maxDrawCount
 		) {
-			dstStageMask = dstStageMaskArg;
-			dstAccessMask = dstAccessMaskArg;
-			return *this;
+			vkCmdDrawIndexedIndirectCount(*this, commandsBuffer, 0, countBuffer, 0,
+				maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
 		}
 
-		SubpassDependency& addDst(
-			VkPipelineStageFlags    dstStageMaskArg,
-			VkAccessFlags           dstAccessMaskArg
-		) {
-			dstStageMask |= dstStageMaskArg;
-			dstAccessMask |= dstAccessMaskArg;
-			return *this;
+		void cmdDispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) {
+			vkCmdDispatch(*this, groupCountX, groupCountY, groupCountZ);
 		}
 
-	};
-	static_assert(sizeof(SubpassDependency) == sizeof(VkSubpassDependency));
+		//	A VkDispatchIndirectCommand at offset, e.g. sized by an earlier pass.
+		void cmdDispatchIndirect(Buffer buffer, VkDeviceSize offset = 0) {
+			vkCmdDispatchIndirect(*this, buffer, offset);
+		}
 
+		//	The whole buffer.
+		void cmdFillBuffer(Buffer buffer, uint32_t data) {
+			vkCmdFillBuffer(*this, buffer, 0, VK_WHOLE_SIZE, data);
+		}
 
-	class RenderPassCreateInfo : public VkRenderPassCreateInfo {
+	private:
 
-		std::vector<VkAttachmentDescription>	m_attachmentDescriptions;
+		void resetState() {
+			if (m_pState) {
+				m_pState->reset();
+			}
+		}
 
-		std::vector<SubpassDescription> m_subpassDescriptions;
-		std::vector<VkSubpassDescription>	m_vkSubpassDescriptions;
+	};
 
-		std::vector<SubpassDependency> m_subpassDependencies;
-		std::vector<VkSubpassDependency> m_vkSubpassDependencies;
+
+	//	Hands out command buffers from one TRANSIENT pool, e.g. for one
+	//	drawing frame.  Nothing is freed or reset a buffer at a time: once
+	//	the gpu is done with everything handed out (the frame's fence is
+	//	open), reset() recycles the whole pool with one vkResetCommandPool
+	//	and the buffers go back on the free list to be handed out again.
+	class TransientCommandAllocator {
+
+		CommandPool	m_commandPool;
+		//	[primary, secondary], after the pool so they are freed first.
+		std::vector<CommandBuffer>	m_commandBuffers[2];
+		size_t	m_handedOutCount[2] = {};
+
+		static size_t levelIndex(VkCommandBufferLevel level) {
+			return level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+		}
 
 	public:
 
-		RenderPassCreateInfo()
-			: VkRenderPassCreateInfo{} {
+		TransientCommandAllocator() {}
+
+		TransientCommandAllocator(uint32_t queueFamilyIndex, VkDevice vkDevice)
+			: m_commandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queueFamilyIndex, vkDevice) {
 		}
 
-		VkRenderPassCreateInfo* operator&() = delete;
+		TransientCommandAllocator(const TransientCommandAllocator&) = delete;
+		TransientCommandAllocator& operator=(const TransientCommandAllocator&) = delete;
 
-		VkAttachmentReference addAttachment(
-			const AttachmentDescription& attachmentDescription,
-			VkImageLayout	imageLayout
-		) {
-			m_attachmentDescriptions.emplace_back(attachmentDescription);
-			//	"attachment" really means "attachment index in the array of attachments"
-			VkAttachmentReference attachmentReference{};
-			attachmentReference.attachment = static_cast<uint32_t>(m_attachmentDescriptions.size() - 1);
-			attachmentReference.layout = imageLayout;
-			return attachmentReference;
+		TransientCommandAllocator(TransientCommandAllocator&& other) noexcept
+			: m_commandPool(std::move(other.m_commandPool))
+			, m_commandBuffers{ std::move(other.m_commandBuffers[0]), std::move(other.m_commandBuffers[1]) }
+			, m_handedOutCount{ other.m_handedOutCount[0], other.m_handedOutCount[1] } {
+			other.m_commandBuffers[0].clear();
+			other.m_commandBuffers[1].clear();
+			other.m_handedOutCount[0] = 0;
+			other.m_handedOutCount[1] = 0;
 		}
 
-		SubpassDescription& addSubpass() {
-			SubpassDescription& subpassDescription = m_subpassDescriptions.emplace_back();
-			subpassDescription.setPipelineBindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS);
-			return subpassDescription;
+		//	Destroy first so the old buffers are freed before their pool.
+		TransientCommandAllocator& operator=(TransientCommandAllocator&& other) noexcept {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~TransientCommandAllocator();
+			new(this) TransientCommandAllocator(std::move(other));
+			return *this;
 		}
 
-		SubpassDependency& addSubpassDependency(
-			uint32_t	srcSubpass,
-			uint32_t	dstSubpass
-		) {
-			SubpassDependency& subpassDependency = m_subpassDependencies.emplace_back();
-			subpassDependency.setDependency(srcSubpass, dstSubpass);
-			return subpassDependency;
+		explicit operator bool() const {
+			return static_cast<bool>(m_commandPool);
 		}
 
+		//	Not begun.  Good until the next reset.
+		CommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
+			std::vector<CommandBuffer>& commandBuffers = m_commandBuffers[levelIndex(level)];
+			size_t& handedOutCount = m_handedOutCount[levelIndex(level)];
+			if (handedOutCount == commandBuffers.size()) {
+				commandBuffers.push_back(CommandBuffer(m_commandPool, level));
+			}
+			return commandBuffers[handedOutCount++];
+		}
 
-		VkRenderPassCreateInfo* assemble() {
+		//	Only once the gpu is done with every buffer handed out.
+		void reset() {
+			if (m_handedOutCount[0] == 0 && m_handedOutCount[1] == 0) {
+				return;
+			}
+			m_commandPool.reset();
+			m_handedOutCount[0] = 0;
+			m_handedOutCount[1] = 0;
+		}
 
-			//	TODO: where do these magic layout transitions happen?
+		size_t allocatedCount() const {
+			return m_commandBuffers[0].size() + m_commandBuffers[1].size();
+		}
 
-			sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	};
 
-			pAttachments = nullptr;
-			attachmentCount = static_cast<uint32_t>(m_attachmentDescriptions.size());
-			if (attachmentCount > 0) {
-				pAttachments = m_attachmentDescriptions.data();
-			}
 
-			pSubpasses = nullptr;
-			m_vkSubpassDescriptions.clear();
-			subpassCount = static_cast<uint32_t>(m_subpassDescriptions.size());
-			if (subpassCount > 0) {
-				for (SubpassDescription& subpassDescription : m_subpassDescriptions) {
-					//	TODO: investigate.  This is either really clever or really risky.
-					//	We assemble the the subpass description and then push back
-					//	a copy of the VkSubpassDescription part of our structure.
-					m_vkSubpassDescriptions.push_back(*subpassDescription.assemble());
+	//	Records a draw list into secondary command buffers, split into
+	//	chunks across a WorkerPool.  Each chunk has its own allocator per
+	//	drawing frame, so no pool is ever used by two threads at once, and
+	//	a frame's pools are reset wholesale once its fence is open.
+	class ParallelCommandRecorder {
+
+		std::vector<std::vector<TransientCommandAllocator>>	m_frameAllocators;	//	[drawing frame][chunk]
+		std::vector<std::exception_ptr>	m_exceptions;	//	[chunk]
+		std::vector<VkCommandBuffer>	m_recorded;
+		std::mutex	m_mutex;
+		std::condition_variable	m_chunkDone;
+		size_t	m_pendingChunkCount = 0;
+
+	public:
+
+		ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+		ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+		ParallelCommandRecorder(ParallelCommandRecorder&&) = delete;
+		ParallelCommandRecorder& operator=(ParallelCommandRecorder&&) = delete;
+
+		//	maxChunkCount is usually the worker count plus one for the calling thread.
+		ParallelCommandRecorder(
+			uint32_t	drawingFrameCount,
+			uint32_t	maxChunkCount,
+			uint32_t	queueFamilyIndex,
+			VkDevice	vkDevice
+		) {
+			m_frameAllocators.resize(drawingFrameCount);
+			for (std::vector<TransientCommandAllocator>& allocators : m_frameAllocators) {
+				for (uint32_t i = 0; i < maxChunkCount; i++) {
+					allocators.emplace_back(queueFamilyIndex, vkDevice);
 				}
-				pSubpasses = m_vkSubpassDescriptions.data();
+			}
+			m_exceptions.resize(maxChunkCount);
+		}
+
+		//	Splits drawCount draws into chunks of at least minDrawsPerChunk.
+		//	Chunk 0 is recorded on the calling thread, so anything that must
+		//	stay on one thread can go with the first draw.  Returns the
+		//	secondaries in draw list order, ready for cmdExecuteCommands.
+		//	recordChunk(CommandBuffer, first, count) records draws [first, first + count)
+		//	of the draw list; it's a template so a capturing lambda isn't boxed
+		//	into a std::function (and a heap allocation) every frame.
+		template<typename RecordChunk_t>
+		const std::vector<VkCommandBuffer>& record(
+			uint32_t	drawingFrameIndex,
+			const VkCommandBufferInheritanceInfo& inheritanceInfo,
+			size_t		drawCount,
+			size_t		minDrawsPerChunk,
+			const RecordChunk_t& recordChunk,
+			WorkerPool& workerPool
+		) {
+			std::vector<TransientCommandAllocator>& allocators = m_frameAllocators.at(drawingFrameIndex);
+			for (TransientCommandAllocator& allocator : allocators) {
+				allocator.reset();
 			}
 
-			pDependencies = nullptr;
-			m_vkSubpassDependencies.clear();
-			dependencyCount = static_cast<uint32_t>(m_subpassDependencies.size());
-			if (dependencyCount > 0) {
-				for (SubpassDependency& subpassDependency : m_subpassDependencies) {
-					m_vkSubpassDependencies.push_back(subpassDependency);
+			const size_t chunkCount = std::clamp<size_t>(
+				drawCount / std::max<size_t>(minDrawsPerChunk, 1), 1, allocators.size());
+
+			m_recorded.resize(chunkCount);
+			auto recordSlot = [&](size_t chunk) {
+				const size_t first = drawCount * chunk / chunkCount;
+				const size_t last = drawCount * (chunk + 1) / chunkCount;
+				CommandBuffer commandBuffer = allocators[chunk].allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+				m_recorded[chunk] = commandBuffer;
+				commandBuffer.beginSecondary(inheritanceInfo);
+				recordChunk(commandBuffer, first, last - first);
+				commandBuffer.end();
+			};
+
+			auto recordWorkerSlot = [&](size_t chunk) {
+				try {
+					recordSlot(chunk);
 				}
-				pDependencies = m_vkSubpassDependencies.data();
+				catch (...) {
+					m_exceptions[chunk] = std::current_exception();
+				}
+				//	Under the lock, record() may return as soon as it is released.
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pendingChunkCount--;
+				m_chunkDone.notify_one();
+			};
+
+			m_pendingChunkCount = chunkCount - 1;
+			for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+				//	Two words, small enough for the std::function to hold in place.
+				workerPool.enqueue([&recordWorkerSlot, chunk] { recordWorkerSlot(chunk); });
 			}
 
-			return this;
+			try {
+				recordSlot(0);
+			}
+			catch (...) {
+				m_exceptions[0] = std::current_exception();
+			}
 
-		}
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_chunkDone.wait(lock, [this] { return m_pendingChunkCount == 0; });
+			}
+
+			for (std::exception_ptr& exception : m_exceptions) {
+				if (exception) {
+					std::exception_ptr firstException = exception;
+					std::fill(m_exceptions.begin(), m_exceptions.end(), nullptr);
+					std::rethrow_exception(firstException);
+				}
+			}
 
+			return m_recorded;
+		}
 
 	};
 
 
-	//	TODO: do we really need this yet?
-	class RenderPassCreateInfo2 : public VkRenderPassCreateInfo2 {
+
+	class SubmitInfo2 : public VkSubmitInfo2 {
 
 	public:
 
-		VkRenderPassCreateInfo2* operator&() = delete;
+		using SemaphoreInfos_t = InlineVector<VkSemaphoreSubmitInfo, 4>;
+
+	private:
+
+		SemaphoreInfos_t	m_waitSemaphoreInfos;
+		InlineVector<VkCommandBufferSubmitInfo, 4>	m_commandBufferInfos;
+		SemaphoreInfos_t	m_signalSemaphoreInfos;
+
+
+	public:
+
+		SubmitInfo2()
+			: VkSubmitInfo2{} {
+			sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		}
+
+		SubmitInfo2* operator&() = delete;
+
+		void addCommandBuffer(CommandBuffer commandBuffer) {
+			VkCommandBufferSubmitInfo	vkCommandBufferSubmitInfo{};
+			vkCommandBufferSubmitInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+			vkCommandBufferSubmitInfo.commandBuffer = commandBuffer;
+			m_commandBufferInfos.push_back(vkCommandBufferSubmitInfo);
+		}
+
+		void addWaitSemaphore(
+			Semaphore semaphore,
+			PipelineStageFlags2 waitPipelineStateFlags2
+
+			//			VkPipelineStageFlags2 waitPipelineStateFlags2
+		) {
+			VkSemaphoreSubmitInfo	vkSemaphoreSubmitInfo{};
+			vkSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			vkSemaphoreSubmitInfo.semaphore = semaphore;
+			vkSemaphoreSubmitInfo.stageMask = static_cast<VkPipelineStageFlagBits2>(waitPipelineStateFlags2);
+			m_waitSemaphoreInfos.push_back(vkSemaphoreSubmitInfo);
+		}
+
+		//	Timeline semaphores, e.g. another queue's GpuTimeline, wait for a value.
+		void addWaitSemaphore(
+			Semaphore semaphore,
+			uint64_t value,
+			PipelineStageFlags2 waitPipelineStateFlags2
+		) {
+			VkSemaphoreSubmitInfo	vkSemaphoreSubmitInfo{};
+			vkSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			vkSemaphoreSubmitInfo.semaphore = semaphore;
+			vkSemaphoreSubmitInfo.value = value;
+			vkSemaphoreSubmitInfo.stageMask = static_cast<VkPipelineStageFlagBits2>(waitPipelineStateFlags2);
+			m_waitSemaphoreInfos.push_back(vkSemaphoreSubmitInfo);
+		}
+
+		void addSignalSemaphore(Semaphore semaphore) {
+			VkSemaphoreSubmitInfo	vkSemaphoreSubmitInfo{};
+			vkSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			vkSemaphoreSubmitInfo.semaphore = semaphore;
+			m_signalSemaphoreInfos.push_back(vkSemaphoreSubmitInfo);
+		}
+
+
+		const SemaphoreInfos_t& waitSemaphoreInfos() const {
+			return m_waitSemaphoreInfos;
+		}
+
+		const SemaphoreInfos_t& signalSemaphoreInfos() const {
+			return m_signalSemaphoreInfos;
+		}
+
+		SubmitInfo2* assemble() {
+
+			pWaitSemaphoreInfos = nullptr;
+			waitSemaphoreInfoCount = static_cast<uint32_t>(m_waitSemaphoreInfos.size());
+			if (waitSemaphoreInfoCount > 0) {
+				pWaitSemaphoreInfos = m_waitSemaphoreInfos.data();
+			}
+
+			pCommandBufferInfos = nullptr;
+			commandBufferInfoCount = static_cast<uint32_t>(m_commandBufferInfos.size());
+			if (commandBufferInfoCount > 0) {
+				pCommandBufferInfos = m_commandBufferInfos.data();
+			}
+
+			pSignalSemaphoreInfos = nullptr;
+			signalSemaphoreInfoCount = static_cast<uint32_t>(m_signalSemaphoreInfos.size());
+			if (signalSemaphoreInfoCount > 0) {
+				pSignalSemaphoreInfos = m_signalSemaphoreInfos.data();
+			}
 
-		VkRenderPassCreateInfo2* assemble() {
 			return this;
 		}
-	};
-
 
-	class RenderPass : public HandleWithOwner<VkRenderPass> {
+	};
 
-		RenderPass(VkRenderPass vkRenderPass, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkRenderPass, vkDevice, pfnDestroy) {
-		}
+	class PresentInfo : public VkPresentInfoKHR {
 
-		static void destroy(VkRenderPass vkRenderPass, VkDevice vkDevice) {
-			vkDestroyRenderPass(vkDevice, vkRenderPass, nullptr);
-		}
+		InlineVector<VkSemaphore, 4>	m_vkWaitSemaphores;
+		InlineVector<VkSwapchainKHR, 2>	m_vkSwapchains;
+		InlineVector<uint32_t, 2>		m_swapchainImageIndices;
+		InlineVector<VkFence, 2>		m_presentFences;
+		VkSwapchainPresentFenceInfoEXT	m_vkSwapchainPresentFenceInfo{};
 
 	public:
 
-		RenderPass() {}
-		RenderPass(RenderPassCreateInfo& renderPassCreateInfo, VkDevice vkDevice) {
-			VkRenderPass	vkRenderPass;
-			VkResult vkResult = vkCreateRenderPass(vkDevice, renderPassCreateInfo.assemble(), nullptr, &vkRenderPass);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
-			new(this)RenderPass(vkRenderPass, vkDevice, &destroy);
+		PresentInfo()
+			: VkPresentInfoKHR{} {
+			sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		}
 
-		//	TODO: do we really need this yet?
-		//RenderPass(RenderPassCreateInfo2& renderPassCreateInfo2, VkDevice vkDevice) {
-		//	VkRenderPass	vkRenderPass;
-		//	VkResult vkResult = vkCreateRenderPass2(vkDevice, renderPassCreateInfo2.assemble(), nullptr, &vkRenderPass);
-		//	if (vkResult != VK_SUCCESS) {
-		//		throw Exception(vkResult);
-		//	}
-		//	new(this)RenderPass(vkRenderPass, vkDevice, &destroy);
-		//}
-
-	};
-
-	class ImageCreateInfo : public VkImageCreateInfo {
+		PresentInfo* operator&() = delete;
 
-	public:
+		void addWaitSemaphore(vkcpp::Semaphore semaphore) {
+			m_vkWaitSemaphores.push_back(semaphore);
+		}
 
-		ImageCreateInfo(
-			VkFormat vkFormat,
-			VkImageUsageFlags vkUsage)
-			: VkImageCreateInfo{} {
-			sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			format = vkFormat;
-			usage = vkUsage;
+		//	presentFence opens once the presentation engine is done with what
+		//	the present used.  Needs VK_EXT_swapchain_maintenance1.
+		void addSwapchain(
+			VkSwapchainKHR vkSwapchain,
+			int	swapchainImageIndex,
+			VkFence presentFence = VK_NULL_HANDLE
+		) {
+			m_vkSwapchains.push_back(vkSwapchain);
+			m_swapchainImageIndices.push_back(static_cast<uint32_t>(swapchainImageIndex));
+			m_presentFences.push_back(presentFence);
+		}
 
-			imageType = VK_IMAGE_TYPE_2D;
+		VkPresentInfoKHR* assemble() {
+			waitSemaphoreCount = static_cast<uint32_t>(m_vkWaitSemaphores.size());
+			pWaitSemaphores = waitSemaphoreCount > 0 ? m_vkWaitSemaphores.data() : nullptr;
 
-			extent.depth = 1;
-			mipLevels = 1;
-			arrayLayers = 1;
-			initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			swapchainCount = static_cast<uint32_t>(m_vkSwapchains.size());
+			pSwapchains = swapchainCount > 0 ? m_vkSwapchains.data() : nullptr;
+			pImageIndices = swapchainCount > 0 ? m_swapchainImageIndices.data() : nullptr;
 
-			samples = VK_SAMPLE_COUNT_1_BIT;
-			sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			pResults = nullptr;
 
-		}
+			pNext = nullptr;
+			for (VkFence presentFence : m_presentFences) {
+				if (presentFence != VK_NULL_HANDLE) {
+					m_vkSwapchainPresentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+					m_vkSwapchainPresentFenceInfo.swapchainCount = swapchainCount;
+					m_vkSwapchainPresentFenceInfo.pFences = m_presentFences.data();
+					pNext = &m_vkSwapchainPresentFenceInfo;
+					break;
+				}
+			}
 
-		ImageCreateInfo& setExtent(VkExtent2D  vkExtent2D) {
-			extent.width = vkExtent2D.width;
-			extent.height = vkExtent2D.height;
-			return *this;
+			return this;
 		}
 
 	};
 
-	class Image : public HandleWithOwner<VkImage, Device> {
 
-		Image(VkImage vkImage, Device device, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkImage, device, pfnDestroy) {
-		}
 
-		static void destroy(VkImage vkImage, Device device) {
-			vkDestroyImage(device, vkImage, nullptr);
-		}
+	//	A timeline semaphore a queue signals with the next value on every
+	//	submit.  Whatever the gpu uses can keep the value of the submit that
+	//	last used it, and the cpu polls or waits for that value instead of
+	//	keeping a fence per submit.  Values are handed out as submits go to
+	//	the queue, so reserveValue and published are synchronized like the
+	//	queue; reached and wait can be called from any thread.
+	class GpuTimeline {
 
-	public:
-		Image() {}
+		Semaphore	m_semaphore;
+		uint64_t	m_lastSubmittedValue = 0;
+		std::atomic<uint64_t>	m_completedValue = 0;	//	Last seen, only ever grows.
 
-		Image(const ImageCreateInfo& imageCreateInfo, Device device) {
-			VkImage vkImage;
-			VkResult vkResult = vkCreateImage(device, &imageCreateInfo, nullptr, &vkImage);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		void sawCompleted(uint64_t value) {
+			uint64_t completedValue = m_completedValue.load(std::memory_order_relaxed);
+			while (completedValue < value
+				&& !m_completedValue.compare_exchange_weak(completedValue, value, std::memory_order_relaxed)) {
 			}
-			new(this) Image(vkImage, device, &destroy);
 		}
 
-		//static Image fromExisting(VkImage vkImage, Device device) {
-		//	return Image(vkImage, device, nullptr);
-		//}
+	public:
 
-		//static std::vector<Image> fromExisting(std::vector<VkImage>& vkImages, Device device) {
-		//	std::vector<Image> images;
-		//	for (VkImage vkImage : vkImages) {
-		//		images.push_back(fromExisting(vkImage, device));
-		//	}
-		//	return images;
-		//}
+		GpuTimeline(const GpuTimeline&) = delete;
+		GpuTimeline& operator=(const GpuTimeline&) = delete;
+		GpuTimeline(GpuTimeline&&) = delete;
+		GpuTimeline& operator=(GpuTimeline&&) = delete;
 
-		VkMemoryRequirements  getMemoryRequirements() {
-			VkMemoryRequirements vkMemoryRequirements;
-			vkGetImageMemoryRequirements(getVkDevice(), *this, &vkMemoryRequirements);
-			return vkMemoryRequirements;
+		explicit GpuTimeline(VkDevice vkDevice) {
+			VkSemaphoreTypeCreateInfo vkSemaphoreTypeCreateInfo{};
+			vkSemaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			vkSemaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			vkSemaphoreTypeCreateInfo.initialValue = 0;
+			VkSemaphoreCreateInfo vkSemaphoreCreateInfo{};
+			vkSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			vkSemaphoreCreateInfo.pNext = &vkSemaphoreTypeCreateInfo;
+			m_semaphore = Semaphore(vkSemaphoreCreateInfo, vkDevice);
 		}
 
-		DeviceMemory allocateDeviceMemory(MemoryPropertyFlags requiredProperties) {
-			VkMemoryRequirements vkMemoryRequirements = getMemoryRequirements();
-			VkMemoryAllocateInfo vkMemoryAllocateInfo{};
-			vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
-			vkMemoryAllocateInfo.memoryTypeIndex =
-				getOwner().findMemoryTypeIndex(vkMemoryRequirements.memoryTypeBits, requiredProperties);
-			return vkcpp::DeviceMemory(vkMemoryAllocateInfo, getOwner());
+		Semaphore semaphore() const {
+			return m_semaphore;
 		}
 
-	};
-
-
-	class ImageViewCreateInfo : public VkImageViewCreateInfo {
-
-	public:
-		ImageViewCreateInfo(
-			VkImage			vkImage,
-			VkImageViewType vkImageViewType,
-			VkFormat	vkFormat,
-			VkImageAspectFlags aspectFlags)
-			: VkImageViewCreateInfo{} {
-			sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			image = vkImage;
-			viewType = vkImageViewType;
-			format = vkFormat;
-			subresourceRange.aspectMask = aspectFlags;
-			components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-			components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-			components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-			components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = 1;
-			subresourceRange.baseArrayLayer = 0;
-			subresourceRange.layerCount = 1;
+		//	For the queue, as it submits.  The value only counts as submitted
+		//	once the queue publishes it, so a failed submit hands out the same
+		//	value again and nothing ever waits on a signal that won't come.
+		uint64_t reserveValue() const {
+			return m_lastSubmittedValue + 1;
 		}
 
-
-	};
-
-	class ImageView : public HandleWithOwner<VkImageView> {
-
-		ImageView(VkImageView vkImageView, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkImageView, vkDevice, pfnDestroy) {
-
+		void published(uint64_t value) {
+			m_lastSubmittedValue = value;
 		}
 
-		static void destroy(VkImageView vkImageView, VkDevice vkDevice) {
-			vkDestroyImageView(vkDevice, vkImageView, nullptr);
+		//	Covers everything submitted to the queue so far.
+		uint64_t lastSubmittedValue() const {
+			return m_lastSubmittedValue;
 		}
 
-	public:
+		uint64_t completedValue() {
+			uint64_t value = 0;
+			VkResult vkResult = vkGetSemaphoreCounterValue(m_semaphore.getVkDevice(), m_semaphore, &value);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			sawCompleted(value);
+			return value;
+		}
 
-		//	TODO: need to start remembering some info about the image and how the
-		//	imageview was created to make things easier to use later.
-		ImageView() {}
+		//	Doesn't wait.  Only asks the driver when the last seen value isn't enough.
+		bool reached(uint64_t value) {
+			if (value <= m_completedValue.load(std::memory_order_relaxed)) {
+				return true;
+			}
+			return completedValue() >= value;
+		}
 
-		ImageView(const VkImageViewCreateInfo& vkImageViewCreateInfo, VkDevice vkDevice) {
-			VkImageView vkImageView;
-			VkResult vkResult = vkCreateImageView(vkDevice, &vkImageViewCreateInfo, nullptr, &vkImageView);
+		void wait(uint64_t value) {
+			if (reached(value)) {
+				return;
+			}
+			VkSemaphore vkSemaphore = m_semaphore;
+			VkSemaphoreWaitInfo vkSemaphoreWaitInfo{};
+			vkSemaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			vkSemaphoreWaitInfo.semaphoreCount = 1;
+			vkSemaphoreWaitInfo.pSemaphores = &vkSemaphore;
+			vkSemaphoreWaitInfo.pValues = &value;
+			VkResult vkResult = vkWaitSemaphores(m_semaphore.getVkDevice(), &vkSemaphoreWaitInfo, UINT64_MAX);
 			if (vkResult != VK_SUCCESS) {
 				throw Exception(vkResult);
 			}
-			new(this) ImageView(vkImageView, vkDevice, &destroy);
+			sawCompleted(value);
 		}
 
-
 	};
 
-	class MemoryBarrier2 : public VkMemoryBarrier2 {
 
-	public:
-		MemoryBarrier2(
-			VkPipelineStageFlags2    srcStageMaskArg,
-			VkAccessFlags2           srcAccessMaskArg,
-			VkPipelineStageFlags2    dstStageMaskArg,
-			VkAccessFlags2           dstAccessMaskArg
-		)
-			: VkMemoryBarrier2{} {
-			sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	class Queue : public HandleWithOwner<VkQueue, Device> {
 
-			srcStageMask = srcStageMaskArg;
-			srcAccessMask = srcAccessMaskArg;
-			dstStageMask = dstStageMaskArg;
-			dstAccessMask = dstAccessMaskArg;
-		}
+		//	vkQueueSubmit2 calls on every queue, to see what submits cost per frame.
+		static inline std::atomic<uint64_t>	s_submitCount;
 
+		GpuTimeline*	m_pTimeline = nullptr;	//	Shared by every copy of the queue.
 
-	};
+	public:
 
+		uint32_t	m_queueFamilyIndex = 0;
 
-	class SamplerCreateInfo : public VkSamplerCreateInfo {
+		static uint64_t submitCount() {
+			return s_submitCount.load(std::memory_order_relaxed);
+		}
 
-	public:
+		Queue() {}
 
-		SamplerCreateInfo()
-			: VkSamplerCreateInfo{}
-		{
-			sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-			magFilter = VK_FILTER_LINEAR;
-			minFilter = VK_FILTER_LINEAR;
-			mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			anisotropyEnable = VK_FALSE;
-			maxAnisotropy = 1.0f;
-			borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-			unnormalizedCoordinates = VK_FALSE;
-			compareEnable = VK_FALSE;
-			compareOp = VK_COMPARE_OP_ALWAYS;
+		//	Queues always come from the device and are never (explicitly) destroyed
+		Queue(VkQueue vkQueue, uint32_t queueFamilyIndex, Device device)
+			: HandleWithOwner(vkQueue, device, nullptr)
+			, m_queueFamilyIndex(queueFamilyIndex) {
 		}
-	};
 
-	class Sampler : public HandleWithOwner<VkSampler, Device> {
+		Queue(const Queue& other)
+			: HandleWithOwner(other)
+			, m_pTimeline(other.m_pTimeline)
+			, m_queueFamilyIndex(other.m_queueFamilyIndex) {
+		}
 
-		Sampler(VkSampler sampler, Device device, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(sampler, device, pfnDestroy) {
+		Queue& operator=(const Queue& other) {
+			HandleWithOwner::operator=(other);
+			m_pTimeline = other.m_pTimeline;
+			m_queueFamilyIndex = other.m_queueFamilyIndex;
+			return *this;
 		}
 
-		static void destroy(VkSampler sampler, Device device) {
-			vkDestroySampler(device, sampler, nullptr);
+		//	Every submit then signals the timeline's next value.  One timeline
+		//	per VkQueue, set on the queue before it is copied around;
+		//	the timeline has to outlive the copies.
+		void setTimeline(GpuTimeline* pTimeline) {
+			m_pTimeline = pTimeline;
 		}
 
-	public:
+		GpuTimeline* timeline() const {
+			return m_pTimeline;
+		}
 
-		Sampler() {}
+		void waitIdle() {
+			vkQueueWaitIdle(*this);
+		}
 
-		Sampler(const SamplerCreateInfo& samplerCreateInfo, Device device) {
-			VkSampler vkSampler;
-			VkResult vkResult = vkCreateSampler(device, &samplerCreateInfo, nullptr, &vkSampler);
+
+		//	Several batches in one call, the fence covers them all.
+		//	With a timeline, one more batch signals its next value.  A queue's
+		//	semaphore signal covers everything submitted before it, so the value
+		//	is reached once this and every earlier submit are done.
+		//	Returns the value, 0 without a timeline.
+		uint64_t submit2(uint32_t submitCount, const VkSubmitInfo2* pSubmits, VkFence vkFence) const {
+			s_submitCount.fetch_add(1, std::memory_order_relaxed);
+			if (!m_pTimeline) {
+				VkResult vkResult = vkQueueSubmit2(*this, submitCount, pSubmits, vkFence);
+				if (vkResult != VK_SUCCESS) {
+					throw Exception(vkResult);
+				}
+				return 0;
+			}
+
+			InlineVector<VkSubmitInfo2, 8> vkSubmitInfos;
+			for (uint32_t i = 0; i < submitCount; i++) {
+				vkSubmitInfos.push_back(pSubmits[i]);
+			}
+			const uint64_t value = m_pTimeline->reserveValue();
+			VkSemaphoreSubmitInfo vkSignalSemaphoreInfo{};
+			vkSignalSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			vkSignalSemaphoreInfo.semaphore = m_pTimeline->semaphore();
+			vkSignalSemaphoreInfo.value = value;
+			vkSignalSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			VkSubmitInfo2 vkSignalSubmitInfo{};
+			vkSignalSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+			vkSignalSubmitInfo.signalSemaphoreInfoCount = 1;
+			vkSignalSubmitInfo.pSignalSemaphoreInfos = &vkSignalSemaphoreInfo;
+			vkSubmitInfos.push_back(vkSignalSubmitInfo);
+
+			VkResult vkResult = vkQueueSubmit2(
+				*this, static_cast<uint32_t>(vkSubmitInfos.size()), vkSubmitInfos.data(), vkFence);
 			if (vkResult != VK_SUCCESS) {
 				throw Exception(vkResult);
 			}
-			new(this) Sampler(vkSampler, device, &destroy);
+			m_pTimeline->published(value);
+			return value;
 		}
 
+		uint64_t submit2(CommandBuffer commandBuffer) const {
+			SubmitInfo2 submitInfo2;
+			submitInfo2.addCommandBuffer(commandBuffer);
+			return submit2(1, submitInfo2.assemble(), VK_NULL_HANDLE);
+		}
 
-	};
-
+		uint64_t submit2(CommandBuffer commandBuffer, Fence fence) const {
+			SubmitInfo2 submitInfo2;
+			submitInfo2.addCommandBuffer(commandBuffer);
+			return submit2(1, submitInfo2.assemble(), fence);
+		}
 
-	class ImageMemoryBarrier2 : public VkImageMemoryBarrier2 {
+		uint64_t submit2(SubmitInfo2& submitInfo2) const {
+			return submit2(1, submitInfo2.assemble(), VK_NULL_HANDLE);
+		}
 
-	public:
-		ImageMemoryBarrier2(VkImageLayout oldLayoutArg, VkImageLayout newLayoutArg, VkImage vkImage)
-			:VkImageMemoryBarrier2{} {
-			sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		uint64_t submit2(SubmitInfo2& submitInfo2, Fence fence) const {
+			return submit2(1, submitInfo2.assemble(), fence);
+		}
 
-			oldLayout = oldLayoutArg;
-			newLayout = newLayoutArg;
-			srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			image = vkImage;
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = 1;
-			subresourceRange.baseArrayLayer = 0;
-			subresourceRange.layerCount = 1;
+		//	Submits and waits, on the timeline if the queue has one,
+		//	otherwise on a fence borrowed from the pool.
+		void submit2Fenced(CommandBuffer commandBuffer, SyncObjectPool& syncObjectPool) const {
+			SubmitInfo2 submitInfo2;
+			submitInfo2.addCommandBuffer(commandBuffer);
+			if (m_pTimeline) {
+				m_pTimeline->wait(submit2(1, submitInfo2.assemble(), VK_NULL_HANDLE));
+				return;
+			}
+			Fence completedFence = syncObjectPool.acquireFence();
+			submit2(1, submitInfo2.assemble(), completedFence);
+			completedFence.wait();
+			syncObjectPool.releaseFence(std::move(completedFence));
+		}
 
-			//	If the image memory barrier is to be used in a sequence
-			//	of command buffer commands, then the access masks will need
-			//	to be set according to usage.  (To the best of my current knowledge.)
 
-		}
+		VkResult present(PresentInfo& presentInfo) {
+			VkResult vkResult = vkQueuePresentKHR(*this, presentInfo.assemble());
+			if (vkResult == VK_SUCCESS) {
+				return vkResult;
+			}
+			if (vkResult == VK_SUBOPTIMAL_KHR) {
+				return vkResult;
+			}
 
+			throw Exception(vkResult);
+		}
 	};
 
 
-	static_assert(sizeof(ImageMemoryBarrier2) == sizeof(VkImageMemoryBarrier2));
+	//	Holds on to objects the gpu may still be using until a timeline value
+	//	is reached, then lets them go, instead of waiting for the device to
+	//	go idle just to drop something.  Anything movable can go in, e.g.
+	//	handles, an Image_Memory_View, or a whole vector of framebuffers.
+	//	collect about once a frame; the destructor waits for the rest, so
+	//	it has to go before the device and anything the objects came from.
+	class DeferredDeletionQueue {
 
+		struct Deferred {
+			virtual ~Deferred() {}
+		};
 
-	class DependencyInfo : public VkDependencyInfo {
+		template<typename T>
+		struct DeferredObject : Deferred {
+			T	m_object;
 
-		//	TODO: need to add the other dependency types.
-		std::vector<MemoryBarrier2>			m_memoryBarriers;
-		std::vector<ImageMemoryBarrier2>	m_imageMemoryBarriers;
+			explicit DeferredObject(T&& object)
+				: m_object(std::move(object)) {
+			}
+		};
+
+		struct Entry {
+			uint64_t	m_timelineValue = 0;
+			std::unique_ptr<Deferred>	m_deferred;
+		};
 
+		GpuTimeline*	m_pTimeline = nullptr;
+		std::vector<Entry>	m_entries;
+		std::mutex	m_mutex;
 
 	public:
-		DependencyInfo(const DependencyInfo&) = delete;
-		DependencyInfo& operator=(const DependencyInfo&) = delete;
-		DependencyInfo(DependencyInfo&&) noexcept = delete;
-		DependencyInfo& operator=(DependencyInfo&&) noexcept = delete;
 
-		VkDependencyInfo* operator& () = delete;
+		DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+		DeferredDeletionQueue& operator=(const DeferredDeletionQueue&) = delete;
+		DeferredDeletionQueue(DeferredDeletionQueue&&) = delete;
+		DeferredDeletionQueue& operator=(DeferredDeletionQueue&&) = delete;
 
-		DependencyInfo()
-			: VkDependencyInfo{} {
-			sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		explicit DeferredDeletionQueue(GpuTimeline& timeline)
+			: m_pTimeline(&timeline) {
 		}
 
-		void addImageMemoryBarrier(const ImageMemoryBarrier2& imageMemoryBarrier) {
-			m_imageMemoryBarriers.push_back(imageMemoryBarrier);
+		~DeferredDeletionQueue() {
+			waitAll();
 		}
 
-		void addMemoryBarrier(const MemoryBarrier2& memoryBarrier) {
-			m_memoryBarriers.push_back(memoryBarrier);
+		//	Destroyed once the timeline reaches timelineValue.
+		template<typename T>
+		void destroyAfter(uint64_t timelineValue, T object) {
+			std::unique_ptr<Deferred> deferred = std::make_unique<DeferredObject<T>>(std::move(object));
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_entries.push_back({ timelineValue, std::move(deferred) });
 		}
 
-		VkDependencyInfo* assemble() {
+		//	Destroyed once everything submitted so far is done.
+		template<typename T>
+		void destroyLater(T object) {
+			destroyAfter(m_pTimeline->lastSubmittedValue(), std::move(object));
+		}
 
-			pMemoryBarriers = nullptr;
-			memoryBarrierCount = static_cast<uint32_t>(m_memoryBarriers.size());
-			if (memoryBarrierCount > 0) {
-				pMemoryBarriers = m_memoryBarriers.data();
+		//	Destroys whatever the gpu is done with, returns how many.  Doesn't wait.
+		size_t collect() {
+			std::vector<Entry> retired;		//	Destroyed outside the lock.
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (Entry& entry : m_entries) {
+					if (m_pTimeline->reached(entry.m_timelineValue)) {
+						retired.push_back(std::move(entry));
+					}
+				}
+				std::erase_if(m_entries, [](const Entry& entry) { return !entry.m_deferred; });
 			}
+			return retired.size();
+		}
 
-			pImageMemoryBarriers = nullptr;
-			imageMemoryBarrierCount = static_cast<uint32_t>(m_imageMemoryBarriers.size());
-			if (imageMemoryBarrierCount > 0) {
-				pImageMemoryBarriers = m_imageMemoryBarriers.data();
+		void waitAll() {
+			uint64_t lastValue = 0;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (const Entry& entry : m_entries) {
+					lastValue = std::max(lastValue, entry.m_timelineValue);
+				}
 			}
+			m_pTimeline->wait(lastValue);
+			collect();
+		}
 
-			return this;
+		size_t pendingCount() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_entries.size();
 		}
 
 	};
 
-	//	TODO: should we make some object that has contains a queue and command pool
-	//	and whatever else needed so we don't have to pass the info around as pairs?
-	class CommandPool : public HandleWithOwner<VkCommandPool> {
 
-		CommandPool(VkCommandPool vkCommandPool, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkCommandPool, vkDevice, pfnDestroy) {
-		}
+	//	Collects submits for any number of queues, e.g. a frame's uploads,
+	//	compute and graphics, and flushes them with one vkQueueSubmit2 per
+	//	queue instead of one per subsystem.  Within a queue the submits keep
+	//	the order they were added in.  A submit waiting on a semaphore that
+	//	another added submit signals is held back until that one has gone
+	//	out, so binary semaphores are always signaled before being waited on.
+	//	A call takes only one fence, so a second fenced submit to the same
+	//	queue starts another call.
+	class SubmitBatch {
+
+		struct PendingSubmit {
+			SubmitInfo2	m_submitInfo2;
+			VkFence		m_vkFence = VK_NULL_HANDLE;
+			uint64_t*	m_pTimelineValue = nullptr;
+		};
 
-		static void destroy(VkCommandPool vkCommandPool, VkDevice vkDevice) {
-			vkDestroyCommandPool(vkDevice, vkCommandPool, nullptr);
+		struct QueueSubmits {
+			Queue	m_queue;
+			std::vector<PendingSubmit>	m_pending;
+			size_t	m_flushedCount = 0;
+		};
+
+		//	Kept across flushes with their capacity, so a steady frame
+		//	doesn't allocate.  In the order the queues were first added.
+		std::vector<QueueSubmits>	m_queueSubmits;
+		std::vector<VkSubmitInfo2>	m_vkSubmitInfos;	//	Scratch for one call.
+		InlineVector<VkSemaphore, 16>	m_unsubmittedSignals;	//	Scratch for flush.
+
+		bool isUnsubmittedSignal(VkSemaphore vkSemaphore) const {
+			return std::find(m_unsubmittedSignals.begin(), m_unsubmittedSignals.end(), vkSemaphore)
+				!= m_unsubmittedSignals.end();
 		}
 
+		void clearPending() {
+			for (QueueSubmits& queueSubmits : m_queueSubmits) {
+				queueSubmits.m_pending.clear();
+				queueSubmits.m_flushedCount = 0;
+			}
+		}
 
 	public:
 
-		CommandPool() {}
-		CommandPool(const VkCommandPoolCreateInfo& commandPoolCreateInfo, VkDevice vkDevice) {
-			VkCommandPool vkCommandPool;
-			VkResult vkResult = vkCreateCommandPool(
-				vkDevice,
-				&commandPoolCreateInfo,
-				nullptr,
-				&vkCommandPool);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		SubmitBatch() {}
+
+		SubmitBatch(const SubmitBatch&) = delete;
+		SubmitBatch& operator=(const SubmitBatch&) = delete;
+
+		//	With a timeline on the queue, flush writes the value that covers
+		//	the submit to *pTimelineValue, which has to stay put until then.
+		void add(
+			Queue queue,
+			SubmitInfo2&& submitInfo2,
+			VkFence vkFence = VK_NULL_HANDLE,
+			uint64_t* pTimelineValue = nullptr
+		) {
+			auto found = std::find_if(m_queueSubmits.begin(), m_queueSubmits.end(),
+				[&queue](const QueueSubmits& queueSubmits) {
+					return static_cast<VkQueue>(queueSubmits.m_queue) == static_cast<VkQueue>(queue);
+				});
+			if (found == m_queueSubmits.end()) {
+				m_queueSubmits.push_back({ queue });
+				found = m_queueSubmits.end() - 1;
 			}
-			new(this)CommandPool(vkCommandPool, vkDevice, &destroy);
+			found->m_pending.push_back({ std::move(submitInfo2), vkFence, pTimelineValue });
 		}
 
-		CommandPool(
-			VkCommandPoolCreateFlags	vkCommandPoolCreateFlags,
-			uint32_t					queueFamilyIndex,
-			VkDevice					vkDevice
+		void add(
+			Queue queue,
+			CommandBuffer commandBuffer,
+			VkFence vkFence = VK_NULL_HANDLE,
+			uint64_t* pTimelineValue = nullptr
 		) {
-			VkCommandPoolCreateInfo commandPoolCreateInfo{};
-			commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			commandPoolCreateInfo.flags = vkCommandPoolCreateFlags;
-			commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
-			new(this)CommandPool(commandPoolCreateInfo, vkDevice);
+			SubmitInfo2 submitInfo2;
+			submitInfo2.addCommandBuffer(commandBuffer);
+			add(queue, std::move(submitInfo2), vkFence, pTimelineValue);
+		}
+
+		bool empty() const {
+			return std::all_of(m_queueSubmits.begin(), m_queueSubmits.end(),
+				[](const QueueSubmits& queueSubmits) { return queueSubmits.m_pending.empty(); });
+		}
+
+		//	Returns the number of vkQueueSubmit2 calls it took.
+		uint32_t flush() {
+			//	Semaphores some added submit signals and that haven't gone out yet.
+			//	Only a few per frame, a linear search beats hashing them.
+			m_unsubmittedSignals.clear();
+			for (const QueueSubmits& queueSubmits : m_queueSubmits) {
+				for (const PendingSubmit& pendingSubmit : queueSubmits.m_pending) {
+					for (const VkSemaphoreSubmitInfo& signal : pendingSubmit.m_submitInfo2.signalSemaphoreInfos()) {
+						if (!isUnsubmittedSignal(signal.semaphore)) {
+							m_unsubmittedSignals.push_back(signal.semaphore);
+						}
+					}
+				}
+			}
 
-		}
+			uint32_t callCount = 0;
+			bool remaining = !empty();
+			while (remaining) {
+				remaining = false;
+				bool progressed = false;
+				for (QueueSubmits& queueSubmits : m_queueSubmits) {
+					//	The longest run that can go now.  Signals from earlier
+					//	in the run count, the batches are ordered within a call.
+					size_t end = queueSubmits.m_flushedCount;
+					VkFence vkFence = VK_NULL_HANDLE;
+					while (end < queueSubmits.m_pending.size()) {
+						PendingSubmit& pendingSubmit = queueSubmits.m_pending[end];
+						const SubmitInfo2::SemaphoreInfos_t& waits = pendingSubmit.m_submitInfo2.waitSemaphoreInfos();
+						if (std::any_of(waits.begin(), waits.end(), [this](const VkSemaphoreSubmitInfo& wait) {
+							return isUnsubmittedSignal(wait.semaphore);
+							})) {
+							break;
+						}
+						if (pendingSubmit.m_vkFence != VK_NULL_HANDLE) {
+							if (vkFence != VK_NULL_HANDLE) {
+								break;
+							}
+							vkFence = pendingSubmit.m_vkFence;
+						}
+						for (const VkSemaphoreSubmitInfo& signal : pendingSubmit.m_submitInfo2.signalSemaphoreInfos()) {
+							auto found = std::find(m_unsubmittedSignals.begin(), m_unsubmittedSignals.end(), signal.semaphore);
+							if (found != m_unsubmittedSignals.end()) {
+								*found = m_unsubmittedSignals.back();
+								m_unsubmittedSignals.pop_back();
+							}
+						}
+						end++;
+					}
+
+					if (end > queueSubmits.m_flushedCount) {
+						m_vkSubmitInfos.clear();
+						for (size_t i = queueSubmits.m_flushedCount; i < end; i++) {
+							m_vkSubmitInfos.push_back(*queueSubmits.m_pending[i].m_submitInfo2.assemble());
+						}
+						const uint64_t timelineValue = queueSubmits.m_queue.submit2(
+							static_cast<uint32_t>(m_vkSubmitInfos.size()), m_vkSubmitInfos.data(), vkFence);
+						for (size_t i = queueSubmits.m_flushedCount; i < end; i++) {
+							if (queueSubmits.m_pending[i].m_pTimelineValue) {
+								*queueSubmits.m_pending[i].m_pTimelineValue = timelineValue;
+							}
+						}
+						queueSubmits.m_flushedCount = end;
+						callCount++;
+						progressed = true;
+					}
+					if (queueSubmits.m_flushedCount < queueSubmits.m_pending.size()) {
+						remaining = true;
+					}
+				}
+				if (remaining && !progressed) {
+					clearPending();
+					throw Exception("SubmitBatch: submits wait on each other");
+				}
+			}
 
+			clearPending();
+			return callCount;
+		}
 
 	};
 
-	class CommandBuffer : public HandleWithOwner<VkCommandBuffer, CommandPool> {
 
-		static void destroy(VkCommandBuffer vkCommandBuffer, CommandPool commandPool) {
-			vkFreeCommandBuffers(commandPool.getVkDevice(), commandPool, 1, &vkCommandBuffer);
-		}
+	//	Compute work on a queue of its own, usually an async compute family,
+	//	so it runs alongside the graphics queue instead of in front of it.
+	//	One command buffer per drawing frame: begin hands it out, submit sends
+	//	it straight away on the compute queue's timeline, and addWait makes the
+	//	graphics submit that uses the results wait for that value, at the
+	//	stage that first reads them.  Buffers and images going from one family
+	//	to the other still need release and acquire barriers from the caller.
+	class AsyncComputeScheduler {
+
+		struct Frame {
+			TransientCommandAllocator	m_commandAllocator;
+			CommandBuffer	m_commandBuffer;
+			uint64_t	m_submittedValue = 0;	//	The frame's command buffer is free once reached.
+			uint64_t	m_unwaitedValue = 0;	//	Submitted, no graphics submit waits on it yet.
+		};
 
-		CommandBuffer(
-			VkCommandBuffer vkCommandBuffer,
-			CommandPool commandPool,
-			DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkCommandBuffer, commandPool, pfnDestroy) {
-		}
+		Queue	m_queue;
+		std::vector<Frame>	m_frames;
 
 	public:
 
-		CommandBuffer() {}
-
-		CommandBuffer(CommandPool commandPool) {
-			VkCommandBufferAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			allocInfo.commandPool = commandPool;
-			allocInfo.commandBufferCount = 1;
-			VkCommandBuffer vkCommandBuffer;
-			vkAllocateCommandBuffers(commandPool.getVkDevice(), &allocInfo, &vkCommandBuffer);
-			new(this) CommandBuffer(vkCommandBuffer, commandPool, &destroy);
-		}
-
+		AsyncComputeScheduler() {}
 
-		void reset() {
-			VkResult vkResult = vkResetCommandBuffer(*this, 0);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		AsyncComputeScheduler(Queue queue, uint32_t drawingFrameCount, VkDevice vkDevice)
+			: m_queue(queue)
+			, m_frames(drawingFrameCount) {
+			if (!m_queue.timeline()) {
+				throw Exception("AsyncComputeScheduler: the queue needs a timeline");
 			}
-		}
-
-		void begin() {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-			VkResult vkResult = vkBeginCommandBuffer(*this, &beginInfo);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+			for (Frame& frame : m_frames) {
+				frame.m_commandAllocator = TransientCommandAllocator(m_queue.m_queueFamilyIndex, vkDevice);
 			}
 		}
 
+		AsyncComputeScheduler(const AsyncComputeScheduler&) = delete;
+		AsyncComputeScheduler& operator=(const AsyncComputeScheduler&) = delete;
+		AsyncComputeScheduler(AsyncComputeScheduler&&) = default;
+		AsyncComputeScheduler& operator=(AsyncComputeScheduler&&) = default;
 
-		void beginOneTimeSubmit() {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-			vkBeginCommandBuffer(*this, &beginInfo);
-		}
-
-		void end() {
-			VkResult vkResult = vkEndCommandBuffer(*this);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
-
+		explicit operator bool() const {
+			return !m_frames.empty();
 		}
 
-		void cmdCopyBufferToImage(
-			Buffer buffer,
-			Image image,
-			uint32_t	width,
-			uint32_t	height
-		) {
-			VkBufferImageCopy region{};
-			region.bufferOffset = 0;
-			region.bufferRowLength = 0;
-			region.bufferImageHeight = 0;
-			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			region.imageSubresource.mipLevel = 0;
-			region.imageSubresource.baseArrayLayer = 0;
-			region.imageSubresource.layerCount = 1;
-			region.imageOffset = { 0, 0, 0 };
-			region.imageExtent = {
-				width,
-				height,
-				1
-			};
-
-			vkCmdCopyBufferToImage(*this, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		Queue queue() const {
+			return m_queue;
 		}
 
-		//	TODO: do we need to implement cmdCopyBuffer2?
-		void cmdCopyBuffer(
-			Buffer	srcBuffer,
-			Buffer	dstBuffer,
-			VkDeviceSize	size
-		) {
-			//	TODO: maybe do some size checking on the destination to avoid overwriting.
-			VkBufferCopy	vkBufferCopy{ .srcOffset = 0, .dstOffset = 0, .size = size };
-
-			vkCmdCopyBuffer(*this, srcBuffer, dstBuffer, 1, &vkBufferCopy);
+		uint32_t queueFamilyIndex() const {
+			return m_queue.m_queueFamilyIndex;
 		}
 
-		void cmdCopyBuffer(
-			Buffer	srcBuffer,
-			Buffer	dstBuffer
-		) {
-			cmdCopyBuffer(srcBuffer, dstBuffer, srcBuffer.size());
+		//	Begun for one time submit.  Waits for the frame's last submit,
+		//	which a graphics submit waiting on it has usually covered already.
+		CommandBuffer begin(uint32_t drawingFrameIndex) {
+			Frame& frame = m_frames[drawingFrameIndex];
+			m_queue.timeline()->wait(frame.m_submittedValue);
+			frame.m_commandAllocator.reset();
+			frame.m_commandBuffer = frame.m_commandAllocator.allocate();
+			frame.m_commandBuffer.beginOneTimeSubmit();
+			return frame.m_commandBuffer;
 		}
 
-		void cmdPipelineBarrier2(
-			DependencyInfo& dependencyInfo
-		) {
-			vkCmdPipelineBarrier2(*this, dependencyInfo.assemble());
+		//	Returns the compute timeline value that covers it.
+		uint64_t submit(uint32_t drawingFrameIndex) {
+			Frame& frame = m_frames[drawingFrameIndex];
+			frame.m_commandBuffer.end();
+			frame.m_submittedValue = m_queue.submit2(frame.m_commandBuffer);
+			frame.m_unwaitedValue = frame.m_submittedValue;
+			return frame.m_submittedValue;
 		}
 
-		void cmdBeginRenderPass(const VkRenderPassBeginInfo& vkRenderPassBeginInfo) {
-			vkCmdBeginRenderPass(*this, &vkRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		//	Adds nothing, and returns false, if nothing was submitted for
+		//	the frame since the last wait was added.
+		bool addWait(SubmitInfo2& submitInfo2, uint32_t drawingFrameIndex, PipelineStageFlags2 waitPipelineStageFlags2) {
+			Frame& frame = m_frames[drawingFrameIndex];
+			if (frame.m_unwaitedValue == 0) {
+				return false;
+			}
+			submitInfo2.addWaitSemaphore(m_queue.timeline()->semaphore(), frame.m_unwaitedValue, waitPipelineStageFlags2);
+			frame.m_unwaitedValue = 0;
+			return true;
 		}
 
-		void cmdEndRenderPass() {
-			vkCmdEndRenderPass(*this);
-		}
+	};
 
-		void cmdSetViewport(
-			VkExtent2D vkExtent2D
-		) {
-			VkViewport viewport{};
-			viewport.x = 0.0f;
-			viewport.y = 0.0f;
-			viewport.width = static_cast<float>(vkExtent2D.width);
-			viewport.height = static_cast<float>(vkExtent2D.height);
-			viewport.minDepth = 0.0f;
-			viewport.maxDepth = 1.0f;
-			vkCmdSetViewport(*this, 0, 1, &viewport);
-		}
 
-		void cmdSetScissor(
-			VkExtent2D vkExtent2D
-		) {
-			VkRect2D scissor{};
-			scissor.offset = { 0, 0 };
-			scissor.extent = vkExtent2D;
-			vkCmdSetScissor(*this, 0, 1, &scissor);
-		}
+	//	Records the staging copies and layout transitions for many uploads
+	//	into one command buffer so they cost one submit and one wait
+	//	instead of a fenced submit per step.
+	//	Staging memory comes from the arena and is held until the submission completes.
+	//	submit can be called repeatedly while more uploads are being added, so
+	//	copies stream out behind whatever is producing the data; wait covers them all.
+	//	Given a separate owner queue (e.g. a transfer-only family feeding graphics),
+	//	the copies run on the upload queue and ownership is released to the owner
+	//	family, which acquires it in a small command buffer that waits on a semaphore.
+	//	Rendering only waits for the acquire, not for the copies.
+	//	Images with more than one level get their mip chain blitted from level 0
+	//	on the owner queue (the upload queue if there isn't one), which needs graphics.
+	class UploadBatch {
 
-		void cmdBindPipeline(
-			VkPipeline vkPipeline
-		) {
-			vkCmdBindPipeline(*this, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipeline);
-		}
+	public:
 
-		void cmdBindDescriptorSet(
-			VkPipelineLayout vkPipelineLayout,
-			VkDescriptorSet vkDescriptorSet
-		) {
-			vkCmdBindDescriptorSets(*this, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				vkPipelineLayout, 0, 1, &vkDescriptorSet, 0, nullptr);
+		struct Stats {
+			VkDeviceSize	m_bytesUploaded = 0;
+			uint32_t		m_imageCount = 0;
+			uint32_t		m_bufferCount = 0;
+			uint32_t		m_submitCount = 0;
+			std::chrono::duration<double>	m_duration{};		//	First add to gpu completion.
+			std::chrono::duration<double>	m_gpuWaitDuration{};	//	Time blocked in wait.
+			bool	m_ownershipTransferred = false;
+		};
 
-		}
+	private:
 
-	};
+		struct ImageUpload {
+			Image		m_image;	//	For its state, the batch doesn't own it.
+			VkBuffer	m_vkStagingBuffer = nullptr;
+			uint32_t	m_width = 0;
+			uint32_t	m_height = 0;
+			uint32_t	m_mipLevels = 1;
+			std::vector<VkDeviceSize>	m_levelOffsets;	//	Empty when only level 0 is staged.
 
+			bool needsBlits() const {
+				return m_mipLevels > 1 && m_levelOffsets.empty();
+			}
 
+			uint32_t stagedLevels() const {
+				return m_levelOffsets.empty() ? 1 : m_mipLevels;
+			}
+		};
 
-	class SubmitInfo2 : public VkSubmitInfo2 {
+		struct BufferUpload {
+			VkBuffer	m_vkDstBuffer = nullptr;
+			VkBuffer	m_vkStagingBuffer = nullptr;
+			VkDeviceSize	m_size = 0;
+		};
 
-		std::vector<VkSemaphoreSubmitInfo>		m_waitSemaphoreInfos;
-		std::vector<VkCommandBufferSubmitInfo>	m_commandBufferInfos;
-		std::vector<VkSemaphoreSubmitInfo>		m_signalSemaphoreInfos;
+		//	Everything the gpu may still be using from one submit.
+		//	The command buffers belong to the allocators.
+		struct Submission {
+			CommandBuffer	m_commandBuffer;
+			CommandBuffer	m_acquireCommandBuffer;
+			Semaphore		m_copiesCompleteSemaphore;
+			//	Done at this value of the completing queue's timeline, or,
+			//	without one, when the fence opens.  0 until it has gone out.
+			uint64_t		m_timelineValue = 0;
+			Fence			m_completedFence;
+			std::vector<Buffer_DeviceMemory>	m_stagingBuffers;
+			uint64_t		m_serial = 0;
+		};
 
+		DeviceMemoryArena* m_pDeviceMemoryArena = nullptr;
+		Queue			m_queue;
+		Queue			m_ownerQueue;
+		//	Reset whenever no submission is outstanding.
+		TransientCommandAllocator	m_commandAllocator;
+		TransientCommandAllocator	m_ownerCommandAllocator;
 
-	public:
+		//	Added but not yet submitted.
+		std::vector<Buffer_DeviceMemory>	m_stagingBuffers;
+		std::vector<ImageUpload>	m_imageUploads;
+		std::vector<BufferUpload>	m_bufferUploads;
+		VkDeviceSize	m_pendingBytes = 0;
 
-		SubmitInfo2()
-			: VkSubmitInfo2{} {
-			sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-		}
+		//	A list so a submit batch can fill in m_timelineValue when it flushes.
+		std::list<Submission>	m_submissions;
+		uint64_t	m_lastSerial = 0;
 
-		SubmitInfo2* operator&() = delete;
+		SubmitBatch*	m_pSubmitBatch = nullptr;
+		SyncObjectPool*	m_pSyncObjectPool = nullptr;
 
-		void addCommandBuffer(CommandBuffer commandBuffer) {
-			VkCommandBufferSubmitInfo	vkCommandBufferSubmitInfo{};
-			vkCommandBufferSubmitInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-			vkCommandBufferSubmitInfo.commandBuffer = commandBuffer;
-			m_commandBufferInfos.push_back(vkCommandBufferSubmitInfo);
-		}
+		Stats	m_stats;
+		bool	m_started = false;
+		std::chrono::high_resolution_clock::time_point	m_startTime;
 
-		void addWaitSemaphore(
-			Semaphore semaphore,
-			PipelineStageFlags2 waitPipelineStateFlags2
 
-			//			VkPipelineStageFlags2 waitPipelineStateFlags2
-		) {
-			VkSemaphoreSubmitInfo	vkSemaphoreSubmitInfo{};
-			vkSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-			vkSemaphoreSubmitInfo.semaphore = semaphore;
-			vkSemaphoreSubmitInfo.stageMask = static_cast<VkPipelineStageFlagBits2>(waitPipelineStateFlags2);
-			m_waitSemaphoreInfos.push_back(vkSemaphoreSubmitInfo);
+		Buffer stage(Buffer_DeviceMemory&& stagingBuffer, VkDeviceSize size) {
+			if (!m_started) {
+				m_started = true;
+				m_startTime = std::chrono::high_resolution_clock::now();
+			}
+			m_stagingBuffers.push_back(std::move(stagingBuffer));
+			m_pendingBytes += size;
+			m_stats.m_bytesUploaded += size;
+			return m_stagingBuffers.back().m_buffer;
 		}
 
-		void addSignalSemaphore(Semaphore semaphore) {
-			VkSemaphoreSubmitInfo	vkSemaphoreSubmitInfo{};
-			vkSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-			vkSemaphoreSubmitInfo.semaphore = semaphore;
-			m_signalSemaphoreInfos.push_back(vkSemaphoreSubmitInfo);
+		Buffer stage(const void* pSrcMem, VkDeviceSize size) {
+			Buffer_DeviceMemory stagingBuffer = createStagingBuffer(size);
+			memcpy(stagingBuffer.m_mappedMemory, pSrcMem, size);
+			return stage(std::move(stagingBuffer), size);
 		}
 
+		void resetCommandAllocators() {
+			m_commandAllocator.reset();
+			if (m_ownerCommandAllocator) {
+				m_ownerCommandAllocator.reset();
+			}
+		}
 
-		SubmitInfo2* assemble() {
+		Fence acquireFence() {
+			return m_pSyncObjectPool ? m_pSyncObjectPool->acquireFence() : Fence(m_queue.getVkDevice());
+		}
 
-			pWaitSemaphoreInfos = nullptr;
-			waitSemaphoreInfoCount = static_cast<uint32_t>(m_waitSemaphoreInfos.size());
-			if (waitSemaphoreInfoCount > 0) {
-				pWaitSemaphoreInfos = m_waitSemaphoreInfos.data();
+		//	Whichever queue runs the submission's last command buffer.
+		Queue completingQueue() const {
+			return transfersOwnership() ? m_ownerQueue : m_queue;
+		}
+
+		bool submissionCompleted(const Submission& submission) const {
+			if (submission.m_completedFence) {
+				return submission.m_completedFence.signaled();
 			}
+			return submission.m_timelineValue != 0
+				&& completingQueue().timeline()->reached(submission.m_timelineValue);
+		}
 
-			pCommandBufferInfos = nullptr;
-			commandBufferInfoCount = static_cast<uint32_t>(m_commandBufferInfos.size());
-			if (commandBufferInfoCount > 0) {
-				pCommandBufferInfos = m_commandBufferInfos.data();
+		//	A batched submission has to have been flushed.
+		void waitSubmission(Submission& submission) {
+			if (submission.m_completedFence) {
+				submission.m_completedFence.wait();
+			}
+			else if (submission.m_timelineValue != 0) {
+				completingQueue().timeline()->wait(submission.m_timelineValue);
 			}
+		}
 
-			pSignalSemaphoreInfos = nullptr;
-			signalSemaphoreInfoCount = static_cast<uint32_t>(m_signalSemaphoreInfos.size());
-			if (signalSemaphoreInfoCount > 0) {
-				pSignalSemaphoreInfos = m_signalSemaphoreInfos.data();
+		Semaphore acquireSemaphore() {
+			return m_pSyncObjectPool ? m_pSyncObjectPool->acquireSemaphore() : Semaphore(m_queue.getVkDevice());
+		}
+
+		//	The submission's fence is open, so its semaphore wait is done too.
+		void releaseSyncObjects(Submission& submission) {
+			if (m_pSyncObjectPool) {
+				m_pSyncObjectPool->releaseFence(std::move(submission.m_completedFence));
+				m_pSyncObjectPool->releaseSemaphore(std::move(submission.m_copiesCompleteSemaphore));
 			}
+		}
 
-			return this;
+		bool transfersOwnership() const {
+			return m_ownerQueue && m_ownerQueue.m_queueFamilyIndex != m_queue.m_queueFamilyIndex;
 		}
 
-	};
+		//	Within one family release is the whole barrier and acquire stays
+		//	empty.  Across families release gets the src half for the upload
+		//	queue and acquire the dst half for the owner queue.
+		//	Mipped images only hand over level 0, ready to blit from;
+		//	recordMipChains does the rest.
+		void addHandOffBarriers(DependencyInfo& release, DependencyInfo& acquire) const {
+			const bool crossFamily = transfersOwnership();
 
-	class PresentInfo : public VkPresentInfoKHR {
+			for (const ImageUpload& imageUpload : m_imageUploads) {
+				const bool mipped = imageUpload.needsBlits();
+				if (mipped && !crossFamily) {
+					continue;	//	The first blit barrier covers the copy.
+				}
+				const ImageUsage imageUsage = mipped ? ImageUsage::BLIT_SRC : ImageUsage::SAMPLED_FRAGMENT;
+				if (crossFamily) {
+					release.addImageOwnershipTransfer(
+						acquire, imageUpload.m_image, imageUsage,
+						m_queue.m_queueFamilyIndex, m_ownerQueue.m_queueFamilyIndex,
+						0, imageUpload.stagedLevels());
+				}
+				else {
+					release.addImageTransition(imageUpload.m_image, imageUsage, 0, imageUpload.stagedLevels());
+				}
+			}
+			const VkPipelineStageFlags2 bufferDstStages =
+				VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+			const VkAccessFlags2 bufferDstAccess =
+				VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+			for (const BufferUpload& bufferUpload : m_bufferUploads) {
+				if (!crossFamily) {
+					release.addBufferMemoryBarrier(BufferMemoryBarrier2(
+						bufferUpload.m_vkDstBuffer,
+						VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+						bufferDstStages, bufferDstAccess));
+					continue;
+				}
+				release.addBufferMemoryBarrier(BufferMemoryBarrier2(
+					bufferUpload.m_vkDstBuffer,
+					VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+					VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE)
+					.setQueueFamilies(m_queue.m_queueFamilyIndex, m_ownerQueue.m_queueFamilyIndex));
+				acquire.addBufferMemoryBarrier(BufferMemoryBarrier2(
+					bufferUpload.m_vkDstBuffer,
+					VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+					bufferDstStages, bufferDstAccess)
+					.setQueueFamilies(m_queue.m_queueFamilyIndex, m_ownerQueue.m_queueFamilyIndex));
+			}
+		}
 
-		//	TODO: modify to handle more semaphores?
-		VkSemaphore	m_vkSemaphoreWait = nullptr;
-		VkSwapchainKHR	m_vkSwapchain = nullptr;
-		uint32_t		m_swapchainImageIndex = 0;
+		//	Each level is blitted from the one above it, with every image
+		//	advancing a level at a time so each step costs one barrier.
+		//	Level 0 starts written by the copy, or already handed over as a
+		//	blit source; the rest start untouched.  All end up sampled.
+		void recordMipChains(CommandBuffer& commandBuffer) const {
+			uint32_t maxMipLevels = 1;
+			for (const ImageUpload& imageUpload : m_imageUploads) {
+				if (imageUpload.needsBlits()) {
+					maxMipLevels = std::max(maxMipLevels, imageUpload.m_mipLevels);
+				}
+			}
+			if (maxMipLevels == 1) {
+				return;
+			}
 
-	public:
+			for (uint32_t level = 1; level < maxMipLevels; level++) {
+				DependencyInfo toBlit;
+				for (const ImageUpload& imageUpload : m_imageUploads) {
+					if (!imageUpload.needsBlits() || imageUpload.m_mipLevels <= level) {
+						continue;
+					}
+					toBlit.addImageTransition(imageUpload.m_image, ImageUsage::BLIT_SRC, level - 1, 1);
+					toBlit.addImageTransition(imageUpload.m_image, ImageUsage::BLIT_DST, level, 1, true);
+				}
+				commandBuffer.cmdPipelineBarrier2(toBlit);
+
+				for (const ImageUpload& imageUpload : m_imageUploads) {
+					if (!imageUpload.needsBlits() || imageUpload.m_mipLevels <= level) {
+						continue;
+					}
+					const int32_t srcWidth = std::max(1u, imageUpload.m_width >> (level - 1));
+					const int32_t srcHeight = std::max(1u, imageUpload.m_height >> (level - 1));
+					const int32_t dstWidth = std::max(1u, imageUpload.m_width >> level);
+					const int32_t dstHeight = std::max(1u, imageUpload.m_height >> level);
+
+					VkImageBlit2 vkImageBlit2{};
+					vkImageBlit2.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2;
+					vkImageBlit2.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+					vkImageBlit2.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+					vkImageBlit2.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+					vkImageBlit2.dstOffsets[1] = { dstWidth, dstHeight, 1 };
+
+					VkBlitImageInfo2 vkBlitImageInfo2{};
+					vkBlitImageInfo2.sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2;
+					vkBlitImageInfo2.srcImage = imageUpload.m_image;
+					vkBlitImageInfo2.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					vkBlitImageInfo2.dstImage = imageUpload.m_image;
+					vkBlitImageInfo2.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					vkBlitImageInfo2.regionCount = 1;
+					vkBlitImageInfo2.pRegions = &vkImageBlit2;
+					vkBlitImageInfo2.filter = VK_FILTER_LINEAR;
+					vkCmdBlitImage2(commandBuffer, &vkBlitImageInfo2);
+				}
+			}
 
-		PresentInfo()
-			: VkPresentInfoKHR{} {
-			sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			//	The last level was written by its blit, the others read by the
+			//	next one, so that is two barriers an image.
+			DependencyInfo toShaderRead;
+			for (const ImageUpload& imageUpload : m_imageUploads) {
+				if (imageUpload.needsBlits()) {
+					toShaderRead.addImageTransition(imageUpload.m_image, ImageUsage::SAMPLED_FRAGMENT);
+				}
+			}
+			commandBuffer.cmdPipelineBarrier2(toShaderRead);
 		}
 
-		PresentInfo* operator&() = delete;
+		void record(Submission& submission) {
+			CommandBuffer& commandBuffer = submission.m_commandBuffer;
+			commandBuffer = m_commandAllocator.allocate();
+			commandBuffer.beginOneTimeSubmit();
 
-		void addWaitSemaphore(vkcpp::Semaphore semaphore) {
-			m_vkSemaphoreWait = semaphore;
-		}
+			//	All the staged levels go to transfer dst in one barrier, the
+			//	others wait for their blits...
+			if (!m_imageUploads.empty()) {
+				DependencyInfo toTransferDst;
+				for (const ImageUpload& imageUpload : m_imageUploads) {
+					toTransferDst.addImageTransition(
+						imageUpload.m_image, ImageUsage::TRANSFER_DST, 0, imageUpload.stagedLevels(), true);
+				}
+				if (!toTransferDst.empty()) {
+					commandBuffer.cmdPipelineBarrier2(toTransferDst);
+				}
+			}
 
-		void addSwapchain(
-			VkSwapchainKHR vkSwapchain,
-			int	swapchainImageIndex
-		) {
-			m_vkSwapchain = vkSwapchain;
-			m_swapchainImageIndex = static_cast<uint32_t>(swapchainImageIndex);
-		}
+			//	...then all the copies...
+			for (const ImageUpload& imageUpload : m_imageUploads) {
+				const uint32_t stagedLevels = imageUpload.stagedLevels();
+				std::vector<VkBufferImageCopy> regions(stagedLevels);
+				for (uint32_t level = 0; level < stagedLevels; level++) {
+					VkBufferImageCopy& region = regions[level];
+					region.bufferOffset = imageUpload.m_levelOffsets.empty() ? 0 : imageUpload.m_levelOffsets[level];
+					region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.layerCount = 1;
+					region.imageExtent = {
+						std::max(1u, imageUpload.m_width >> level),
+						std::max(1u, imageUpload.m_height >> level),
+						1 };
+				}
+				vkCmdCopyBufferToImage(
+					commandBuffer,
+					imageUpload.m_vkStagingBuffer,
+					imageUpload.m_image,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(regions.size()),
+					regions.data());
+			}
+			for (const BufferUpload& bufferUpload : m_bufferUploads) {
+				VkBufferCopy vkBufferCopy{ .srcOffset = 0, .dstOffset = 0, .size = bufferUpload.m_size };
+				vkCmdCopyBuffer(commandBuffer, bufferUpload.m_vkStagingBuffer, bufferUpload.m_vkDstBuffer, 1, &vkBufferCopy);
+			}
 
-		VkPresentInfoKHR* assemble() {
-			pWaitSemaphores = nullptr;	//	Hygiene
-			if (m_vkSemaphoreWait) {
-				waitSemaphoreCount = 1;
-				pWaitSemaphores = &m_vkSemaphoreWait;
+			//	...and one barrier to make everything readable by shaders,
+			//	or, across families, the release half of the ownership transfer.
+			DependencyInfo toShaderRead;
+			DependencyInfo acquire;
+			addHandOffBarriers(toShaderRead, acquire);
+			if (!toShaderRead.empty()) {
+				commandBuffer.cmdPipelineBarrier2(toShaderRead);
 			}
 
-			pSwapchains = nullptr;
-			pImageIndices = nullptr;
-			if (m_vkSwapchain) {
-				swapchainCount = 1;
-				pSwapchains = &m_vkSwapchain;
-				pImageIndices = &m_swapchainImageIndex;
+			if (!transfersOwnership()) {
+				recordMipChains(commandBuffer);
 			}
 
-			pResults = nullptr;
+			commandBuffer.end();
 
-			return this;
+			if (transfersOwnership()) {
+				CommandBuffer& acquireCommandBuffer = submission.m_acquireCommandBuffer;
+				acquireCommandBuffer = m_ownerCommandAllocator.allocate();
+				acquireCommandBuffer.beginOneTimeSubmit();
+				acquireCommandBuffer.cmdPipelineBarrier2(acquire);
+				recordMipChains(acquireCommandBuffer);
+				acquireCommandBuffer.end();
+			}
 		}
 
-	};
+	public:
 
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+		UploadBatch(UploadBatch&&) = delete;
+		UploadBatch& operator=(UploadBatch&&) = delete;
 
+		//	The batch records from its own transient pools on the queues' families.
+		UploadBatch(
+			DeviceMemoryArena& deviceMemoryArena,
+			Queue queue
+		)
+			: m_pDeviceMemoryArena(&deviceMemoryArena)
+			, m_queue(queue)
+			, m_commandAllocator(queue.m_queueFamilyIndex, queue.getVkDevice()) {
+		}
 
-	class Queue : public HandleWithOwner<VkQueue, Device> {
+		//	Copies run on uploadQueue, the resources end up owned by ownerQueue's family.
+		//	Same family is fine too, it then behaves like the single queue batch.
+		UploadBatch(
+			DeviceMemoryArena& deviceMemoryArena,
+			Queue uploadQueue,
+			Queue ownerQueue
+		)
+			: m_pDeviceMemoryArena(&deviceMemoryArena)
+			, m_queue(uploadQueue)
+			, m_ownerQueue(ownerQueue)
+			, m_commandAllocator(uploadQueue.m_queueFamilyIndex, uploadQueue.getVkDevice()) {
+			if (transfersOwnership()) {
+				m_ownerCommandAllocator = TransientCommandAllocator(ownerQueue.m_queueFamilyIndex, ownerQueue.getVkDevice());
+			}
+		}
 
-	public:
+		~UploadBatch() {
+			if (m_pSubmitBatch) {
+				m_pSubmitBatch->flush();
+			}
+			//	Can't free staging memory or the command buffers while the gpu uses them.
+			for (Submission& submission : m_submissions) {
+				waitSubmission(submission);
+				releaseSyncObjects(submission);
+			}
+		}
 
-		uint32_t	m_queueFamilyIndex = 0;
+		DeviceMemoryArena& deviceMemoryArena() {
+			return *m_pDeviceMemoryArena;
+		}
 
-		Queue() {}
+		//	submit then only adds to the submit batch, which goes out with the
+		//	rest of the frame's submits.  wait flushes it first.  The submit
+		//	batch has to outlive this one.
+		void setSubmitBatch(SubmitBatch* pSubmitBatch) {
+			m_pSubmitBatch = pSubmitBatch;
+		}
 
-		//	Queues always come from the device and are never (explicitly) destroyed
-		Queue(VkQueue vkQueue, uint32_t queueFamilyIndex, Device device)
-			: HandleWithOwner(vkQueue, device, nullptr)
-			, m_queueFamilyIndex(queueFamilyIndex) {
+		//	Fences and semaphores then come from the pool and go back to it
+		//	as submissions retire, instead of being created for each submit.
+		//	The pool has to outlive this batch.
+		void setSyncObjectPool(SyncObjectPool* pSyncObjectPool) {
+			m_pSyncObjectPool = pSyncObjectPool;
 		}
 
-		Queue(const Queue& other)
-			: HandleWithOwner(other)
-			, m_queueFamilyIndex(other.m_queueFamilyIndex) {
+		//	Mapped staging memory for one upload.  Only touches the arena,
+		//	so any thread can call it and fill the memory, e.g. decoding straight into it.
+		Buffer_DeviceMemory createStagingBuffer(VkDeviceSize size) const {
+			return Buffer_DeviceMemory(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				size,
+				m_queue.m_queueFamilyIndex,
+				MEMORY_PROPERTY_HOST_VISIBLE | MEMORY_PROPERTY_HOST_COHERENT,
+				*m_pDeviceMemoryArena);
 		}
 
-		Queue& operator=(const Queue& other) {
-			HandleWithOwner::operator=(other);
-			m_queueFamilyIndex = other.m_queueFamilyIndex;
-			return *this;
+		//	The pixels are level 0 of a color image, its old contents are discarded.
+		//	With mipLevels > 1 the image also needs TRANSFER_SRC usage and a
+		//	linear blittable format.  Every level ends up in SHADER_READ_ONLY_OPTIMAL.
+		void addImage(
+			Image		image,
+			uint32_t	width,
+			uint32_t	height,
+			const void* pPixels,
+			VkDeviceSize	size,
+			uint32_t	mipLevels = 1
+		) {
+			Buffer stagingBuffer = stage(pPixels, size);
+			m_imageUploads.push_back({ image, stagingBuffer, width, height, mipLevels });
+			m_stats.m_imageCount++;
 		}
 
-		void waitIdle() {
-			vkQueueWaitIdle(*this);
+		//	Same, with the pixels already in a buffer from createStagingBuffer.
+		void addImage(
+			Image		image,
+			uint32_t	width,
+			uint32_t	height,
+			Buffer_DeviceMemory&& stagingBuffer,
+			VkDeviceSize	size,
+			uint32_t	mipLevels = 1
+		) {
+			Buffer vkStagingBuffer = stage(std::move(stagingBuffer), size);
+			m_imageUploads.push_back({ image, vkStagingBuffer, width, height, mipLevels });
+			m_stats.m_imageCount++;
 		}
 
+		//	Every level is already in the staging buffer, level n at levelOffsets[n],
+		//	e.g. block compressed levels straight from a texture file.
+		//	Offsets must suit the format's texel block size.  No blits are done.
+		void addImageLevels(
+			Image		image,
+			uint32_t	width,
+			uint32_t	height,
+			Buffer_DeviceMemory&& stagingBuffer,
+			VkDeviceSize	size,
+			std::vector<VkDeviceSize> levelOffsets
+		) {
+			const uint32_t mipLevels = static_cast<uint32_t>(levelOffsets.size());
+			Buffer vkStagingBuffer = stage(std::move(stagingBuffer), size);
+			m_imageUploads.push_back({ image, vkStagingBuffer, width, height, mipLevels, std::move(levelOffsets) });
+			m_stats.m_imageCount++;
+		}
 
-		void submit2(CommandBuffer commandBuffer) const {
-			SubmitInfo2 submitInfo2;
-			submitInfo2.addCommandBuffer(commandBuffer);
-			VkResult vkResult = vkQueueSubmit2(*this, 1, submitInfo2.assemble(), VK_NULL_HANDLE);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
+		void addBuffer(
+			Buffer		dstBuffer,
+			const void* pSrcMem,
+			VkDeviceSize	size
+		) {
+			Buffer stagingBuffer = stage(pSrcMem, size);
+			m_bufferUploads.push_back({ dstBuffer, stagingBuffer, size });
+			m_stats.m_bufferCount++;
 		}
 
-		void submit2(CommandBuffer commandBuffer, Fence fence) const {
-			SubmitInfo2 submitInfo2;
-			submitInfo2.addCommandBuffer(commandBuffer);
-			VkResult vkResult = vkQueueSubmit2(*this, 1, submitInfo2.assemble(), fence);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
+		bool empty() const {
+			return m_stagingBuffers.empty() && m_submissions.empty();
 		}
 
-		void submit2(SubmitInfo2& submitInfo2, Fence fence) const {
-			VkResult vkResult = vkQueueSubmit2(*this, 1, submitInfo2.assemble(), fence);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		//	Bytes added since the last submit.
+		VkDeviceSize pendingBytes() const {
+			return m_pendingBytes;
+		}
+
+		//	Records and submits everything added since the last submit.  Does not wait.
+		//	Returns the submit's serial, to check for with completed.  With nothing
+		//	added it returns the last serial, which covers everything added before.
+		uint64_t submit() {
+			retireCompleted();
+			if (m_stagingBuffers.empty()) {
+				return m_lastSerial;
+			}
+
+			Submission newSubmission;
+			record(newSubmission);
+			//	In place before it goes out, the submit batch writes into it.
+			m_submissions.push_back(std::move(newSubmission));
+			Submission& submission = m_submissions.back();
+			try {
+				//	A timeline on the completing queue saves the fence.
+				if (!completingQueue().timeline()) {
+					submission.m_completedFence = acquireFence();
+				}
+				const VkFence vkFence = submission.m_completedFence
+					? static_cast<VkFence>(submission.m_completedFence) : VK_NULL_HANDLE;
+				if (transfersOwnership()) {
+					submission.m_copiesCompleteSemaphore = acquireSemaphore();
+					SubmitInfo2 copySubmitInfo;
+					copySubmitInfo.addCommandBuffer(submission.m_commandBuffer);
+					copySubmitInfo.addSignalSemaphore(submission.m_copiesCompleteSemaphore);
+
+					SubmitInfo2 acquireSubmitInfo;
+					acquireSubmitInfo.addWaitSemaphore(submission.m_copiesCompleteSemaphore, PIPELINE_STAGE_2_ALL_COMMANDS);
+					acquireSubmitInfo.addCommandBuffer(submission.m_acquireCommandBuffer);
+
+					if (m_pSubmitBatch) {
+						m_pSubmitBatch->add(m_queue, std::move(copySubmitInfo));
+						m_pSubmitBatch->add(m_ownerQueue, std::move(acquireSubmitInfo), vkFence, &submission.m_timelineValue);
+					}
+					else {
+						m_queue.submit2(copySubmitInfo);
+						submission.m_timelineValue = m_ownerQueue.submit2(1, acquireSubmitInfo.assemble(), vkFence);
+					}
+					m_stats.m_ownershipTransferred = true;
+				}
+				else if (m_pSubmitBatch) {
+					m_pSubmitBatch->add(m_queue, submission.m_commandBuffer, vkFence, &submission.m_timelineValue);
+				}
+				else {
+					SubmitInfo2 submitInfo2;
+					submitInfo2.addCommandBuffer(submission.m_commandBuffer);
+					submission.m_timelineValue = m_queue.submit2(1, submitInfo2.assemble(), vkFence);
+				}
+			}
+			catch (...) {
+				m_submissions.pop_back();
+				throw;
 			}
+
+			submission.m_stagingBuffers = std::move(m_stagingBuffers);
+			submission.m_serial = ++m_lastSerial;
+			m_stats.m_submitCount++;
+
+			m_stagingBuffers.clear();
+			m_imageUploads.clear();
+			m_bufferUploads.clear();
+			m_pendingBytes = 0;
+			return m_lastSerial;
 		}
 
-		void submit2Fenced(CommandBuffer commandBuffer) const {
-			SubmitInfo2 submitInfo2;
-			submitInfo2.addCommandBuffer(commandBuffer);
-			vkcpp::Fence completedFence(getVkDevice());
-			VkResult vkResult = vkQueueSubmit2(*this, 1, submitInfo2.assemble(), completedFence);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		//	True once the gpu has finished the submit with this serial and all before it.
+		bool completed(uint64_t serial) {
+			retireCompleted();
+			for (const Submission& submission : m_submissions) {
+				if (submission.m_serial <= serial) {
+					return false;
+				}
 			}
-			completedFence.wait();
+			return true;
 		}
 
+		//	Gives back the staging memory of submissions the gpu has finished,
+		//	and the command buffers once none are left.
+		void retireCompleted() {
+			std::erase_if(m_submissions, [this](Submission& submission) {
+				if (!submissionCompleted(submission)) {
+					return false;
+				}
+				releaseSyncObjects(submission);
+				return true;
+				});
+			if (m_submissions.empty()) {
+				resetCommandAllocators();
+			}
+		}
 
-		VkResult present(PresentInfo& presentInfo) {
-			VkResult vkResult = vkQueuePresentKHR(*this, presentInfo.assemble());
-			if (vkResult == VK_SUCCESS) {
-				return vkResult;
+		//	Submits anything pending, waits for the gpu, releases the
+		//	staging memory, and returns the stats.  The batch can then be reused.
+		Stats wait() {
+			submit();
+			if (m_pSubmitBatch) {
+				m_pSubmitBatch->flush();
 			}
-			if (vkResult == VK_SUBOPTIMAL_KHR) {
-				return vkResult;
+			const auto waitStartTime = std::chrono::high_resolution_clock::now();
+			for (Submission& submission : m_submissions) {
+				waitSubmission(submission);
+				releaseSyncObjects(submission);
 			}
+			const auto endTime = std::chrono::high_resolution_clock::now();
 
-			throw Exception(vkResult);
+			Stats stats = m_stats;
+			if (m_started) {
+				stats.m_duration = endTime - m_startTime;
+				stats.m_gpuWaitDuration = endTime - waitStartTime;
+			}
+			m_submissions.clear();
+			resetCommandAllocators();
+			m_stats = Stats();
+			m_started = false;
+			return stats;
 		}
+
+		Stats submitAndWait() {
+			return wait();
+		}
+
 	};
 
 
 	class DescriptorPoolCreateInfo : public VkDescriptorPoolCreateInfo {
 
-		//	The map allows us to collect the size info in any order.
-		//	When it's time to assemble, we'll put the collected info
-		//	into the vector so that it's ready for the create call.
-		std::map<VkDescriptorType, int>	m_poolSizesMap;
-		std::vector<VkDescriptorPoolSize> m_poolSizes;
+		//	Sizes can be added in any order, repeats of a type are
+		//	summed into its one entry.  There are only a few types.
+		InlineVector<VkDescriptorPoolSize, 8>	m_poolSizes;
 
 	public:
 
@@ -2461,17 +6082,16 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 		}
 
 		void addDescriptorCount(VkDescriptorType vkDescriptorType, int count) {
-			m_poolSizesMap[vkDescriptorType] += count;
+			for (VkDescriptorPoolSize& poolSize : m_poolSizes) {
+				if (poolSize.type == vkDescriptorType) {
+					poolSize.descriptorCount += count;
+					return;
+				}
+			}
+			m_poolSizes.push_back({ vkDescriptorType, static_cast<uint32_t>(count) });
 		}
 
 		VkDescriptorPoolCreateInfo* assemble() {
-			m_poolSizes.clear();
-			VkDescriptorPoolSize vkDescriptorPoolSize;
-			for (std::pair<VkDescriptorType, int> kv : m_poolSizesMap) {
-				vkDescriptorPoolSize.type = kv.first;
-				vkDescriptorPoolSize.descriptorCount = kv.second;
-				m_poolSizes.push_back(vkDescriptorPoolSize);
-			}
 			poolSizeCount = static_cast<uint32_t>(m_poolSizes.size());
 			pPoolSizes = nullptr;
 			if (poolSizeCount > 0) {
@@ -2660,17 +6280,30 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 		//	we write a marker into the appropriate field, and then
 		//	replace the marker with the real pointer when assembled
 		//	for use.
-		std::vector<VkWriteDescriptorSet>	m_vkWriteDescriptorSets;
-		std::vector<WriteDescriptorInfo>	m_writeDescriptorInfos;
+		InlineVector<VkWriteDescriptorSet, 4>	m_vkWriteDescriptorSets;
+		InlineVector<WriteDescriptorInfo, 4>	m_writeDescriptorInfos;
 
 	public:
 
 
+		//	Any buffer type, e.g. VK_DESCRIPTOR_TYPE_STORAGE_BUFFER.
+		//	size can be VK_WHOLE_SIZE for the rest of the buffer.
+		void addWriteDescriptor(
+			VkDescriptorSet		vkDescriptorSet,
+			uint32_t			bindingIndex,
+			VkDescriptorType	vkDescriptorType,
+			vkcpp::Buffer		buffer,
+			VkDeviceSize		size
+		) {
+			addWriteDescriptor(vkDescriptorSet, bindingIndex, vkDescriptorType, buffer, 0, size);
+		}
+
 		void addWriteDescriptor(
 			VkDescriptorSet		vkDescriptorSet,
 			uint32_t			bindingIndex,
 			VkDescriptorType	vkDescriptorType,
 			vkcpp::Buffer		buffer,
+			VkDeviceSize		offset,
 			VkDeviceSize		size
 		) {
 			const VkDescriptorBufferInfo* marker = reinterpret_cast<VkDescriptorBufferInfo*>(-1);
@@ -2687,7 +6320,7 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 
 			VkDescriptorBufferInfo vkDescriptorBufferInfo{
 				.buffer = buffer,
-				.offset = 0,
+				.offset = offset,
 				.range = size
 			};
 
@@ -2727,6 +6360,38 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 
 		}
 
+		//	No sampler, e.g. VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, which
+		//	compute shaders usually access in VK_IMAGE_LAYOUT_GENERAL.
+		void addWriteDescriptor(
+			VkDescriptorSet		vkDescriptorSet,
+			uint32_t			bindingIndex,
+			VkDescriptorType	vkDescriptorType,
+			ImageView			imageView,
+			VkImageLayout		vkImageLayout
+		) {
+			const VkDescriptorImageInfo* marker = reinterpret_cast<VkDescriptorImageInfo*>(-1);
+
+			VkWriteDescriptorSet	vkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = vkDescriptorSet,
+				.dstBinding = bindingIndex,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = vkDescriptorType,
+				.pImageInfo = marker
+			};
+
+			VkDescriptorImageInfo vkDescriptorImageInfo{
+				.sampler = VK_NULL_HANDLE,
+				.imageView = imageView,
+				.imageLayout = vkImageLayout
+			};
+
+			m_vkWriteDescriptorSets.push_back(vkWriteDescriptorSet);
+			m_writeDescriptorInfos.push_back(vkDescriptorImageInfo);
+
+		}
+
 
 
 		void assemble() {
@@ -2735,10 +6400,10 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 
 			for (VkWriteDescriptorSet& vkWriteDescriptorSet : m_vkWriteDescriptorSets) {
 				if (vkWriteDescriptorSet.pBufferInfo) {
-					vkWriteDescriptorSet.pBufferInfo = &(m_writeDescriptorInfos.at(index).m_vkDescriptorBufferInfo);
+					vkWriteDescriptorSet.pBufferInfo = &(m_writeDescriptorInfos[index].m_vkDescriptorBufferInfo);
 				}
 				if (vkWriteDescriptorSet.pImageInfo) {
-					vkWriteDescriptorSet.pImageInfo = &(m_writeDescriptorInfos.at(index).m_vkDescriptorImageInfo);
+					vkWriteDescriptorSet.pImageInfo = &(m_writeDescriptorInfos[index].m_vkDescriptorImageInfo);
 				}
 				++index;
 			}
@@ -2752,8 +6417,9 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 				static_cast<uint32_t>(m_vkWriteDescriptorSets.size()),
 				m_vkWriteDescriptorSets.data(),
 				0, nullptr);
-			//	TODO: should the update info be cleared after this?
-			//	is it ever reused?
+			//	Written, so a later update only writes what is added after this.
+			m_vkWriteDescriptorSets.clear();
+			m_writeDescriptorInfos.clear();
 		}
 
 	};
@@ -2819,6 +6485,22 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 		}
 
 
+		void addWriteDescriptor(
+			uint32_t			bindingIndex,
+			VkDescriptorType	vkDescriptorType,
+			vkcpp::Buffer		buffer,
+			VkDeviceSize		offset,
+			VkDeviceSize		size
+		) {
+			m_descriptorSetUpdater.addWriteDescriptor(
+				*this,
+				bindingIndex,
+				vkDescriptorType,
+				buffer,
+				offset,
+				size);
+		}
+
 		void addWriteDescriptor(
 			uint32_t			bindingIndex,
 			VkDescriptorType	vkDescriptorType,
@@ -2833,6 +6515,20 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 				sampler);
 		}
 
+		void addWriteDescriptor(
+			uint32_t			bindingIndex,
+			VkDescriptorType	vkDescriptorType,
+			ImageView			imageView,
+			VkImageLayout		vkImageLayout
+		) {
+			m_descriptorSetUpdater.addWriteDescriptor(
+				*this,
+				bindingIndex,
+				vkDescriptorType,
+				imageView,
+				vkImageLayout);
+		}
+
 		void updateDescriptors() {
 			m_descriptorSetUpdater.updateDescriptorSets(getOwner().getVkDevice());
 		}
@@ -3204,21 +6900,78 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 			m_vkGraphicsPipelineCreateInfo.pDepthStencilState = &m_vkPipelineDepthStencilStateCreateInfo;
 
 
-			m_vkGraphicsPipelineCreateInfo.layout = m_pipelineLayout;
-			m_vkGraphicsPipelineCreateInfo.renderPass = m_renderPass;
-			m_vkGraphicsPipelineCreateInfo.subpass = m_subpassNumber;
-			m_vkGraphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-			m_vkGraphicsPipelineCreateInfo.basePipelineIndex = -1; // Optional
+			m_vkGraphicsPipelineCreateInfo.layout = m_pipelineLayout;
+			m_vkGraphicsPipelineCreateInfo.renderPass = m_renderPass;
+			m_vkGraphicsPipelineCreateInfo.subpass = m_subpassNumber;
+			m_vkGraphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+			m_vkGraphicsPipelineCreateInfo.basePipelineIndex = -1; // Optional
+
+			return &m_vkGraphicsPipelineCreateInfo;
+		}
+	};
+
+
+
+	class GraphicsPipeline : public HandleWithOwner<VkPipeline> {
+
+		GraphicsPipeline(VkPipeline vkPipeline, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkPipeline, vkDevice, pfnDestroy) {
+		}
+
+		static void destroy(VkPipeline vkPipeline, VkDevice vkDevice) {
+			vkDestroyPipeline(vkDevice, vkPipeline, nullptr);
+		}
+
+	public:
+
+		GraphicsPipeline() {}
+		GraphicsPipeline(GraphicsPipelineCreateInfo& pipelineCreateInfo, VkDevice vkDevice) {
+			VkPipeline vkPipeline;
+			VkResult vkResult = vkCreateGraphicsPipelines(vkDevice, VK_NULL_HANDLE, 1, pipelineCreateInfo.assemble(), nullptr, &vkPipeline);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)GraphicsPipeline(vkPipeline, vkDevice, &destroy);
+		}
+
+	};
+
+
+	class ComputePipelineCreateInfo : public VkComputePipelineCreateInfo {
+
+	public:
+
+		VkComputePipelineCreateInfo* operator&() = delete;
+
+		ComputePipelineCreateInfo()
+			: VkComputePipelineCreateInfo{} {
+			sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			basePipelineIndex = -1;
+		}
+
+		void setShaderModule(
+			vkcpp::ShaderModule shaderModule,
+			const char* entryPointName
+		) {
+			stage.module = shaderModule;
+			stage.pName = entryPointName;
+		}
+
+		void setPipelineLayout(PipelineLayout pipelineLayout) {
+			layout = pipelineLayout;
+		}
 
-			return &m_vkGraphicsPipelineCreateInfo;
+		VkComputePipelineCreateInfo* assemble() {
+			return this;
 		}
 	};
 
 
+	class ComputePipeline : public HandleWithOwner<VkPipeline> {
 
-	class GraphicsPipeline : public HandleWithOwner<VkPipeline> {
-
-		GraphicsPipeline(VkPipeline vkPipeline, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
+		ComputePipeline(VkPipeline vkPipeline, VkDevice vkDevice, DestroyFunc_t pfnDestroy)
 			: HandleWithOwner(vkPipeline, vkDevice, pfnDestroy) {
 		}
 
@@ -3228,14 +6981,14 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 
 	public:
 
-		GraphicsPipeline() {}
-		GraphicsPipeline(GraphicsPipelineCreateInfo& pipelineCreateInfo, VkDevice vkDevice) {
+		ComputePipeline() {}
+		ComputePipeline(ComputePipelineCreateInfo& pipelineCreateInfo, VkDevice vkDevice) {
 			VkPipeline vkPipeline;
-			VkResult vkResult = vkCreateGraphicsPipelines(vkDevice, VK_NULL_HANDLE, 1, pipelineCreateInfo.assemble(), nullptr, &vkPipeline);
+			VkResult vkResult = vkCreateComputePipelines(vkDevice, VK_NULL_HANDLE, 1, pipelineCreateInfo.assemble(), nullptr, &vkPipeline);
 			if (vkResult != VK_SUCCESS) {
 				throw Exception(vkResult);
 			}
-			new(this)GraphicsPipeline(vkPipeline, vkDevice, &destroy);
+			new(this)ComputePipeline(vkPipeline, vkDevice, &destroy);
 		}
 
 	};
@@ -3278,440 +7031,1528 @@ static const ShaderStageFlags BARE_VK_VALUE(VK_##BARE_VK_VALUE##_BIT)
 
 
 
-	class Swapchain : public HandleWithOwner<VkSwapchainKHR, Device> {
+	class Swapchain : public HandleWithOwner<VkSwapchainKHR, Device> {
+
+		Swapchain(VkSwapchainKHR vkSwapchain, Device device, DestroyFunc_t pfnDestroy, VkExtent2D vkSwapchainImageExtent)
+			: HandleWithOwner(vkSwapchain, device, pfnDestroy)
+			, m_vkSwapchainImageExtent(vkSwapchainImageExtent) {
+		}
+
+		static void destroy(VkSwapchainKHR vkSwapchain, Device device) {
+			vkDestroySwapchainKHR(device, vkSwapchain, nullptr);
+		}
+
+		VkExtent2D		m_vkSwapchainImageExtent = { .width = 0, .height = 0 };
+
+
+	public:
+
+		Swapchain() {}
+		Swapchain(const VkSwapchainCreateInfoKHR& vkSwapchainCreateInfo, Device device) {
+			VkSwapchainKHR vkSwapchain;
+			VkResult vkResult = vkCreateSwapchainKHR(device, &vkSwapchainCreateInfo, nullptr, &vkSwapchain);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)Swapchain(vkSwapchain, device, &destroy, vkSwapchainCreateInfo.imageExtent);
+		}
+
+		VkExtent2D imageExtent() const { return m_vkSwapchainImageExtent; }
+
+		std::vector<VkImage> getImages() const {
+			uint32_t swapchainImageCount;
+			VkResult vkResult = vkGetSwapchainImagesKHR(getVkDevice(), *this, &swapchainImageCount, nullptr);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			std::vector<VkImage> swapchainImages(swapchainImageCount);
+			vkResult = vkGetSwapchainImagesKHR(getVkDevice(), *this, &swapchainImageCount, swapchainImages.data());
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			return swapchainImages;
+		}
+
+	};
+
+	class FramebufferCreateInfo : public VkFramebufferCreateInfo {
+
+		std::vector<VkImageView> m_attachments;
+
+	public:
+
+		VkFramebufferCreateInfo* operator&() = delete;
+
+		FramebufferCreateInfo(
+			RenderPass renderPassArg,
+			VkExtent2D	vkExtent2D
+		)
+			: VkFramebufferCreateInfo{}
+		{
+			sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			renderPass = renderPassArg;
+			width = vkExtent2D.width;
+			height = vkExtent2D.height;
+			layers = 1;
+		}
+
+		FramebufferCreateInfo& addAttachment(ImageView imageView) {
+			m_attachments.push_back(imageView);
+			return *this;
+		}
+
+		FramebufferCreateInfo& addAttachment(VkImageView vkImageView) {
+			m_attachments.push_back(vkImageView);
+			return *this;
+		}
+
+		VkFramebufferCreateInfo* assemble() {
+			attachmentCount = static_cast<uint32_t>(m_attachments.size());
+			pAttachments = m_attachments.data();
+			return this;
+		}
+
+
+
+	};
+
+
+
+
+	class Image_Memory {
+
+		Image_Memory(Image&& image, DeviceMemory&& deviceMemory)
+			: m_image(std::move(image))
+			, m_deviceMemory(std::move(deviceMemory)) {
+		}
+
+	public:
+
+		Image			m_image;
+		DeviceMemory	m_deviceMemory;
+
+		Image_Memory() {}
+
+		Image_Memory(const Image_Memory&) = delete;
+		Image_Memory& operator=(const Image_Memory&) = delete;
+
+		Image_Memory(Image_Memory&& other) noexcept
+			: m_image(std::move(other.m_image))
+			, m_deviceMemory(std::move(other.m_deviceMemory)) {
+		}
+
+		Image_Memory& operator=(Image_Memory&& other) noexcept {
+			if (this == &other) {
+				return *this;
+			}
+			(*this).~Image_Memory();
+			new(this) Image_Memory(std::move(other));
+			return *this;
+		}
+
+
+		Image_Memory(
+			const ImageCreateInfo& imageCreateInfo,
+			MemoryPropertyFlags properties,
+			Device device
+		) {
+			Image image(imageCreateInfo, device);
+			DeviceMemory deviceMemory = image.allocateDeviceMemory(properties);
+
+			VkResult vkResult = vkBindImageMemory(device, image, deviceMemory, 0);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+			new(this) Image_Memory(std::move(image), std::move(deviceMemory));
+
+		}
+
+		Image_Memory(
+			VkExtent2D	vkExtent2D,
+			VkFormat format,
+			VkImageUsageFlags usage,
+			MemoryPropertyFlags properties,
+			Device device
+		) {
+			ImageCreateInfo imageCreateInfo(format, usage);
+			imageCreateInfo.setExtent(vkExtent2D);
+			new(this) Image_Memory(imageCreateInfo, properties, device);
+		}
+
+		Image_Memory(
+			const ImageCreateInfo& imageCreateInfo,
+			MemoryPropertyFlags properties,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			Device device = deviceMemoryArena.getDevice();
+			Image image(imageCreateInfo, device);
+			DeviceMemory deviceMemory = image.allocateDeviceMemory(properties, deviceMemoryArena);
+
+			VkResult vkResult = vkBindImageMemory(device, image, deviceMemory, deviceMemory.offset());
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+
+			new(this) Image_Memory(std::move(image), std::move(deviceMemory));
+
+		}
+
+		Image_Memory(
+			VkExtent2D	vkExtent2D,
+			VkFormat format,
+			VkImageUsageFlags usage,
+			MemoryPropertyFlags properties,
+			DeviceMemoryArena& deviceMemoryArena
+		) {
+			ImageCreateInfo imageCreateInfo(format, usage);
+			imageCreateInfo.setExtent(vkExtent2D);
+			new(this) Image_Memory(imageCreateInfo, properties, deviceMemoryArena);
+		}
+
+	};
+
+
+	class Image_Memory_View {
+
+
+	public:
+		Image			m_image;
+		DeviceMemory	m_deviceMemory;
+		ImageView		m_imageView;
+
+		Image_Memory_View() {}
+
+		Image_Memory_View(
+			Image&& image,
+			DeviceMemory&& deviceMemory,
+			ImageView&& imageView)
+			: m_image(std::move(image))
+			, m_deviceMemory(std::move(deviceMemory))
+			, m_imageView(std::move(imageView)) {
+
+		}
+
+	};
+
+
+
+	class Framebuffer : public HandleWithOwner<VkFramebuffer, Device> {
+
+		Framebuffer(VkFramebuffer vkFramebuffer, Device device, DestroyFunc_t pfnDestroy)
+			: HandleWithOwner(vkFramebuffer, device, pfnDestroy) {
+		}
+
+		static void destroy(VkFramebuffer vkFramebuffer, Device device) {
+			vkDestroyFramebuffer(device, vkFramebuffer, nullptr);
+		}
+
+		//	Right now, framebuffer holds these just to control lifetime.
+		//	TODO: is there ever going to be more than one of these?
+		std::vector<Image_Memory_View>	m_image_memory_views;
+
+		std::vector<ImageView>	m_imageViews;
+
+
+	public:
+
+		Framebuffer() {}
+
+		Framebuffer(FramebufferCreateInfo& framebufferCreateInfo, Device device) {
+			VkFramebuffer	vkFramebuffer;
+			VkResult vkResult = vkCreateFramebuffer(device, framebufferCreateInfo.assemble(), nullptr, &vkFramebuffer);
+			if (vkResult != VK_SUCCESS) {
+				throw Exception(vkResult);
+			}
+			new(this)Framebuffer(vkFramebuffer, device, &destroy);
+		}
+
+		void take(Image_Memory_View&& image_memory_view) {
+			m_image_memory_views.push_back(std::move(image_memory_view));
+		}
+
+		void take(ImageView&& imageView) {
+			m_imageViews.push_back(std::move(imageView));
+		}
+
+
+	};
+
+
+	class Swapchain_FrameBuffers {
+
+	public:
+		static inline	Device		s_device;
 
-		Swapchain(VkSwapchainKHR vkSwapchain, Device device, DestroyFunc_t pfnDestroy, VkExtent2D vkSwapchainImageExtent)
-			: HandleWithOwner(vkSwapchain, device, pfnDestroy)
-			, m_vkSwapchainImageExtent(vkSwapchainImageExtent) {
-		}
+		//	Just save the create info since we need parts of it later.
+		SwapchainCreateInfo	m_swapchainCreateInfo;
 
-		static void destroy(VkSwapchainKHR vkSwapchain, Device device) {
-			vkDestroySwapchainKHR(device, vkSwapchain, nullptr);
-		}
+		//	Save the "smart" surface since the create info only has the base handle.
+		Surface				m_surface;
 
-		VkExtent2D		m_vkSwapchainImageExtent = { .width = 0, .height = 0 };
+		Swapchain	m_swapchain;
+		std::vector<VkImage>	m_swapchainImages;
+		//	The framebuffers are made from these by whatever renders into
+		//	them, e.g. a RenderGraph, along with its own depth buffer.
+		std::vector<ImageView>	m_swapchainImageViews;
 
+		bool m_swapchainUpToDate = false;
 
-	public:
+		//	Bumped each time the images are recreated, so anything
+		//	recorded against the old ones can tell it is stale.
+		uint64_t	m_generation = 0;
+
+		//	Old image views and swapchains wait here for the frames
+		//	using them instead of the device being drained.
+		DeferredDeletionQueue*	m_pDeferredDeletionQueue = nullptr;
+
+		//	With VK_EXT_swapchain_maintenance1 every present gets a fence, and
+		//	an old swapchain is kept until the fences of its presents open.
+		//	The frames only cover rendering, the presentation engine can hold
+		//	on to the images for longer.
+		struct RetiredSwapchain {
+			Swapchain			m_swapchain;
+			std::vector<Fence>	m_presentFences;
+		};
 
-		Swapchain() {}
-		Swapchain(const VkSwapchainCreateInfoKHR& vkSwapchainCreateInfo, Device device) {
-			VkSwapchainKHR vkSwapchain;
-			VkResult vkResult = vkCreateSwapchainKHR(device, &vkSwapchainCreateInfo, nullptr, &vkSwapchain);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
-			}
-			new(this)Swapchain(vkSwapchain, device, &destroy, vkSwapchainCreateInfo.imageExtent);
+		SyncObjectPool*		m_pSyncObjectPool = nullptr;
+		std::vector<Fence>	m_presentFences;	//	Oldest first.
+		std::vector<RetiredSwapchain>	m_retiredSwapchains;
+
+
+	private:
+
+		void makeEmpty() {
+			//	TODO: Need to review the whole move thing to make sure this all makes sense.
+			m_swapchainImages.clear();
+			m_swapchainImageViews.clear();
+			m_presentFences.clear();
+			m_retiredSwapchains.clear();
 		}
 
-		VkExtent2D imageExtent() const { return m_vkSwapchainImageExtent; }
 
-		std::vector<VkImage> getImages() const {
-			uint32_t swapchainImageCount;
-			VkResult vkResult = vkGetSwapchainImagesKHR(getVkDevice(), *this, &swapchainImageCount, nullptr);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		//	Gives back the fences of the presents that are done, up to the
+		//	first one that isn't.
+		void releasePresentFences(std::vector<Fence>& presentFences) {
+			size_t signaledCount = 0;
+			while (signaledCount < presentFences.size() && presentFences[signaledCount].signaled()) {
+				signaledCount++;
 			}
-			std::vector<VkImage> swapchainImages(swapchainImageCount);
-			vkResult = vkGetSwapchainImagesKHR(getVkDevice(), *this, &swapchainImageCount, swapchainImages.data());
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+			for (size_t i = 0; i < signaledCount; i++) {
+				m_pSyncObjectPool->releaseFence(std::move(presentFences[i]));
 			}
-			return swapchainImages;
+			presentFences.erase(presentFences.begin(), presentFences.begin() + signaledCount);
 		}
 
-	};
 
-	class FramebufferCreateInfo : public VkFramebufferCreateInfo {
+		//	Once the presentation engine is done with all of an old swapchain's
+		//	images it goes on to wait for the frames, like its image views.
+		void collectRetiredSwapchains() {
+			for (RetiredSwapchain& retiredSwapchain : m_retiredSwapchains) {
+				releasePresentFences(retiredSwapchain.m_presentFences);
+				if (retiredSwapchain.m_presentFences.empty() && m_pDeferredDeletionQueue) {
+					m_pDeferredDeletionQueue->destroyLater(std::move(retiredSwapchain.m_swapchain));
+				}
+			}
+			std::erase_if(m_retiredSwapchains, [](const RetiredSwapchain& retiredSwapchain) {
+				return retiredSwapchain.m_presentFences.empty();
+				});
+		}
 
-		std::vector<VkImageView> m_attachments;
 
-	public:
+		void retireSwapchain(Swapchain&& swapchain) {
+			if (m_pSyncObjectPool) {
+				m_retiredSwapchains.push_back({ std::move(swapchain), std::move(m_presentFences) });
+				m_presentFences.clear();
+				return;
+			}
+			//	Without present fences nothing says when the presentation engine
+			//	is done with the old images.  Swapchain teardown is the one
+			//	place that still waits for the device to go idle.
+			Swapchain oldSwapchain = std::move(swapchain);
+			vkDeviceWaitIdle(s_device);
+		}
 
-		VkFramebufferCreateInfo* operator&() = delete;
 
-		FramebufferCreateInfo(
-			RenderPass renderPassArg,
-			VkExtent2D	vkExtent2D
-		)
-			: VkFramebufferCreateInfo{}
-		{
-			sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			renderPass = renderPassArg;
-			width = vkExtent2D.width;
-			height = vkExtent2D.height;
-			layers = 1;
+		//	Frames in flight may still be drawing into them.
+		void retireImageViews() {
+			m_swapchainImages.clear();
+			if (m_swapchainImageViews.empty()) {
+				return;
+			}
+			if (m_pDeferredDeletionQueue) {
+				m_pDeferredDeletionQueue->destroyLater(std::move(m_swapchainImageViews));
+			}
+			else {
+				vkDeviceWaitIdle(s_device);
+			}
+			m_swapchainImageViews.clear();
 		}
 
-		FramebufferCreateInfo& addAttachment(ImageView imageView) {
-			m_attachments.push_back(imageView);
-			return *this;
-		}
 
-		VkFramebufferCreateInfo* assemble() {
-			attachmentCount = static_cast<uint32_t>(m_attachments.size());
-			pAttachments = m_attachments.data();
-			return this;
+		void destroy() {
+			if (!s_device) {
+				return;
+			}
+			if (m_swapchain || !m_retiredSwapchains.empty()) {
+				retireImageViews();
+				if (m_swapchain) {
+					retireSwapchain(std::move(m_swapchain));
+				}
+				//	The swapchains have to go before the surface, so this can't
+				//	be left for later.  Only waits for the presents and frames.
+				for (RetiredSwapchain& retiredSwapchain : m_retiredSwapchains) {
+					for (Fence& presentFence : retiredSwapchain.m_presentFences) {
+						presentFence.wait();
+					}
+				}
+				collectRetiredSwapchains();
+				if (m_pDeferredDeletionQueue) {
+					m_pDeferredDeletionQueue->waitAll();
+				}
+			}
 		}
 
 
+		void createSwapchainImageViews() {
 
-	};
-
+			m_swapchainImages = m_swapchain.getImages();
 
+			for (VkImage vkImage : m_swapchainImages) {
+				ImageViewCreateInfo imageViewCreateInfo(
+					vkImage,
+					VK_IMAGE_VIEW_TYPE_2D,
+					m_swapchainCreateInfo.imageFormat,
+					VK_IMAGE_ASPECT_COLOR_BIT);
+				m_swapchainImageViews.push_back(ImageView(imageViewCreateInfo, m_swapchain.getOwner()));
+			}
+		}
 
 
-	class Image_Memory {
+		static Swapchain createSwapchain(
+			SwapchainCreateInfo& swapchainCreateInfo,
+			Surface surface
+		) {
+			const VkSurfaceCapabilitiesKHR vkSurfaceCapabilities = surface.getSurfaceCapabilities();
+			const VkExtent2D surfaceExtent = vkSurfaceCapabilities.currentExtent;
+			//	Can't make "real" swapchains with 0 width or height, e.g.,
+			//	the window is minimized.  Return a "null" swapchain if
+			//	this occurs.
+			if (surfaceExtent.width == 0 || surfaceExtent.height == 0) {
+				return Swapchain{};
+			}
+			//	TODO: should probably sanity check some other surface capabilities.
+			swapchainCreateInfo.surface = surface;
+			swapchainCreateInfo.imageExtent = surfaceExtent;
+			swapchainCreateInfo.preTransform = vkSurfaceCapabilities.currentTransform;
 
-		Image_Memory(Image&& image, DeviceMemory&& deviceMemory)
-			: m_image(std::move(image))
-			, m_deviceMemory(std::move(deviceMemory)) {
+			return Swapchain(swapchainCreateInfo, s_device);
 		}
 
+
 	public:
 
-		Image			m_image;
-		DeviceMemory	m_deviceMemory;
+		Swapchain_FrameBuffers() {}
+		~Swapchain_FrameBuffers() {
+			destroy();
+		}
 
-		Image_Memory() {}
+		Swapchain_FrameBuffers(
+			const SwapchainCreateInfo& swapchainCreateInfo,
+			Surface surface)
+			: m_swapchainCreateInfo(swapchainCreateInfo)
+			, m_surface(surface) {
 
-		Image_Memory(const Image_Memory&) = delete;
-		Image_Memory& operator=(const Image_Memory&) = delete;
+		}
 
-		Image_Memory(Image_Memory&& other) noexcept
-			: m_image(std::move(other.m_image))
-			, m_deviceMemory(std::move(other.m_deviceMemory)) {
+		Swapchain_FrameBuffers(const Swapchain_FrameBuffers&) = delete;
+		Swapchain_FrameBuffers& operator=(const Swapchain_FrameBuffers&) = delete;
+
+		Swapchain_FrameBuffers(Swapchain_FrameBuffers&& other) noexcept
+			: m_swapchainCreateInfo(std::move(other.m_swapchainCreateInfo))
+			, m_surface(std::move(other.m_surface))
+			, m_swapchain(std::move(other.m_swapchain))
+			, m_swapchainImages(std::move(other.m_swapchainImages))
+			, m_swapchainImageViews(std::move(other.m_swapchainImageViews))
+			, m_generation(other.m_generation)
+			, m_pDeferredDeletionQueue(other.m_pDeferredDeletionQueue)
+			, m_pSyncObjectPool(other.m_pSyncObjectPool)
+			, m_presentFences(std::move(other.m_presentFences))
+			, m_retiredSwapchains(std::move(other.m_retiredSwapchains)) {
+			other.makeEmpty();
 		}
 
-		Image_Memory& operator=(Image_Memory&& other) noexcept {
+		Swapchain_FrameBuffers& operator=(Swapchain_FrameBuffers&& other) noexcept {
 			if (this == &other) {
 				return *this;
 			}
-			(*this).~Image_Memory();
-			new(this) Image_Memory(std::move(other));
+			(*this).~Swapchain_FrameBuffers();
+			new(this) Swapchain_FrameBuffers(std::move(other));
+			other.makeEmpty();
 			return *this;
 		}
 
 
-		Image_Memory(
-			const ImageCreateInfo& imageCreateInfo,
-			MemoryPropertyFlags properties,
-			Device device
-		) {
-			Image image(imageCreateInfo, device);
-			DeviceMemory deviceMemory = image.allocateDeviceMemory(properties);
+		static void setDevice(Device device) {
+			s_device = device;
+		}
 
-			VkResult vkResult = vkBindImageMemory(device, image, deviceMemory, 0);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+
+		VkSwapchainKHR vkSwapchain() {
+			VkSwapchainKHR vkSwapchain = m_swapchain;	// Need to force a type conversion for return value.
+			return vkSwapchain;
+		}
+
+		bool canDraw() {
+			collectRetiredSwapchains();
+			if (m_swapchain && m_swapchainUpToDate) {
+				return true;
 			}
+			recreateFullSwapchain();
+			return m_swapchain;
+		}
 
-			new(this) Image_Memory(std::move(image), std::move(deviceMemory));
+		VkExtent2D getImageExtent() const {
+			return m_swapchain.imageExtent();
+		}
 
+		uint64_t generation() const {
+			return m_generation;
 		}
 
-		Image_Memory(
-			VkExtent2D	vkExtent2D,
-			VkFormat format,
-			VkImageUsageFlags usage,
-			MemoryPropertyFlags properties,
-			Device device
-		) {
-			ImageCreateInfo imageCreateInfo(format, usage);
-			imageCreateInfo.setExtent(vkExtent2D);
-			new(this) Image_Memory(imageCreateInfo, properties, device);
+		VkFormat getImageFormat() const {
+			return m_swapchainCreateInfo.imageFormat;
 		}
 
-	};
+		VkImage getImage(uint32_t index) const {
+			return m_swapchainImages.at(index);
+		}
 
+		VkImageView getImageView(uint32_t index) const {
+			return m_swapchainImageViews.at(index);
+		}
 
-	class Image_Memory_View {
+		//	Without one, recreating waits for the device to go idle.
+		//	The queue has to outlive this.
+		void setDeferredDeletionQueue(DeferredDeletionQueue* pDeferredDeletionQueue) {
+			m_pDeferredDeletionQueue = pDeferredDeletionQueue;
+		}
+
+		//	Only with VK_EXT_swapchain_maintenance1 enabled.  Without it,
+		//	getting rid of an old swapchain waits for the device to go idle.
+		//	The pool has to outlive this.
+		void usePresentFences(SyncObjectPool* pSyncObjectPool) {
+			m_pSyncObjectPool = pSyncObjectPool;
+		}
+
+		//	For presenting an image acquired from vkSwapchain().  VK_NULL_HANDLE
+		//	without present fences.
+		VkFence presentFence() {
+			if (!m_pSyncObjectPool) {
+				return VK_NULL_HANDLE;
+			}
+			releasePresentFences(m_presentFences);
+			m_presentFences.push_back(m_pSyncObjectPool->acquireFence());
+			return m_presentFences.back();
+		}
+
+		void recreateFullSwapchain() {
+			m_swapchainUpToDate = false;
+			if (!s_device) {
+				return;
+			}
+
+			retireImageViews();
+
+			//	Handing over the old swapchain lets presents already queued
+			//	on it finish.  It is kept until they have.
+			Swapchain oldSwapchain = std::move(m_swapchain);
+			m_swapchainCreateInfo.oldSwapchain = oldSwapchain ? static_cast<VkSwapchainKHR>(oldSwapchain) : VK_NULL_HANDLE;
+			m_swapchain = std::move(createSwapchain(m_swapchainCreateInfo, m_surface));
+			m_swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+			if (oldSwapchain) {
+				retireSwapchain(std::move(oldSwapchain));
+			}
+			if (!m_swapchain) {
+				return;
+			}
+			createSwapchainImageViews();
+			m_generation++;
+			m_swapchainUpToDate = true;
+		}
+
+		void stale() {
+			m_swapchainUpToDate = false;
+		}
+
+	};
 
 
+	//	Passes say which images and buffers they read and write, compile
+	//	works out the rest: which passes are needed at all, their order,
+	//	the barriers in front of each, a render pass for each run of raster
+	//	passes on the same attachments, and the transient images.
+	//	Compiled once at setup and executed every frame.  The barriers don't
+	//	depend on the frame, so what is recorded from it can be submitted
+	//	again.  Everything goes in one command buffer on one queue.
+	class RenderGraph {
+
 	public:
-		Image			m_image;
-		DeviceMemory	m_deviceMemory;
-		ImageView		m_imageView;
 
-		Image_Memory_View() {}
+		using ResourceId = uint32_t;
+		using PassId = uint32_t;
 
-		Image_Memory_View(
-			Image&& image,
-			DeviceMemory&& deviceMemory,
-			ImageView&& imageView)
-			: m_image(std::move(image))
-			, m_deviceMemory(std::move(deviceMemory))
-			, m_imageView(std::move(imageView)) {
+		//	For raster passes the subpass has already begun.
+		using RecordFunc = std::function<void(CommandBuffer commandBuffer)>;
+
+		enum class PassType {
+			COMMANDS,	//	Outside any render pass, e.g. compute or transfers.
+			RASTER,		//	A subpass, with at least one attachment.
+		};
+
+		class PassBuilder;
+
+	private:
+
+		static const inline uint32_t NONE = ~0u;
+
+		enum class ResourceKind {
+			IMPORTED_IMAGE,
+			TRANSIENT_IMAGE,
+			IMPORTED_BUFFER,
+		};
+
+		struct Resource {
+			std::string		m_name;
+			ResourceKind	m_kind = ResourceKind::TRANSIENT_IMAGE;
+			VkFormat		m_format = VK_FORMAT_UNDEFINED;
+			ImageUsageScope	m_initialScope;		//	Imported only.
+			std::optional<ImageUsage>	m_finalUsage;	//	Imported images only.
+			bool			m_output = false;
+			//	Imported only, bound before each execute.
+			VkImage			m_vkImage = VK_NULL_HANDLE;
+			VkImageView		m_vkImageView = VK_NULL_HANDLE;
+			VkBuffer		m_vkBuffer = VK_NULL_HANDLE;
+			//	Filled in by compile.
+			uint32_t			m_firstStep = NONE;
+			uint32_t			m_lastStep = NONE;
+			VkImageUsageFlags	m_imageUsageFlags = 0;
+			bool				m_attachmentOnly = true;
+			uint32_t			m_physicalImage = NONE;		//	Transient only.
+		};
+
+		//	One per resource a pass uses, attachments included.
+		struct Access {
+			ResourceId			m_resource = 0;
+			ImageUsageScope		m_scope;
+			VkImageUsageFlags	m_imageUsageFlags = 0;
+			bool				m_write = false;
+			bool				m_discard = false;		//	What was there before isn't read.
+			bool				m_attachment = false;
+		};
+
+		struct Attachment {
+			ResourceId			m_resource = 0;
+			VkAttachmentLoadOp	m_loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			VkClearValue		m_clearValue{};
+		};
 
-		}
+		struct Pass {
+			std::string		m_name;
+			PassType		m_type = PassType::COMMANDS;
+			RecordFunc		m_record;
+			std::vector<Access>		m_accesses;
+			std::vector<Attachment>	m_colorAttachments;
+			std::optional<Attachment>	m_depthAttachment;
+			VkSubpassContents	m_subpassContents = VK_SUBPASS_CONTENTS_INLINE;
+			bool			m_enabled = true;
+			//	Filled in by compile.
+			bool			m_culled = false;
+			uint32_t		m_step = NONE;
+			uint32_t		m_subpass = 0;
+		};
 
-	};
+		//	The image or buffer is filled in when it is recorded.
+		struct Barrier {
+			ResourceId			m_resource = 0;
+			ImageState::Barrier	m_src;
+			ImageUsageScope		m_dst;
+		};
 
+		struct CachedFramebuffer {
+			std::vector<VkImageView>	m_imageViews;
+			Framebuffer					m_framebuffer;
+		};
 
+		//	A COMMANDS pass, or a run of RASTER passes in one render pass.
+		struct Step {
+			std::vector<PassId>		m_passes;
+			std::vector<Barrier>	m_barriers;		//	In front of it.
+			RenderPass				m_renderPass;
+			std::vector<ResourceId>	m_attachments;	//	Color, then depth.
+			std::vector<VkClearValue>	m_clearValues;
+			//	One per set of imported image views bound, e.g. per swapchain image.
+			std::vector<CachedFramebuffer>	m_framebuffers;
+		};
 
-	class Framebuffer : public HandleWithOwner<VkFramebuffer, Device> {
+		//	Transients with the same format whose steps don't overlap share one.
+		struct PhysicalImage {
+			VkFormat			m_format = VK_FORMAT_UNDEFINED;
+			VkImageUsageFlags	m_usage = 0;
+			bool				m_transientAttachment = false;	//	Never leaves a render pass.
+			uint32_t			m_lastStep = 0;
+			Image_Memory		m_image_memory;
+			ImageView			m_imageView;
+		};
 
-		Framebuffer(VkFramebuffer vkFramebuffer, Device device, DestroyFunc_t pfnDestroy)
-			: HandleWithOwner(vkFramebuffer, device, pfnDestroy) {
+		DeviceMemoryArena*		m_pDeviceMemoryArena = nullptr;
+		DeferredDeletionQueue*	m_pDeferredDeletionQueue = nullptr;
+
+		std::vector<Resource>	m_resources;
+		std::vector<Pass>		m_passes;
+		std::vector<Step>		m_steps;
+		std::vector<Barrier>	m_finalBarriers;	//	Leave the imported images in their final usage.
+		std::vector<PhysicalImage>	m_physicalImages;
+		VkExtent2D	m_extent{};
+		bool		m_compiled = false;
+
+
+		static VkImageUsageFlags imageUsageFlags(ImageUsage imageUsage) {
+			switch (imageUsage) {
+			case ImageUsage::TRANSFER_SRC:
+			case ImageUsage::BLIT_SRC:
+				return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case ImageUsage::TRANSFER_DST:
+			case ImageUsage::BLIT_DST:
+				return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			case ImageUsage::SAMPLED_FRAGMENT:
+			case ImageUsage::SAMPLED_COMPUTE:
+				return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case ImageUsage::STORAGE_COMPUTE:
+				return VK_IMAGE_USAGE_STORAGE_BIT;
+			case ImageUsage::COLOR_ATTACHMENT:
+				return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case ImageUsage::DEPTH_ATTACHMENT:
+				return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case ImageUsage::PRESENT:
+				return 0;
+			}
+			throw Exception("RenderGraph: unknown usage");
 		}
 
-		static void destroy(VkFramebuffer vkFramebuffer, Device device) {
-			vkDestroyFramebuffer(device, vkFramebuffer, nullptr);
+		bool isImage(ResourceId resource) const {
+			return m_resources.at(resource).m_kind != ResourceKind::IMPORTED_BUFFER;
 		}
 
-		//	Right now, framebuffer holds these just to control lifetime.
-		//	TODO: is there ever going to be more than one of these?
-		std::vector<Image_Memory_View>	m_image_memory_views;
-
-		std::vector<ImageView>	m_imageViews;
-
+		ResourceId addResource(Resource&& resource) {
+			if (m_compiled) {
+				throw Exception("RenderGraph: resources are added before compiling");
+			}
+			m_resources.push_back(std::move(resource));
+			return static_cast<ResourceId>(m_resources.size() - 1);
+		}
 
-	public:
+		//	A pass using a resource more than one way uses it once, for all of them.
+		void addAccess(PassId passId, const Access& access) {
+			if (m_compiled) {
+				throw Exception("RenderGraph: passes are added before compiling");
+			}
+			std::vector<Access>& accesses = m_passes.at(passId).m_accesses;
+			for (Access& existing : accesses) {
+				if (existing.m_resource != access.m_resource) {
+					continue;
+				}
+				if (existing.m_attachment || access.m_attachment) {
+					throw Exception("RenderGraph: an attachment can't be used any other way in its pass");
+				}
+				if (existing.m_scope.m_layout != access.m_scope.m_layout) {
+					throw Exception("RenderGraph: a pass uses an image in two layouts");
+				}
+				existing.m_scope.m_stages |= access.m_scope.m_stages;
+				existing.m_scope.m_access |= access.m_scope.m_access;
+				existing.m_imageUsageFlags |= access.m_imageUsageFlags;
+				existing.m_discard = existing.m_discard && access.m_discard;
+				existing.m_write = existing.m_write || access.m_write;
+				return;
+			}
+			accesses.push_back(access);
+		}
 
-		Framebuffer() {}
+		static bool sameAttachments(const Pass& a, const Pass& b) {
+			if (a.m_colorAttachments.size() != b.m_colorAttachments.size()
+				|| a.m_depthAttachment.has_value() != b.m_depthAttachment.has_value()) {
+				return false;
+			}
+			for (size_t i = 0; i < a.m_colorAttachments.size(); i++) {
+				if (a.m_colorAttachments[i].m_resource != b.m_colorAttachments[i].m_resource) {
+					return false;
+				}
+			}
+			return !a.m_depthAttachment || a.m_depthAttachment->m_resource == b.m_depthAttachment->m_resource;
+		}
 
-		Framebuffer(FramebufferCreateInfo& framebufferCreateInfo, Device device) {
-			VkFramebuffer	vkFramebuffer;
-			VkResult vkResult = vkCreateFramebuffer(device, framebufferCreateInfo.assemble(), nullptr, &vkFramebuffer);
-			if (vkResult != VK_SUCCESS) {
-				throw Exception(vkResult);
+		//	Whether the pass can be the step's next subpass.
+		bool canJoin(const Step& step, PassId passId) const {
+			const Pass& pass = m_passes[passId];
+			const Pass& first = m_passes[step.m_passes.front()];
+			if (pass.m_type != PassType::RASTER || first.m_type != PassType::RASTER || !sameAttachments(first, pass)) {
+				return false;
 			}
-			new(this)Framebuffer(vkFramebuffer, device, &destroy);
+			//	A later subpass can only carry on from what is there.
+			for (const Attachment& attachment : pass.m_colorAttachments) {
+				if (attachment.m_loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) {
+					return false;
+				}
+			}
+			if (pass.m_depthAttachment && pass.m_depthAttachment->m_loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) {
+				return false;
+			}
+			//	Only attachments are synchronized between subpasses.
+			for (const Access& access : pass.m_accesses) {
+				if (access.m_attachment) {
+					continue;
+				}
+				for (PassId other : step.m_passes) {
+					for (const Access& otherAccess : m_passes[other].m_accesses) {
+						if (otherAccess.m_resource == access.m_resource && (access.m_write || otherAccess.m_write)) {
+							return false;
+						}
+					}
+				}
+			}
+			return true;
 		}
 
-		void take(Image_Memory_View&& image_memory_view) {
-			m_image_memory_views.push_back(std::move(image_memory_view));
+		//	From the outputs back: a pass stays if something after it, or
+		//	after the graph, reads what it writes.
+		void cullPasses() {
+			std::vector<bool> needed(m_resources.size());
+			for (ResourceId resource = 0; resource < m_resources.size(); resource++) {
+				needed[resource] = m_resources[resource].m_output || m_resources[resource].m_finalUsage.has_value();
+			}
+			for (PassId passId = static_cast<PassId>(m_passes.size()); passId-- > 0;) {
+				Pass& pass = m_passes[passId];
+				pass.m_culled = std::none_of(pass.m_accesses.begin(), pass.m_accesses.end(),
+					[&](const Access& access) { return access.m_write && needed[access.m_resource]; });
+				if (pass.m_culled) {
+					continue;
+				}
+				for (const Access& access : pass.m_accesses) {
+					needed[access.m_resource] = !(access.m_write && access.m_discard);
+				}
+			}
 		}
 
-		void take(ImageView&& imageView) {
-			m_imageViews.push_back(std::move(imageView));
+		//	Each pass comes after the passes it depends on in declaration
+		//	order.  Otherwise the earliest declared goes first, unless one can
+		//	go in the same render pass as the one before.
+		void schedulePasses() {
+			const size_t passCount = m_passes.size();
+			std::vector<std::vector<PassId>> successors(passCount);
+			std::vector<uint32_t> predecessorCount(passCount);
+			std::vector<PassId> lastWriter(m_resources.size(), NONE);
+			std::vector<std::vector<PassId>> readers(m_resources.size());
+
+			auto addDependency = [&](PassId from, PassId to) {
+				if (from != NONE && from != to) {
+					successors[from].push_back(to);
+					predecessorCount[to]++;
+				}
+			};
+			for (PassId passId = 0; passId < passCount; passId++) {
+				const Pass& pass = m_passes[passId];
+				if (pass.m_culled) {
+					continue;
+				}
+				for (const Access& access : pass.m_accesses) {
+					addDependency(lastWriter[access.m_resource], passId);
+					if (access.m_write) {
+						for (PassId reader : readers[access.m_resource]) {
+							addDependency(reader, passId);
+						}
+					}
+				}
+				for (const Access& access : pass.m_accesses) {
+					if (access.m_write) {
+						lastWriter[access.m_resource] = passId;
+						readers[access.m_resource].clear();
+					}
+					else {
+						readers[access.m_resource].push_back(passId);
+					}
+				}
+			}
+
+			std::vector<PassId> ready;		//	Sorted.
+			for (PassId passId = 0; passId < passCount; passId++) {
+				if (!m_passes[passId].m_culled && predecessorCount[passId] == 0) {
+					ready.push_back(passId);
+				}
+			}
+			while (!ready.empty()) {
+				std::vector<PassId>::iterator next = ready.begin();
+				if (!m_steps.empty()) {
+					std::vector<PassId>::iterator joining = std::find_if(ready.begin(), ready.end(),
+						[&](PassId passId) { return canJoin(m_steps.back(), passId); });
+					if (joining != ready.end()) {
+						next = joining;
+					}
+				}
+				const PassId passId = *next;
+				ready.erase(next);
+
+				if (m_steps.empty() || !canJoin(m_steps.back(), passId)) {
+					m_steps.emplace_back();
+				}
+				Step& step = m_steps.back();
+				m_passes[passId].m_step = static_cast<uint32_t>(m_steps.size() - 1);
+				m_passes[passId].m_subpass = static_cast<uint32_t>(step.m_passes.size());
+				step.m_passes.push_back(passId);
+
+				for (PassId successor : successors[passId]) {
+					if (--predecessorCount[successor] == 0) {
+						ready.insert(std::lower_bound(ready.begin(), ready.end(), successor), successor);
+					}
+				}
+			}
 		}
 
+		//	In order of first use, a transient takes over a physical image
+		//	the transients before it are done with.
+		void assignPhysicalImages() {
+			for (uint32_t stepIndex = 0; stepIndex < m_steps.size(); stepIndex++) {
+				for (PassId passId : m_steps[stepIndex].m_passes) {
+					for (const Access& access : m_passes[passId].m_accesses) {
+						Resource& resource = m_resources[access.m_resource];
+						if (resource.m_firstStep == NONE) {
+							resource.m_firstStep = stepIndex;
+						}
+						resource.m_lastStep = stepIndex;
+						resource.m_imageUsageFlags |= access.m_imageUsageFlags;
+						resource.m_attachmentOnly = resource.m_attachmentOnly && access.m_attachment;
+					}
+				}
+			}
 
-	};
+			std::vector<ResourceId> transients;
+			for (ResourceId resource = 0; resource < m_resources.size(); resource++) {
+				if (m_resources[resource].m_kind == ResourceKind::TRANSIENT_IMAGE && m_resources[resource].m_firstStep != NONE) {
+					transients.push_back(resource);
+				}
+			}
+			std::stable_sort(transients.begin(), transients.end(),
+				[&](ResourceId a, ResourceId b) { return m_resources[a].m_firstStep < m_resources[b].m_firstStep; });
+
+			for (ResourceId resourceId : transients) {
+				Resource& resource = m_resources[resourceId];
+				const bool transientAttachment = resource.m_attachmentOnly && resource.m_firstStep == resource.m_lastStep;
+				uint32_t physical = 0;
+				for (; physical < m_physicalImages.size(); physical++) {
+					const PhysicalImage& physicalImage = m_physicalImages[physical];
+					if (physicalImage.m_format == resource.m_format
+						&& physicalImage.m_transientAttachment == transientAttachment
+						&& physicalImage.m_lastStep < resource.m_firstStep) {
+						break;
+					}
+				}
+				if (physical == m_physicalImages.size()) {
+					PhysicalImage& physicalImage = m_physicalImages.emplace_back();
+					physicalImage.m_format = resource.m_format;
+					physicalImage.m_transientAttachment = transientAttachment;
+				}
+				PhysicalImage& physicalImage = m_physicalImages[physical];
+				physicalImage.m_usage |= resource.m_imageUsageFlags;
+				physicalImage.m_lastStep = resource.m_lastStep;
+				resource.m_physicalImage = physical;
+			}
+		}
 
+		//	Follows every image and buffer through the steps.  Twice: the
+		//	first time round only leaves the transients the way the previous
+		//	execution does, so their first barriers wait for it.
+		void createBarriers() {
+			const size_t physicalBase = m_resources.size();
+			std::vector<ImageState> states(physicalBase + m_physicalImages.size());
+			auto stateIndex = [&](ResourceId resource) {
+				const Resource& r = m_resources[resource];
+				return r.m_kind == ResourceKind::TRANSIENT_IMAGE ? physicalBase + r.m_physicalImage : resource;
+			};
+			for (size_t physical = 0; physical < m_physicalImages.size(); physical++) {
+				states[physicalBase + physical] = ImageState(ImageCreateInfo(m_physicalImages[physical].m_format, 0));
+			}
 
-	class Swapchain_FrameBuffers {
+			for (int round = 0; round < 2; round++) {
+				for (ResourceId resource = 0; resource < m_resources.size(); resource++) {
+					const Resource& r = m_resources[resource];
+					if (r.m_kind == ResourceKind::TRANSIENT_IMAGE) {
+						continue;
+					}
+					states[resource] = r.m_kind == ResourceKind::IMPORTED_IMAGE ? ImageState(ImageCreateInfo(r.m_format, 0)) : ImageState();
+					states[resource].assume(0, 0, r.m_initialScope);
+				}
 
-	public:
-		static inline	Device		s_device;
+				std::vector<bool> used(m_resources.size());
+				std::vector<Barrier> barriers;
+				auto use = [&](ResourceId resource, const ImageUsageScope& scope, bool discardContents) {
+					//	What a transient held belongs to the last execution, or to another transient.
+					discardContents = discardContents
+						|| (m_resources[resource].m_kind == ResourceKind::TRANSIENT_IMAGE && !used[resource]);
+					used[resource] = true;
+					std::optional<ImageState::Barrier> barrier = states[stateIndex(resource)].use(0, 0, scope, discardContents);
+					if (barrier) {
+						//	Right for a transient that was only just made, too.
+						if (discardContents) {
+							barrier->m_oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+						}
+						barriers.push_back({ resource, *barrier, scope });
+					}
+				};
+
+				for (Step& step : m_steps) {
+					barriers.clear();
+					for (size_t subpass = 0; subpass < step.m_passes.size(); subpass++) {
+						for (const Access& access : m_passes[step.m_passes[subpass]].m_accesses) {
+							//	Subpass dependencies take care of the rest.
+							if (!access.m_attachment || subpass == 0) {
+								use(access.m_resource, access.m_scope, access.m_discard);
+							}
+						}
+					}
+					if (round == 1) {
+						step.m_barriers = barriers;
+					}
+				}
 
-		//	Just save the create info since we need parts of it later.
-		SwapchainCreateInfo	m_swapchainCreateInfo;
+				barriers.clear();
+				for (ResourceId resource = 0; resource < m_resources.size(); resource++) {
+					if (m_resources[resource].m_finalUsage) {
+						use(resource, ImageUsageScope::of(*m_resources[resource].m_finalUsage), false);
+					}
+				}
+				if (round == 1) {
+					m_finalBarriers = barriers;
+				}
+			}
+		}
 
-		//	Save the "smart" surface since the create info only has the base handle.
-		Surface				m_surface;
+		//	The barriers in front of a render pass change the layouts, the
+		//	render pass doesn't.  Attachments are only stored when something
+		//	after the render pass, or after the graph, reads them.
+		void createRenderPasses() {
+			for (uint32_t stepIndex = 0; stepIndex < m_steps.size(); stepIndex++) {
+				Step& step = m_steps[stepIndex];
+				const Pass& first = m_passes[step.m_passes.front()];
+				if (first.m_type != PassType::RASTER) {
+					continue;
+				}
 
-		RenderPass	m_renderPass;
+				RenderPassCreateInfo2 renderPassCreateInfo;
+				auto addAttachment = [&](const Attachment& attachment, ImageUsage imageUsage) {
+					const Resource& resource = m_resources[attachment.m_resource];
+					const ImageUsageScope scope = ImageUsageScope::of(imageUsage);
+					const VkImageAspectFlags aspectMask = ImageState::aspectMask(resource.m_format);
+					const VkAttachmentStoreOp storeOp =
+						resource.m_kind != ResourceKind::TRANSIENT_IMAGE || resource.m_lastStep > stepIndex
+						? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+					VkAttachmentDescription2 attachmentDescription{};
+					attachmentDescription.format = resource.m_format;
+					attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+					attachmentDescription.loadOp = attachment.m_loadOp;
+					attachmentDescription.storeOp = storeOp;
+					attachmentDescription.stencilLoadOp = (aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) ? attachment.m_loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+					attachmentDescription.stencilStoreOp = (aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					attachmentDescription.initialLayout = scope.m_layout;
+					attachmentDescription.finalLayout = scope.m_layout;
+
+					step.m_attachments.push_back(attachment.m_resource);
+					step.m_clearValues.push_back(attachment.m_clearValue);
+					return renderPassCreateInfo.addAttachment(attachmentDescription, scope.m_layout, aspectMask);
+				};
+
+				std::vector<VkAttachmentReference2> colorAttachmentReferences;
+				for (const Attachment& attachment : first.m_colorAttachments) {
+					colorAttachmentReferences.push_back(addAttachment(attachment, ImageUsage::COLOR_ATTACHMENT));
+				}
+				std::optional<VkAttachmentReference2> depthAttachmentReference;
+				if (first.m_depthAttachment) {
+					depthAttachmentReference = addAttachment(*first.m_depthAttachment, ImageUsage::DEPTH_ATTACHMENT);
+				}
 
-		Swapchain	m_swapchain;
-		std::vector<Framebuffer>	m_swapchainFrameBuffers;
+				const ImageUsageScope colorScope = ImageUsageScope::of(ImageUsage::COLOR_ATTACHMENT);
+				const ImageUsageScope depthScope = ImageUsageScope::of(ImageUsage::DEPTH_ATTACHMENT);
+				for (uint32_t subpass = 0; subpass < step.m_passes.size(); subpass++) {
+					SubpassDescription2& subpassDescription = renderPassCreateInfo.addSubpass();
+					for (const VkAttachmentReference2& colorAttachmentReference : colorAttachmentReferences) {
+						subpassDescription.addColorAttachmentReference(colorAttachmentReference);
+					}
+					if (depthAttachmentReference) {
+						subpassDescription.setDepthStencilAttachmentReference(*depthAttachmentReference);
+					}
+					if (subpass == 0) {
+						continue;
+					}
+					//	Each subpass carries on from the attachments the one before wrote.
+					SubpassDependency2& subpassDependency = renderPassCreateInfo.addSubpassDependency(subpass - 1, subpass);
+					subpassDependency.setDependencyFlags(VK_DEPENDENCY_BY_REGION_BIT);
+					if (!colorAttachmentReferences.empty()) {
+						subpassDependency
+							.addSrc(colorScope.m_stages, colorScope.writeAccess())
+							.addDst(colorScope.m_stages, colorScope.m_access);
+					}
+					if (depthAttachmentReference) {
+						subpassDependency
+							.addSrc(depthScope.m_stages, depthScope.writeAccess())
+							.addDst(depthScope.m_stages, depthScope.m_access);
+					}
+				}
 
-		bool m_swapchainUpToDate = false;
+				step.m_renderPass = RenderPass(renderPassCreateInfo, m_pDeviceMemoryArena->getDevice());
+			}
+		}
 
+		void createImages() {
+			for (PhysicalImage& physicalImage : m_physicalImages) {
+				ImageCreateInfo imageCreateInfo(physicalImage.m_format,
+					physicalImage.m_usage | (physicalImage.m_transientAttachment ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0));
+				imageCreateInfo.setExtent(m_extent);
+				physicalImage.m_image_memory = Image_Memory(imageCreateInfo, MEMORY_PROPERTY_DEVICE_LOCAL, *m_pDeviceMemoryArena);
+				ImageViewCreateInfo imageViewCreateInfo(
+					physicalImage.m_image_memory.m_image,
+					VK_IMAGE_VIEW_TYPE_2D,
+					physicalImage.m_format,
+					ImageState::aspectMask(physicalImage.m_format));
+				physicalImage.m_imageView = ImageView(imageViewCreateInfo, m_pDeviceMemoryArena->getDevice());
+			}
+		}
 
-	private:
+		//	Frames in flight may still be using them.
+		template<typename T>
+		void retire(T&& object) {
+			if (m_pDeferredDeletionQueue) {
+				m_pDeferredDeletionQueue->destroyLater(std::move(object));
+			}
+			else if (m_pDeviceMemoryArena) {
+				vkDeviceWaitIdle(m_pDeviceMemoryArena->getDevice());
+			}
+		}
 
-		void makeEmpty() {
-			//	TODO: Need to review the whole move thing to make sure this all makes sense.
-			m_swapchainFrameBuffers.clear();
+		void retireFramebuffers() {
+			for (Step& step : m_steps) {
+				if (!step.m_framebuffers.empty()) {
+					retire(std::move(step.m_framebuffers));
+					step.m_framebuffers.clear();
+				}
+			}
 		}
 
+		void retireImages() {
+			std::vector<PhysicalImage> retired;
+			for (PhysicalImage& physicalImage : m_physicalImages) {
+				if (physicalImage.m_image_memory.m_image) {
+					PhysicalImage& image = retired.emplace_back();
+					image.m_image_memory = std::move(physicalImage.m_image_memory);
+					image.m_imageView = std::move(physicalImage.m_imageView);
+				}
+			}
+			if (!retired.empty()) {
+				retire(std::move(retired));
+			}
+		}
 
-		void destroyFrameBuffers() {
-			m_swapchainFrameBuffers.clear();
+		VkImage vkImage(ResourceId resourceId) const {
+			const Resource& resource = m_resources[resourceId];
+			if (resource.m_kind == ResourceKind::TRANSIENT_IMAGE) {
+				return m_physicalImages[resource.m_physicalImage].m_image_memory.m_image;
+			}
+			if (!resource.m_vkImage) {
+				throw Exception("RenderGraph: an imported image isn't bound");
+			}
+			return resource.m_vkImage;
 		}
 
+		VkImageView vkImageView(ResourceId resourceId) const {
+			const Resource& resource = m_resources[resourceId];
+			if (resource.m_kind == ResourceKind::TRANSIENT_IMAGE) {
+				return m_physicalImages[resource.m_physicalImage].m_imageView;
+			}
+			if (!resource.m_vkImageView) {
+				throw Exception("RenderGraph: an imported image isn't bound");
+			}
+			return resource.m_vkImageView;
+		}
 
-		void destroy() {
-			if (!s_device) {
+		void recordBarriers(CommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const {
+			if (barriers.empty()) {
 				return;
 			}
-			if (m_swapchain) {
-				vkDeviceWaitIdle(s_device);
-				destroyFrameBuffers();
+			DependencyInfo dependencyInfo;
+			for (const Barrier& barrier : barriers) {
+				const Resource& resource = m_resources[barrier.m_resource];
+				if (resource.m_kind == ResourceKind::IMPORTED_BUFFER) {
+					if (!resource.m_vkBuffer) {
+						throw Exception("RenderGraph: an imported buffer isn't bound");
+					}
+					dependencyInfo.addBufferMemoryBarrier(BufferMemoryBarrier2(
+						resource.m_vkBuffer,
+						barrier.m_src.m_srcStages, barrier.m_src.m_srcAccess,
+						barrier.m_dst.m_stages, barrier.m_dst.m_access));
+					continue;
+				}
+				ImageMemoryBarrier2 imageMemoryBarrier(barrier.m_src.m_oldLayout, barrier.m_dst.m_layout, vkImage(barrier.m_resource));
+				imageMemoryBarrier.setAspectMask(ImageState::aspectMask(resource.m_format));
+				imageMemoryBarrier.srcStageMask = barrier.m_src.m_srcStages;
+				imageMemoryBarrier.srcAccessMask = barrier.m_src.m_srcAccess;
+				imageMemoryBarrier.dstStageMask = barrier.m_dst.m_stages;
+				imageMemoryBarrier.dstAccessMask = barrier.m_dst.m_access;
+				dependencyInfo.addImageMemoryBarrier(imageMemoryBarrier);
 			}
+			commandBuffer.cmdPipelineBarrier2(dependencyInfo);
 		}
 
+		const Pass& compiledPass(PassId passId) const {
+			if (!m_compiled) {
+				throw Exception("RenderGraph: not compiled");
+			}
+			const Pass& pass = m_passes.at(passId);
+			if (pass.m_culled) {
+				throw Exception("RenderGraph: the pass was culled");
+			}
+			return pass;
+		}
 
-		void createSwapchainFrameBuffers() {
+		VkFramebuffer framebuffer(Step& step) {
+			if (!m_physicalImages.empty() && !m_physicalImages.front().m_image_memory.m_image) {
+				throw Exception("RenderGraph: no extent set");
+			}
+			for (CachedFramebuffer& cached : step.m_framebuffers) {
+				bool same = true;
+				for (size_t i = 0; i < step.m_attachments.size() && same; i++) {
+					same = cached.m_imageViews[i] == vkImageView(step.m_attachments[i]);
+				}
+				if (same) {
+					return cached.m_framebuffer;
+				}
+			}
+			CachedFramebuffer& cached = step.m_framebuffers.emplace_back();
+			FramebufferCreateInfo framebufferCreateInfo(step.m_renderPass, m_extent);
+			for (ResourceId attachment : step.m_attachments) {
+				cached.m_imageViews.push_back(vkImageView(attachment));
+				framebufferCreateInfo.addAttachment(cached.m_imageViews.back());
+			}
+			cached.m_framebuffer = Framebuffer(framebufferCreateInfo, m_pDeviceMemoryArena->getDevice());
+			return cached.m_framebuffer;
+		}
 
-			std::vector<VkImage> m_swapchainImages = m_swapchain.getImages();
+	public:
 
-			for (VkImage vkImage : m_swapchainImages) {
-				//	The renderpass image view and the depth buffer are "passed"
-				//	to the renderpass via attachments to the framebuffer.  This
-				//	means that was don't need to actually pass them through code.
-				//	All we need to do is create them and make sure they don't disappear.
-				//	We just have the framebuffer take ownership of the image view and
-				//	depth buffer.  
-				Image_Memory_View	depthBuffer(createDepthBuffer(m_swapchain.imageExtent(), s_device));
+		class PassBuilder {
 
-				ImageViewCreateInfo imageViewCreateInfo(
-					vkImage,
-					VK_IMAGE_VIEW_TYPE_2D,
-					m_swapchainCreateInfo.imageFormat,
-					VK_IMAGE_ASPECT_COLOR_BIT);
-				ImageView imageView(imageViewCreateInfo, m_swapchain.getOwner());
+			RenderGraph&	m_graph;
+			PassId			m_passId;
 
+			PassBuilder& use(ResourceId resource, bool image, const ImageUsageScope& scope,
+				VkImageUsageFlags vkImageUsageFlags, bool write, bool discardContents) {
+				if (m_graph.isImage(resource) != image) {
+					throw Exception(image ? "RenderGraph: an image usage for a buffer" : "RenderGraph: a buffer usage for an image");
+				}
+				m_graph.addAccess(m_passId, { resource, scope, vkImageUsageFlags, write, write && discardContents, false });
+				return *this;
+			}
 
-				//	Note that attachments here are image views.  When a
-				//	Renderpass adds attachments, the attachments are descriptions
-				//	of these attachments.
-				FramebufferCreateInfo	framebufferCreateInfo(m_renderPass, m_swapchain.imageExtent());
-				framebufferCreateInfo
-					.addAttachment(imageView)
-					.addAttachment(depthBuffer.m_imageView);
+			PassBuilder& attach(ResourceId resource, ImageUsage imageUsage, VkAttachmentLoadOp loadOp) {
+				Pass& pass = m_graph.m_passes.at(m_passId);
+				if (pass.m_type != PassType::RASTER) {
+					throw Exception("RenderGraph: attachments are for raster passes");
+				}
+				if (!m_graph.isImage(resource)) {
+					throw Exception("RenderGraph: a buffer as an attachment");
+				}
+				m_graph.addAccess(m_passId, { resource, ImageUsageScope::of(imageUsage), imageUsageFlags(imageUsage),
+					true, loadOp != VK_ATTACHMENT_LOAD_OP_LOAD, true });
+				return *this;
+			}
 
+		public:
 
-				Framebuffer framebuffer(framebufferCreateInfo, s_device);
-				framebuffer.take(std::move(depthBuffer));
-				framebuffer.take(std::move(imageView));
-				m_swapchainFrameBuffers.push_back(std::move(framebuffer));
+			PassBuilder(RenderGraph& graph, PassId passId)
+				: m_graph(graph)
+				, m_passId(passId) {
 			}
-		}
 
+			PassId id() const {
+				return m_passId;
+			}
 
-		static Swapchain createSwapchain(
-			SwapchainCreateInfo& swapchainCreateInfo,
-			Surface surface
-		) {
-			const VkSurfaceCapabilitiesKHR vkSurfaceCapabilities = surface.getSurfaceCapabilities();
-			const VkExtent2D surfaceExtent = vkSurfaceCapabilities.currentExtent;
-			//	Can't make "real" swapchains with 0 width or height, e.g.,
-			//	the window is minimized.  Return a "null" swapchain if
-			//	this occurs.
-			if (surfaceExtent.width == 0 || surfaceExtent.height == 0) {
-				return Swapchain{};
+			PassBuilder& read(ResourceId resource, ImageUsage imageUsage) {
+				return use(resource, true, ImageUsageScope::of(imageUsage), imageUsageFlags(imageUsage), false, false);
 			}
-			//	TODO: should probably sanity check some other surface capabilities.
-			swapchainCreateInfo.surface = surface;
-			swapchainCreateInfo.imageExtent = surfaceExtent;
-			swapchainCreateInfo.preTransform = vkSurfaceCapabilities.currentTransform;
 
-			return Swapchain(swapchainCreateInfo, s_device);
-		}
+			//	discardContents: the pass overwrites all of it.
+			PassBuilder& write(ResourceId resource, ImageUsage imageUsage, bool discardContents = false) {
+				return use(resource, true, ImageUsageScope::of(imageUsage), imageUsageFlags(imageUsage), true, discardContents);
+			}
 
+			PassBuilder& read(ResourceId resource, BufferUsage bufferUsage) {
+				return use(resource, false, ImageUsageScope::of(bufferUsage), 0, false, false);
+			}
 
-	public:
+			PassBuilder& write(ResourceId resource, BufferUsage bufferUsage, bool discardContents = false) {
+				return use(resource, false, ImageUsageScope::of(bufferUsage), 0, true, discardContents);
+			}
 
-		Swapchain_FrameBuffers() {}
-		~Swapchain_FrameBuffers() {
-			destroy();
-		}
+			//	Anything but LOAD discards what was there.
+			PassBuilder& colorAttachment(
+				ResourceId			resource,
+				VkAttachmentLoadOp	loadOp,
+				VkClearColorValue	clearColor = {}
+			) {
+				attach(resource, ImageUsage::COLOR_ATTACHMENT, loadOp);
+				Attachment& attachment = m_graph.m_passes[m_passId].m_colorAttachments.emplace_back();
+				attachment.m_resource = resource;
+				attachment.m_loadOp = loadOp;
+				attachment.m_clearValue.color = clearColor;
+				return *this;
+			}
 
-		Swapchain_FrameBuffers(
-			const SwapchainCreateInfo& swapchainCreateInfo,
-			Surface surface)
-			: m_swapchainCreateInfo(swapchainCreateInfo)
-			, m_surface(surface) {
+			PassBuilder& depthAttachment(
+				ResourceId			resource,
+				VkAttachmentLoadOp	loadOp,
+				VkClearDepthStencilValue	clearDepthStencil = { 1.0f, 0 }
+			) {
+				Pass& pass = m_graph.m_passes.at(m_passId);
+				if (pass.m_depthAttachment) {
+					throw Exception("RenderGraph: a pass has one depth attachment");
+				}
+				attach(resource, ImageUsage::DEPTH_ATTACHMENT, loadOp);
+				Attachment attachment;
+				attachment.m_resource = resource;
+				attachment.m_loadOp = loadOp;
+				attachment.m_clearValue.depthStencil = clearDepthStencil;
+				pass.m_depthAttachment = attachment;
+				return *this;
+			}
 
-		}
+		};
 
-		Swapchain_FrameBuffers(const Swapchain_FrameBuffers&) = delete;
-		Swapchain_FrameBuffers& operator=(const Swapchain_FrameBuffers&) = delete;
 
-		Swapchain_FrameBuffers(Swapchain_FrameBuffers&& other) noexcept
-			: m_swapchainCreateInfo(std::move(other.m_swapchainCreateInfo))
-			, m_surface(std::move(other.m_surface))
-			, m_renderPass(std::move(other.m_renderPass))
-			, m_swapchain(std::move(other.m_swapchain))
-			, m_swapchainFrameBuffers(std::move(other.m_swapchainFrameBuffers)) {
-			other.makeEmpty();
-		}
+		RenderGraph() {}
 
-		Swapchain_FrameBuffers& operator=(Swapchain_FrameBuffers&& other) noexcept {
-			if (this == &other) {
-				return *this;
-			}
-			(*this).~Swapchain_FrameBuffers();
-			new(this) Swapchain_FrameBuffers(std::move(other));
-			other.makeEmpty();
-			return *this;
+		explicit RenderGraph(DeviceMemoryArena& deviceMemoryArena)
+			: m_pDeviceMemoryArena(&deviceMemoryArena) {
 		}
 
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+		RenderGraph(RenderGraph&&) = default;
+		RenderGraph& operator=(RenderGraph&&) = default;
 
-		static void setDevice(Device device) {
-			s_device = device;
+		//	Without one, setExtent waits for the device to go idle.
+		//	The queue has to outlive this.
+		void setDeferredDeletionQueue(DeferredDeletionQueue* pDeferredDeletionQueue) {
+			m_pDeferredDeletionQueue = pDeferredDeletionQueue;
 		}
 
-
-		VkSwapchainKHR vkSwapchain() {
-			VkSwapchainKHR vkSwapchain = m_swapchain;	// Need to force a type conversion for return value.
-			return vkSwapchain;
+		//	Comes in already synchronized for initialScope, e.g. a swapchain
+		//	image by the acquire semaphore's wait, and bound before each
+		//	execute.  With a finalUsage it is left that way, and is an output.
+		ResourceId importImage(
+			const char*		name,
+			VkFormat		format,
+			const ImageUsageScope&		initialScope,
+			std::optional<ImageUsage>	finalUsage = std::nullopt
+		) {
+			Resource resource;
+			resource.m_name = name;
+			resource.m_kind = ResourceKind::IMPORTED_IMAGE;
+			resource.m_format = format;
+			resource.m_initialScope = initialScope;
+			resource.m_finalUsage = finalUsage;
+			return addResource(std::move(resource));
 		}
 
-		bool canDraw() {
-			if (m_swapchain && m_swapchainUpToDate) {
-				return true;
-			}
-			recreateFullSwapchain();
-			return m_swapchain;
+		//	Made by the graph at its extent, and only holds anything from
+		//	its first use in an execute to its last.
+		ResourceId createImage(const char* name, VkFormat format) {
+			Resource resource;
+			resource.m_name = name;
+			resource.m_kind = ResourceKind::TRANSIENT_IMAGE;
+			resource.m_format = format;
+			return addResource(std::move(resource));
 		}
 
-		VkExtent2D getImageExtent() const {
-			return m_swapchain.imageExtent();
+		ResourceId importBuffer(const char* name, const ImageUsageScope& initialScope = {}) {
+			Resource resource;
+			resource.m_name = name;
+			resource.m_kind = ResourceKind::IMPORTED_BUFFER;
+			resource.m_initialScope = initialScope;
+			return addResource(std::move(resource));
 		}
 
-		const Framebuffer& getFrameBuffer(int index) {
-			return m_swapchainFrameBuffers.at(index);
+		//	Something after the graph reads it, so whatever writes it stays.
+		void markOutput(ResourceId resource) {
+			m_resources.at(resource).m_output = true;
 		}
 
+		PassBuilder addPass(const char* name, PassType passType, RecordFunc record) {
+			if (m_compiled) {
+				throw Exception("RenderGraph: passes are added before compiling");
+			}
+			Pass& pass = m_passes.emplace_back();
+			pass.m_name = name;
+			pass.m_type = passType;
+			pass.m_record = std::move(record);
+			return PassBuilder(*this, static_cast<PassId>(m_passes.size() - 1));
+		}
+
+		//	Makes the render passes, so before the pipelines using them.
+		//	Nothing recorded from the graph can be in flight.
+		void compile() {
+			if (!m_pDeviceMemoryArena) {
+				throw Exception("RenderGraph: no device memory arena");
+			}
+			for (const Pass& pass : m_passes) {
+				if (pass.m_type == PassType::RASTER && pass.m_colorAttachments.empty() && !pass.m_depthAttachment) {
+					throw Exception("RenderGraph: a raster pass without attachments");
+				}
+			}
 
-		void setRenderPass(RenderPass renderPass) {
-			m_renderPass = renderPass;
+			retireImages();
+			m_physicalImages.clear();
+			m_steps.clear();
+			m_finalBarriers.clear();
+			for (Resource& resource : m_resources) {
+				resource.m_firstStep = NONE;
+				resource.m_lastStep = NONE;
+				resource.m_imageUsageFlags = 0;
+				resource.m_attachmentOnly = true;
+				resource.m_physicalImage = NONE;
+			}
+
+			cullPasses();
+			schedulePasses();
+			assignPhysicalImages();
+			createBarriers();
+			createRenderPasses();
+			m_compiled = true;
+
+			if (m_extent.width > 0 && m_extent.height > 0) {
+				createImages();
+			}
 		}
 
-		void recreateFullSwapchain() {
-			m_swapchainUpToDate = false;
-			if (!s_device) {
+		//	The transients are remade when the extent changes.  The
+		//	framebuffers always are, so this has to be called whenever the
+		//	imported images are recreated too, e.g. with the swapchain.
+		void setExtent(VkExtent2D vkExtent2D) {
+			if (!m_compiled) {
+				throw Exception("RenderGraph: not compiled");
+			}
+			retireFramebuffers();
+			if (vkExtent2D.width == m_extent.width && vkExtent2D.height == m_extent.height
+				&& (m_physicalImages.empty() || m_physicalImages.front().m_image_memory.m_image)) {
 				return;
 			}
+			retireImages();
+			m_extent = vkExtent2D;
+			createImages();
+		}
 
-			vkDeviceWaitIdle(s_device);
-			destroyFrameBuffers();
-			//	TODO: can we set the old swapchain to avoid this?
-			//	Explicitly destroy the old swapchain for now.
-			m_swapchain = std::move(vkcpp::Swapchain());
+		VkExtent2D extent() const {
+			return m_extent;
+		}
 
-			m_swapchain = std::move(createSwapchain(m_swapchainCreateInfo, m_surface));
-			if (!m_swapchain) {
-				return;
+		void bindImage(ResourceId resourceId, VkImage vkImage, VkImageView vkImageView) {
+			Resource& resource = m_resources.at(resourceId);
+			if (resource.m_kind != ResourceKind::IMPORTED_IMAGE) {
+				throw Exception("RenderGraph: only imported images are bound");
 			}
-			createSwapchainFrameBuffers();
-			m_swapchainUpToDate = true;
+			resource.m_vkImage = vkImage;
+			resource.m_vkImageView = vkImageView;
 		}
 
-		void stale() {
-			m_swapchainUpToDate = false;
+		void bindBuffer(ResourceId resourceId, VkBuffer vkBuffer) {
+			Resource& resource = m_resources.at(resourceId);
+			if (resource.m_kind != ResourceKind::IMPORTED_BUFFER) {
+				throw Exception("RenderGraph: only imported buffers are bound");
+			}
+			resource.m_vkBuffer = vkBuffer;
 		}
 
+		//	Whether a raster pass records its subpass inline or with
+		//	cmdExecuteCommands.
+		void setSubpassContents(PassId passId, VkSubpassContents vkSubpassContents) {
+			m_passes.at(passId).m_subpassContents = vkSubpassContents;
+		}
 
-		Image_Memory_View createDepthBuffer(
-			VkExtent2D vkExtent2D,
-			vkcpp::Device device
-		) {
-			const VkFormat	depthBufferFormat = VK_FORMAT_D32_SFLOAT;
+		//	A disabled pass records nothing, the barriers around it stay.
+		void setPassEnabled(PassId passId, bool enabled) {
+			m_passes.at(passId).m_enabled = enabled;
+		}
 
-			vkcpp::ImageCreateInfo imageCreateInfo(
-				depthBufferFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.setExtent(vkExtent2D);
-			vkcpp::Image_Memory image_memory(
-				imageCreateInfo, vkcpp::MEMORY_PROPERTY_DEVICE_LOCAL, device);
+		bool culled(PassId passId) const {
+			return m_passes.at(passId).m_culled;
+		}
+
+		//	What a raster pass's pipelines and secondaries are made for.
+		//	The graph keeps it.
+		RenderPass renderPass(PassId passId) const {
+			const Pass& pass = compiledPass(passId);
+			return m_steps[pass.m_step].m_renderPass;
+		}
 
-			vkcpp::ImageViewCreateInfo imageViewCreateInfo(
-				image_memory.m_image,
-				VK_IMAGE_VIEW_TYPE_2D,
-				depthBufferFormat,
-				VK_IMAGE_ASPECT_DEPTH_BIT);
-			vkcpp::ImageView imageView(imageViewCreateInfo, device);
+		uint32_t subpass(PassId passId) const {
+			return compiledPass(passId).m_subpass;
+		}
+
+		//	For the images bound now, made the first time they are.
+		VkFramebuffer framebuffer(PassId passId) {
+			const Pass& pass = compiledPass(passId);
+			if (pass.m_type != PassType::RASTER) {
+				throw Exception("RenderGraph: only raster passes have framebuffers");
+			}
+			return framebuffer(m_steps[pass.m_step]);
+		}
 
-			return Image_Memory_View(
-				std::move(image_memory.m_image),
-				std::move(image_memory.m_deviceMemory),
-				std::move(imageView));
+		void execute(CommandBuffer commandBuffer) {
+			if (!m_compiled) {
+				throw Exception("RenderGraph: not compiled");
+			}
+			for (Step& step : m_steps) {
+				recordBarriers(commandBuffer, step.m_barriers);
+
+				if (!step.m_renderPass) {
+					const Pass& pass = m_passes[step.m_passes.front()];
+					if (pass.m_enabled) {
+						pass.m_record(commandBuffer);
+					}
+					continue;
+				}
 
+				VkRenderPassBeginInfo vkRenderPassBeginInfo{};
+				vkRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				vkRenderPassBeginInfo.renderPass = step.m_renderPass;
+				vkRenderPassBeginInfo.framebuffer = framebuffer(step);
+				vkRenderPassBeginInfo.renderArea.offset = { 0, 0 };
+				vkRenderPassBeginInfo.renderArea.extent = m_extent;
+				vkRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(step.m_clearValues.size());
+				vkRenderPassBeginInfo.pClearValues = step.m_clearValues.data();
+
+				for (size_t subpass = 0; subpass < step.m_passes.size(); subpass++) {
+					const Pass& pass = m_passes[step.m_passes[subpass]];
+					if (subpass == 0) {
+						commandBuffer.cmdBeginRenderPass(vkRenderPassBeginInfo, pass.m_subpassContents);
+					}
+					else {
+						commandBuffer.cmdNextSubpass(pass.m_subpassContents);
+					}
+					if (pass.m_enabled) {
+						pass.m_record(commandBuffer);
+					}
+				}
+				commandBuffer.cmdEndRenderPass();
+			}
+			recordBarriers(commandBuffer, m_finalBarriers);
 		}
 
 	};